@@ -0,0 +1,559 @@
+/*
+ * Benchmarks for schedule parsing and next time calculation.
+ *
+ * Generates a synthetic schedule file with a configurable number of entries
+ * and mix of calendar field types, loads it and times each operation.
+ * Results are written one JSON object per line so they can be collected
+ * and compared across releases.  Benchmarks loading the schedule also report
+ * the use of the arena and string pool holding the loaded schedule.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+#include "schedule.h"
+#include "scheduleLoader.h"
+#include "scheduleCache.h"
+#include "scheduleArena.h"
+#include "stringPool.h"
+#include "entryStore.h"
+
+#define SUCCESS 0
+#define ERROR 1
+
+// Default number of entries in the generated schedule
+#define DEFAULT_ENTRIES 1000
+// Minimum time in ns spent on each benchmark
+#define DEFAULT_MIN_NS 200000000LL
+// Number of calendar field types within the mix
+#define NUMBER_OF_KINDS 5
+
+enum FieldKind {FK_WILDCARD, FK_SINGLE, FK_RANGE, FK_STEP, FK_LIST};
+
+/* -----------------------------------------------------------------------------
+ *  Internal Structures
+ * ---------------------------------------------------------------------------*/
+
+/**
+ * Range of valid values for each generated calendar field.  Year is always
+ * a wildcard so entries keep occurring.
+ */
+typedef struct _fieldRange {
+    int minVal;
+    int maxVal;
+} fieldRange;
+
+static const fieldRange fieldRanges[] = {
+    {1, 12},        // Month
+    {1, 28},        // Day of month
+    {1, 7},         // Day of week
+    {0, 23},        // Hour
+    {0, 59}         // Minute
+};
+
+/**
+ * Result of a single benchmark.
+ */
+typedef struct _benchResult {
+    long long ops;
+    long long elapsedNs;
+    long long allocs;
+    long long allocBytes;
+    Bool loads;                 // Loads the schedule.  Reports arena
+    arenaStats arena;           // Arena of the schedule once complete
+    uint32_t poolStrings;       // Distinct text of the schedule
+    size_t poolBytes;
+} benchResult;
+
+/**
+ * Runs count operations of a benchmark.
+ */
+typedef void (*benchFunc)(long long count);
+
+/* -----------------------------------------------------------------------------
+ *  Prototypes
+ * ---------------------------------------------------------------------------*/
+void usage();
+int processArgs(int argc, char **argv);
+int parseMix(const char * mixStr);
+int generateSchedule(const char * fileName, int numEntries, unsigned seed);
+void writeField(FILE * out, const fieldRange * range);
+int loadSchedule(const char * fileName);
+long long elapsedNs(struct timespec * start, struct timespec * stop);
+void runBench(const char * name, benchFunc func, Bool loads);
+void reportBench(const char * name, benchResult * result);
+
+void benchParse(long long count);
+void benchLoadCached(long long count);
+void benchCalcNextTimeForTask(long long count);
+void benchCalcNextTaskAlarm(long long count);
+void benchGetScheduledEvents(long long count);
+void benchScanList(long long count);
+void benchScanStore(long long count);
+void benchMatchPerEntry(long long count);
+void benchMatchEntriesAt(long long count);
+void benchDisplayTodaysSchedule(long long count);
+
+/* -----------------------------------------------------------------------------
+ *  Allocation counting.  With glibc, malloc is interposed so every allocation
+ *  made during a benchmark, including those within the C library, is counted.
+ * ---------------------------------------------------------------------------*/
+static long long allocCount = 0;
+static long long allocBytes = 0;
+
+#ifdef __GLIBC__
+#define COUNTS_ALLOCS 1
+extern void * __libc_malloc(size_t size);
+extern void * __libc_calloc(size_t nmemb, size_t size);
+extern void * __libc_realloc(void * ptr, size_t size);
+
+void * malloc(size_t size) {
+    allocCount++;
+    allocBytes += size;
+    return __libc_malloc(size);
+}
+
+void * calloc(size_t nmemb, size_t size) {
+    allocCount++;
+    allocBytes += nmemb * size;
+    return __libc_calloc(nmemb, size);
+}
+
+void * realloc(void * ptr, size_t size) {
+    allocCount++;
+    allocBytes += size;
+    return __libc_realloc(ptr, size);
+}
+#else
+#define COUNTS_ALLOCS 0
+#endif // __GLIBC__
+
+/* -----------------------------------------------------------------------------
+ *  Arg Processing.
+ * ---------------------------------------------------------------------------*/
+int numEntries = DEFAULT_ENTRIES;
+int kindWeights[NUMBER_OF_KINDS] = {30, 30, 15, 15, 10};
+unsigned seed = 1;
+long long minNs = DEFAULT_MIN_NS;
+char * generateOnly = NULL;
+char * scheduleFileLoc = "bench.dat";
+
+static scheduleContext * benchContext;
+static enum ParserType benchParser = PARSER_BISON;
+static FILE * devNull;
+static time_t benchTime;
+// Buffer filled by matchEntriesAt
+static scheduleEntry ** benchMatches;
+// Entries matched, so the matching is not optimized away
+static long long matchCount;
+
+static const char * kernelBenches[] = {"matchEntriesAt/auto", 
+    "matchEntriesAt/scalar", "matchEntriesAt/sse4", "matchEntriesAt/avx2"};
+
+/* -----------------------------------------------------------------------------
+ *  Function definitions.
+ * ---------------------------------------------------------------------------*/
+int main(int argc, char **argv) {
+    enum MatchKernel kernel;
+
+    if (processArgs(argc, argv) == ERROR) {
+        usage();
+        return ERROR;
+    }
+    if (generateOnly != NULL) {
+        return generateSchedule(generateOnly, numEntries, seed);
+    }
+    benchContext = createScheduleContext();
+    if (generateSchedule(scheduleFileLoc, numEntries, seed) == ERROR
+            || loadSchedule(scheduleFileLoc) == ERROR) {
+        return ERROR;
+    }
+    devNull = fopen("/dev/null", "w");
+    if (devNull == NULL) {
+        perror("Failed to open /dev/null: ");
+        return ERROR;
+    }
+
+    // All calculations are relative to the same time for repeatable results.
+    benchTime = time(NULL);
+    setTestTime(benchContext, benchTime);
+
+    benchParser = PARSER_MAPPED;
+    runBench("parse/mmap", benchParse, True);
+    benchParser = PARSER_BISON;
+    runBench("yyparse", benchParse, True);
+    runBench("load/cache", benchLoadCached, True);
+    runBench("calcNextTimeForTask", benchCalcNextTimeForTask, False);
+    setDispatchMode(benchContext, DISPATCH_QUEUE);
+    runBench("calcNextTaskAlarm/queue", benchCalcNextTaskAlarm, False);
+    setDispatchMode(benchContext, DISPATCH_WHEEL);
+    runBench("calcNextTaskAlarm/wheel", benchCalcNextTaskAlarm, False);
+    setDispatchMode(benchContext, DISPATCH_QUEUE);
+    runBench("getScheduledEvents", benchGetScheduledEvents, False);
+    runBench("scan/list", benchScanList, False);
+    runBench("scan/store", benchScanStore, False);
+    runBench("match/per-entry", benchMatchPerEntry, False);
+    benchMatches = malloc(sizeof(scheduleEntry *) * numEntries);
+    assert(benchMatches != NULL);
+    // Only the kernels the processor supports.
+    for (kernel = MATCH_SCALAR; kernel <= MATCH_AVX2; kernel++) {
+        if (setMatchKernel(kernel) == kernel) {
+            runBench(kernelBenches[kernel], benchMatchEntriesAt, False);
+        }
+    }
+    setMatchKernel(MATCH_AUTO);
+    free(benchMatches);
+    runBench("displayTodaysSchedule", benchDisplayTodaysSchedule, False);
+
+    fclose(devNull);
+    freeScheduleContext(benchContext);
+    return SUCCESS;
+}
+
+int processArgs(int argc, char **argv) {
+	int i;
+	for (i=1; i < argc; i++) {
+        if (argv[i][0] != '-' || i + 1 >= argc) {
+            return ERROR;
+        }
+        switch (argv[i][1]) {
+        case 'n':
+            if ((numEntries = atoi(argv[++i])) <= 0) {
+                return ERROR;
+            }
+            break;
+        case 'm':
+            if (parseMix(argv[++i]) == ERROR) {
+                return ERROR;
+            }
+            break;
+        case 's':
+            seed = (unsigned)strtoul(argv[++i], NULL, 10);
+            break;
+        case 't':
+            if ((minNs = atoll(argv[++i]) * 1000000LL) <= 0) {
+                return ERROR;
+            }
+            break;
+        case 'f':
+            scheduleFileLoc = argv[++i];
+            break;
+        case 'g':
+            generateOnly = argv[++i];
+            break;
+        default: return ERROR;
+        }
+	}
+	return SUCCESS;
+}
+
+/**
+ * Parse the relative weights of each field kind in the form
+ * wildcard,single,range,step,list.  At least one weight must be positive.
+ */
+int parseMix(const char * mixStr) {
+    int kind, total = 0;
+    char * end;
+
+    for (kind = 0; kind < NUMBER_OF_KINDS; kind++) {
+        kindWeights[kind] = (int)strtol(mixStr, &end, 10);
+        if (end == mixStr || kindWeights[kind] < 0
+                || (kind < NUMBER_OF_KINDS - 1 && *end != ',')) {
+            return ERROR;
+        }
+        total += kindWeights[kind];
+        mixStr = end + 1;
+    }
+    return *end == '\0' && total > 0 ? SUCCESS : ERROR;
+}
+
+void usage() {
+	printf("Usage:  scheduleBench [-n <entries>] "
+            "[-m <wildcard,single,range,step,list>] [-s <seed>]\n"
+            "                      [-t <min ms per bench>] "
+            "[-f <schedule file>] [-g <generate only file>]\n");
+}
+
+/**
+ * Write a schedule file with the requested number of entries.  The kind of
+ * each calendar field is chosen using the mix weights.  No actions are
+ * defined, so executing entries has no side effects.
+ */
+int generateSchedule(const char * fileName, int numEntries, unsigned seed) {
+    FILE * out;
+    int entryIdx, fieldIdx;
+
+    out = fopen(fileName, "w");
+    if (out == NULL) {
+    	perror("Failed to open schedule file: ");
+        return ERROR;
+    }
+    srand(seed);
+    fprintf(out, "// Generated schedule: %d entries, mix %d,%d,%d,%d,%d\n",
+            numEntries, kindWeights[FK_WILDCARD], kindWeights[FK_SINGLE],
+            kindWeights[FK_RANGE], kindWeights[FK_STEP], kindWeights[FK_LIST]);
+    for (entryIdx = 0; entryIdx < numEntries; entryIdx++) {
+        fprintf(out, "*");
+        for (fieldIdx = 0; fieldIdx < 5; fieldIdx++) {
+            fprintf(out, " ");
+            writeField(out, &fieldRanges[fieldIdx]);
+        }
+        fprintf(out, " %d \"Task %d\" \"Reminder for task %d\"\n",
+                rand() % 120, entryIdx, entryIdx);
+    }
+    fclose(out);
+    return SUCCESS;
+}
+
+/**
+ * Write a single calendar field of a kind chosen using the mix weights.
+ */
+void writeField(FILE * out, const fieldRange * range) {
+    int kind, pick, total = 0, span, begin, end, count, value;
+
+    span = range->maxVal - range->minVal + 1;
+    for (kind = 0; kind < NUMBER_OF_KINDS; kind++) {
+        total += kindWeights[kind];
+    }
+    pick = rand() % total;
+    for (kind = 0; pick >= kindWeights[kind]; kind++) {
+        pick -= kindWeights[kind];
+    }
+
+    begin = range->minVal + rand() % span;
+    end = begin + rand() % (range->maxVal - begin + 1);
+    switch (kind) {
+        case FK_WILDCARD:
+            fprintf(out, "*");
+            break;
+        case FK_SINGLE:
+            fprintf(out, "%d", begin);
+            break;
+        case FK_RANGE:
+            fprintf(out, "%d-%d", begin, end);
+            break;
+        case FK_STEP:
+            fprintf(out, "%d-%d/%d", range->minVal, range->maxVal,
+                    2 + rand() % (span / 2));
+            break;
+        case FK_LIST:
+            // Two to four ascending values within the range.
+            count = 2 + rand() % 3;
+            fprintf(out, "%d", begin);
+            for (value = begin + 1 + rand() % (span / 4 + 1); 
+                    --count > 0 && value <= range->maxVal; 
+                    value += 1 + rand() % (span / 4 + 1)) {
+                fprintf(out, ",%d", value);
+            }
+            break;
+    }
+}
+
+int loadSchedule(const char * fileName) {
+    return loadScheduleFile(benchContext, fileName, benchParser);
+}
+
+long long elapsedNs(struct timespec * start, struct timespec * stop) {
+    return (stop->tv_sec - start->tv_sec) * 1000000000LL
+        + (stop->tv_nsec - start->tv_nsec);
+}
+
+/**
+ * Run the benchmark with a doubling operation count until it takes at least
+ * the minimum time and report the final run.  If the benchmark loads the
+ * schedule, the arena holding it is reported as well.
+ */
+void runBench(const char * name, benchFunc func, Bool loads) {
+    struct timespec start, stop;
+    benchResult result;
+    long long count = 1;
+
+    for (;;) {
+        allocCount = allocBytes = 0;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        func(count);
+        clock_gettime(CLOCK_MONOTONIC, &stop);
+        result.ops = count;
+        result.elapsedNs = elapsedNs(&start, &stop);
+        result.allocs = allocCount;
+        result.allocBytes = allocBytes;
+        result.loads = loads;
+        getArenaStats(benchContext->arena, &result.arena);
+        result.poolStrings = benchContext->strings != NULL 
+            ? getStringPoolCount(benchContext->strings) : 0;
+        result.poolBytes = benchContext->strings != NULL 
+            ? benchContext->strings->bytes : 0;
+        if (result.elapsedNs >= minNs || count >= (1LL << 40)) {
+            break;
+        }
+        count *= 2;
+    }
+    reportBench(name, &result);
+}
+
+void reportBench(const char * name, benchResult * result) {
+    printf("{\"bench\":\"%s\",\"entries\":%d,\"ops\":%lld,"
+            "\"ns_per_op\":%.1f", name, numEntries, result->ops,
+            (double)result->elapsedNs / result->ops);
+    if (COUNTS_ALLOCS) {
+        printf(",\"allocs_per_op\":%.2f,\"bytes_per_op\":%.1f",
+                (double)result->allocs / result->ops,
+                (double)result->allocBytes / result->ops);
+    }
+    else {
+        printf(",\"allocs_per_op\":null,\"bytes_per_op\":null");
+    }
+    if (result->loads) {
+        printf(",\"arena_chunks\":%zu,\"arena_allocs\":%zu,"
+                "\"arena_bytes_used\":%zu,\"arena_bytes_reserved\":%zu",
+                result->arena.chunks, result->arena.allocs,
+                result->arena.bytesUsed, result->arena.bytesReserved);
+        printf(",\"pool_strings\":%u,\"pool_bytes\":%zu",
+                result->poolStrings, result->poolBytes);
+    }
+    printf("}\n");
+    fflush(stdout);
+}
+
+/**
+ * Parse the whole schedule file using benchParser.  The previous schedule is
+ * freed first, so the schedule is left loaded once for the remaining 
+ * benchmarks.
+ */
+void benchParse(long long count) {
+    for (; count > 0; count--) {
+        freeSchedule(benchContext);
+        loadSchedule(scheduleFileLoc);
+    }
+}
+
+/**
+ * Load the schedule through its cache.  The first load builds the cache, 
+ * which is then used by the rest.
+ */
+void benchLoadCached(long long count) {
+    for (; count > 0; count--) {
+        freeSchedule(benchContext);
+        loadScheduleCached(benchContext, scheduleFileLoc, PARSER_MAPPED);
+    }
+}
+
+/**
+ * One operation is the next time of a single entry.
+ */
+void benchCalcNextTimeForTask(long long count) {
+    scheduleNode * current = NULL;
+
+    for (; count > 0; count--) {
+        if (current == NULL) {
+            current = getScheduleEntries(benchContext);
+        }
+        calcNextTimeForTask(benchContext, current->entry);
+        current = current->next;
+    }
+}
+
+/**
+ * One operation is returning and executing the next alarm.  The first
+ * operation includes building the dispatch structure.
+ */
+void benchCalcNextTaskAlarm(long long count) {
+    scheduledExec * task;
+
+    resetTaskAlarmQueue(benchContext);
+    for (; count > 0; count--) {
+        task = calcNextTaskAlarm(benchContext);
+        if (task == NULL) {
+            break;
+        }
+        executeScheduledEntry(benchContext, task);
+        free(task);
+    }
+}
+
+/**
+ * One operation is the next events for all entries within the next day.
+ */
+void benchGetScheduledEvents(long long count) {
+    eventEntry ** events;
+    int numEvents;
+
+    for (; count > 0; count--) {
+        events = getScheduledEvents(benchContext, benchTime, 
+                benchTime + 86400, &numEvents);
+        freeEventSchedule(events, numEvents);
+    }
+}
+
+/**
+ * One operation is the next time of every entry found by walking the list 
+ * of entries, as a full scan did before the entry store.
+ */
+void benchScanList(long long count) {
+    scheduleNode * current;
+
+    for (; count > 0; count--) {
+        for (current = getScheduleEntries(benchContext); current != NULL;
+                current = current->next) {
+            calcNextTimeForTaskFrom(current->entry, benchTime);
+        }
+    }
+}
+
+/**
+ * One operation is getScheduledEvents for the next day with no cached next
+ * times, so the next time of every entry is calculated from the store.
+ */
+void benchScanStore(long long count) {
+    eventEntry ** events;
+    int numEvents;
+
+    for (; count > 0; count--) {
+        clearStoreTimes(benchContext->store);
+        events = getScheduledEvents(benchContext, benchTime, 
+                benchTime + 86400, &numEvents);
+        freeEventSchedule(events, numEvents);
+    }
+}
+
+/**
+ * One operation is finding the entries due at one minute by calculating 
+ * the next time of each entry from the minute before.  Minutes cycle 
+ * through the day following benchTime.
+ */
+void benchMatchPerEntry(long long count) {
+    scheduleNode * current;
+    time_t minuteTime;
+
+    for (; count > 0; count--) {
+        minuteTime = benchTime - benchTime % 60 + (count % 1440 + 1) * 60;
+        for (current = getScheduleEntries(benchContext); current != NULL;
+                current = current->next) {
+            if (calcNextTimeForTaskFrom(current->entry, minuteTime - 60) 
+                    == minuteTime) {
+                matchCount++;
+            }
+        }
+    }
+}
+
+/**
+ * One operation is matchEntriesAt for one minute, using the minutes of 
+ * benchMatchPerEntry.
+ */
+void benchMatchEntriesAt(long long count) {
+    time_t minuteTime;
+
+    for (; count > 0; count--) {
+        minuteTime = benchTime - benchTime % 60 + (count % 1440 + 1) * 60;
+        matchCount += matchEntriesAt(benchContext, minuteTime, benchMatches, 
+                numEntries);
+    }
+}
+
+void benchDisplayTodaysSchedule(long long count) {
+    for (; count > 0; count--) {
+        displayTodaysSchedule(benchContext, devNull);
+    }
+}
@@ -0,0 +1,139 @@
+#ifndef _ENTRYSTORE_H_
+#define _ENTRYSTORE_H_
+#include <stdint.h>
+#include <time.h>
+#include "schedule.h"
+
+// storeId of an entry not within a store
+#define ENTRY_NOT_STORED UINT32_MAX
+// Fewest entries a store has room for once used
+#define MIN_STORE_ENTRIES 64
+
+// Flags of a stored entry
+#define ENTRY_LIVE      0x01    // ID is in use.  Clear if free
+#define ENTRY_ANY_YEAR  0x02    // Year is a wildcard, so years is not read
+#define ENTRY_TIMED     0x04    // nextTimes holds a calculated time
+
+// Number of IDs matched at once by matchStoreEntries
+#define MATCH_BLOCK 32
+
+/**
+ * Kernel used by matchStoreEntries to match a block of IDs.
+ *  MATCH_AUTO    Widest kernel supported by the processor.  Default.
+ *  MATCH_SCALAR  One ID at a time.  Used on all other processors.
+ *  MATCH_SSE4    16 bytes of each array at a time.  Requires SSE4.1.
+ *  MATCH_AVX2    32 bytes of each array at a time.  Requires AVX2.
+ */
+enum MatchKernel {MATCH_AUTO, MATCH_SCALAR, MATCH_SSE4, MATCH_AVX2};
+
+/**
+ * Entries of a schedule laid out by ID for scans of the whole schedule.
+ * Hot data, read for every entry by a scan, is held in parallel arrays
+ * with one element per ID: each compiled calendar field, the cached next
+ * time and the flags.  A scan reads each array from start to end.  Cold
+ * data, only read for the entries a scan selects, is held in parallel
+ * arrays of the same layout.
+ *
+ * An entry keeps its ID, held in storeId, while within the schedule.  IDs
+ * of removed entries are reused by later entries, so the arrays only grow
+ * to the most entries the schedule has held at once.  The calendar fields
+ * are copied when the entry is stored, so a stored entry must not be
+ * compiled again.
+ *
+ * Next times are cached by scans of the schedule.  A time calculated from
+ * some earlier time holds for any later time before it, so cached times are
+ * reused until reached.  calcTime is the latest time from which a cached
+ * time was calculated.  Scans from before it recalculate every time.  Times
+ * no longer hold if the clock is set or the time zone changes and must then
+ * be cleared using clearStoreTimes.
+ */
+typedef struct _entryStore {
+    // Hot
+    uint64_t * minutes;         // Compiled calendar fields.  See calendarMask
+    uint32_t * hours;
+    uint32_t * daysOfMonth;
+    uint16_t * monthsOfYear;
+    uint8_t * daysOfWeek;
+    uint8_t * flags;
+    time_t * nextTimes;         // Valid if ENTRY_TIMED
+    // Cold
+    scheduleEntry ** entries;
+    valueStruct ** years;       // Year of the entry.  Not read if any year
+
+    uint32_t * freeIds;         // IDs to reuse, last removed at the end
+    uint32_t freeCount;
+    uint32_t count;             // IDs used or freed
+    uint32_t capacity;          // Of each array
+    time_t calcTime;
+} entryStore;
+
+/**
+ * Create an empty store.  No arrays are allocated until first used.
+ * Must be freed using freeEntryStore.
+ */
+entryStore * createEntryStore();
+
+/**
+ * Free the store.  The stored entries are not freed.
+ */
+void freeEntryStore(entryStore * store);
+
+/**
+ * Add the entry to the store, setting its storeId.  The ID most recently
+ * freed is reused, otherwise the next ID.
+ * Returns:
+ *  ID of the entry.
+ */
+uint32_t addStoreEntry(entryStore * store, scheduleEntry * entry);
+
+/**
+ * Remove the entry from the store, freeing its ID.  Ignored if the entry
+ * is not within the store or store is NULL.
+ */
+void removeStoreEntry(entryStore * store, scheduleEntry * entry);
+
+/**
+ * Returns:
+ *  True if the entry is within the store.
+ */
+Bool isStoreEntry(entryStore * store, scheduleEntry * entry);
+
+/**
+ * Return the number of entries within the store.
+ */
+uint32_t getStoreEntryCount(entryStore * store);
+
+/**
+ * Discard the cached next time of every entry, so the next scan calculates
+ * each again.  Ignored if store is NULL.
+ */
+void clearStoreTimes(entryStore * store);
+
+/**
+ * Find the live entries whose compiled calendar fields all contain a time.
+ * The time is given as a calendarMask with the bit of its value set in each
+ * field.  Each field array is ANDed with the bit of the time for a block of
+ * MATCH_BLOCK IDs at once.  Year is not matched.
+ * Args:
+ *  store   Store to search
+ *  time    Bits of the time
+ *  startId First ID searched
+ *  ids     Filled with the matching IDs in ascending order
+ *  maxIds  Number of IDs ids can hold
+ * Returns:
+ *  Number of IDs placed in ids.  If maxIds, more IDs may match after the
+ *  last one placed.
+ */
+uint32_t matchStoreEntries(entryStore * store, calendarMask * time,
+        uint32_t startId, uint32_t * ids, uint32_t maxIds);
+
+/**
+ * Select the kernel used by matchStoreEntries for all stores.  A kernel the
+ * processor does not support is replaced by the widest one it does.  For
+ * testing and benchmarks.
+ * Returns:
+ *  The kernel selected.
+ */
+enum MatchKernel setMatchKernel(enum MatchKernel kernel);
+
+#endif // _ENTRYSTORE_H_
@@ -0,0 +1,58 @@
+#ifndef _EXECUTOR_H_
+#define _EXECUTOR_H_
+#include "schedule.h"
+#include "fireQueue.h"
+
+// Largest number of executor threads
+#define MAX_EXECUTORS 64
+
+/**
+ * Start count executor threads consuming a fire queue of queueCapacity
+ * records.  Once started, executeScheduledEntry hands each entry to the
+ * executors instead of running its actions, so the thread computing the
+ * next alarm only does time math and timer arming.  An entry the queue has
+ * no room for is run inline.  Should be started after the launcher as the
+ * launcher is forked.
+ * Returns:
+ *  0 on success, otherwise 1 and actions are run inline.
+ */
+int startExecutors(int count, size_t queueCapacity);
+
+/**
+ * Run the actions of all queued records, then stop and join the executor
+ * threads.  Actions are run inline from then on.
+ */
+void stopExecutors();
+
+/**
+ * Wait until every queued record has run and no executor is running 
+ * actions, then resume with the same number of executors.  Required before
+ * entries are freed while the executors are running.  The queue counters 
+ * start again from 0.
+ * Returns:
+ *  0 on success, otherwise 1 and actions are run inline.
+ */
+int drainExecutors();
+
+/**
+ * Return the number of executor threads running.  0 if not started.
+ */
+int getExecutorCount();
+
+/**
+ * Queue the actions of the entry for execution by an executor.  Never
+ * blocks.
+ * Returns:
+ *  True if queued, False if the queue was full or the executors are not
+ *  running.  The record is not queued and the caller must run it.
+ */
+Bool dispatchFire(scheduleContext * ctx, scheduleEntry * entry, 
+        time_t absTime);
+
+/**
+ * Copy the counters of the executor fire queue to stats.  All counters are
+ * 0 if the executors have not been started.
+ */
+void getExecutorStats(fireQueueStats * stats);
+
+#endif // _EXECUTOR_H_
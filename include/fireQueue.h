@@ -0,0 +1,89 @@
+#ifndef _FIREQUEUE_H_
+#define _FIREQUEUE_H_
+#include <stdatomic.h>
+#include "schedule.h"
+
+// Assumed cache line size used to keep producer and consumer indexes apart
+#define FIRE_CACHE_LINE 64
+// Number of fire records held by the executor queue.  Must be a power of 2.
+#define FIRE_QUEUE_CAPACITY 1024
+
+/**
+ * Request to execute the actions of an entry for its scheduled time.
+ */
+typedef struct _fireRecord {
+    time_t absTime;
+    scheduleContext * context;
+    scheduleEntry * entry;
+} fireRecord;
+
+/**
+ * Slot within the ring.  sequence tells producers and consumers whose turn
+ * it is to use the slot.
+ */
+typedef struct _fireSlot {
+    atomic_size_t sequence;
+    fireRecord record;
+} fireSlot;
+
+/**
+ * Bounded lock-free ring of fire records.  Any number of threads may push
+ * and pop.  Each slot carries a sequence number so a producer claims a slot
+ * with a single compare and swap on tail and publishes the record by
+ * advancing the sequence.  Consumers do the same on head.  When the ring is
+ * full, the record is dropped and counted rather than blocking the producer.
+ */
+typedef struct _fireQueue {
+    fireSlot * slots;
+    size_t mask;                // Capacity - 1
+    char pad0[FIRE_CACHE_LINE];
+    atomic_size_t tail;         // Next position to push
+    char pad1[FIRE_CACHE_LINE];
+    atomic_size_t head;         // Next position to pop
+    char pad2[FIRE_CACHE_LINE];
+    atomic_size_t pushed;       // Records pushed since created
+    atomic_size_t dropped;      // Records dropped as the ring was full
+    atomic_size_t maxDepth;     // Largest depth seen by a producer
+} fireQueue;
+
+/**
+ * Counters describing the use of a fire queue.
+ */
+typedef struct _fireQueueStats {
+    size_t capacity;
+    size_t depth;               // Records waiting to be popped
+    size_t maxDepth;
+    size_t pushed;
+    size_t dropped;
+} fireQueueStats;
+
+/**
+ * Create an empty ring holding capacity records.  capacity is rounded up to
+ * a power of 2.
+ * Must be freed using freeFireQueue.
+ */
+fireQueue * createFireQueue(size_t capacity);
+
+void freeFireQueue(fireQueue * queue);
+
+/**
+ * Add the record to the ring without blocking.
+ * Returns:
+ *  True if added, False if the ring was full and the record was dropped.
+ */
+Bool pushFireQueue(fireQueue * queue, const fireRecord * record);
+
+/**
+ * Remove the oldest record from the ring without blocking.
+ * Returns:
+ *  True if a record was copied to record, False if the ring was empty.
+ */
+Bool popFireQueue(fireQueue * queue, fireRecord * record);
+
+/**
+ * Copy the current counters of the ring to stats.  depth is approximate
+ * while other threads are using the ring.
+ */
+void getFireQueueStats(fireQueue * queue, fireQueueStats * stats);
+
+#endif // _FIREQUEUE_H_
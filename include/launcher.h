@@ -0,0 +1,62 @@
+#ifndef _LAUNCHER_H_
+#define _LAUNCHER_H_
+#include <sys/types.h>
+
+// Largest launch request including all arguments and their terminators
+#define LAUNCH_MAX_REQUEST 8192
+// Largest number of arguments within a launch request
+#define LAUNCH_MAX_ARGS 256
+
+/**
+ * Reply sent by the launcher for each request and for each launched command
+ * that exits.
+ *  LM_LAUNCHED  status is 0 or the error number if the launch failed
+ *  LM_EXITED    status is the wait status of the command
+ */
+enum LaunchMsgType {LM_LAUNCHED, LM_EXITED};
+
+typedef struct _launchReply {
+    enum LaunchMsgType type;
+    pid_t pid;
+    int status;
+} launchReply;
+
+/**
+ * Fork the launcher, a small helper process that launches commands on behalf
+ * of the scheduler.  Should be started before the schedule is loaded so the
+ * helper is small and forking within it stays cheap as the schedule grows.
+ * Requests and replies are sent over a stream socketpair.  Once started,
+ * spawnArgs sends all launches to the launcher.
+ * Returns:
+ *  0 on success, otherwise 1 and commands are launched directly.
+ */
+int startLauncher();
+
+/**
+ * Close the connection to the launcher and wait for it to exit.  Commands
+ * are launched directly from then on.
+ */
+void stopLauncher();
+
+/**
+ * Return the socket connected to the launcher or -1 if not started.  The
+ * socket is readable when the launcher reports a command has exited.
+ */
+int getLauncherFd();
+
+/**
+ * Ask the launcher to execute the program named by argv[0] and wait for it
+ * to confirm the launch.
+ * Returns:
+ *  Process id of the command or -1 if it could not be launched.
+ */
+pid_t launcherSpawn(char * const argv[]);
+
+/**
+ * Read all exit reports from the launcher without blocking.
+ * Returns:
+ *  Number of launched commands that have exited.
+ */
+int collectLauncherExits();
+
+#endif // _LAUNCHER_H_
@@ -2,7 +2,13 @@
 #define _SCHEDULE_H_
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <time.h>
+#include <sys/types.h>
+
+// Misc
+enum BoolEnum {False, True};
+typedef enum BoolEnum Bool;
 
 // Action definitions
 /** 
@@ -17,6 +23,41 @@
  */
 enum ActionType {ON_DEMAND, DEFAULT, ALWAYS, PRIVATE};
 
+/**
+ * Part of a compiled action command.  Text segments are copied as is and all
+ * others are replaced with a value of the schedule entry when the command is
+ * rendered.  Placeholders within a command are:
+ *  %s or %{message}  Reminder message
+ *  %{task}           Task description
+ *  %{time}           Scheduled time as HH:MM
+ *  %{duration}       Duration of task in minutes
+ *  %%                Percent sign
+ * Any other use of % is copied as is.
+ *
+ * Commands are split into arguments at white space and executed directly.
+ * Single or double quotes group text into one argument and a backslash 
+ * outside single quotes escapes the next character.  Placeholders are not
+ * replaced within single quotes.  A placeholder value is always within a 
+ * single argument.  Commands starting with ! are passed to
+ * /bin/sh -c unsplit for those requiring pipes or redirection.
+ */
+enum SegmentType {SEG_TEXT, SEG_MESSAGE, SEG_TASK, SEG_TIME, SEG_DURATION};
+
+typedef struct _commandSegment {
+    enum SegmentType type;
+    char * text;                // SEG_TEXT only
+    int textLen;
+    struct _commandSegment * next;
+} commandSegment;
+
+/**
+ * Argument of a compiled action command.
+ */
+typedef struct _commandArg {
+    commandSegment * segments;
+    struct _commandArg * next;
+} commandArg;
+
 /**
  * Defines an action that is available for scheduling. 
  */
@@ -24,6 +65,11 @@ typedef struct _actionStruct {
 	char * name;
 	char * command;
     enum ActionType type;
+    commandArg * args;          // Compiled command
+    int argCount;
+    Bool useShell;              // Run by the shell as the command has a ! 
+    Bool timeDependent;         // Uses %{time}, so is rendered on each use
+    struct _scheduleArena * arena;  // Generation holding it.  NULL if heap
 } actionDef;
 
 /**
@@ -32,8 +78,37 @@ typedef struct _actionStruct {
 typedef struct _actionNode {
     actionDef * action;
 	struct _actionNode * next;
+    struct _scheduleArena * arena;  // Generation holding it.  NULL if heap
 } actionNode;
 
+/**
+ * Index of the actions defined by a schedule.  Names are found using a 
+ * table with open addressing on a hash of the name, at most half full.  If
+ * a name is defined more than once, the first definition is found.  The 
+ * DEFAULT and ALWAYS actions are kept in definition order, so executing an
+ * entry does not visit every defined action.  The index is allocated on the
+ * heap as it grows, unlike the actions themselves.
+ */
+typedef struct _actionIndex {
+    actionDef ** slots;         // NULL if the slot is empty
+    uint32_t slotCount;         // Power of 2.  0 until the first action
+    uint32_t used;
+    actionDef ** defaults;      // DEFAULT actions in definition order
+    int defaultCount;
+    actionDef ** always;        // ALWAYS actions in definition order
+    int alwaysCount;
+} actionIndex;
+
+/**
+ * Command of an action rendered for a schedule entry.  Task and reminder 
+ * text do not change, so the command is rendered once and reused.
+ */
+typedef struct _renderedCommand {
+    actionDef * action;
+    char ** argv;               // Single allocation, see renderActionArgs
+    struct _renderedCommand * next;
+} renderedCommand;
+
 /**
  *  Calendar entry value types.  
  *  - WILDCARD: Used to allow any value within the applicable range.
@@ -63,6 +138,20 @@ typedef struct _valStruct {
     };
 } valueStruct;
 
+/**
+ *  Compiled form of the calendar values of a schedule entry.  Each field is a
+ *  bitset where bit n is set if value n is allowed, so the next allowed value
+ *  at or after x can be found with a mask and a count-trailing-zeros.  Year
+ *  is unbounded and is not compiled.  See compileScheduleEntry.
+ */
+typedef struct _calMaskStruct {
+    uint64_t minute;            // Bits 0 - 59
+    uint32_t hour;              // Bits 0 - 23
+    uint32_t dayOfMonth;        // Bits 1 - 31
+    uint16_t monOfYear;         // Bits 0 - 11
+    uint8_t  dayOfWeek;         // Bits 0 - 6 - 0 is Sunday
+} calendarMask;
+
 /**
  * Represents a complete schedule entry including:
  * - schedule at which action set will be performed
@@ -77,10 +166,22 @@ typedef struct _scheduleStruct {
 	valueStruct dayOfWeek; 		// 0 - 6 - 0 is Sunday
 	valueStruct hour; 			// 0 - 23
 	valueStruct minute;			// 0 - 59
+    calendarMask compiled;      // Compiled monOfYear - minute values
 	int durationInMin;
 	char * task;
 	char * reminderMessage;
+    uint32_t taskId;            // IDs of the text within the string pool of
+    uint32_t reminderId;        // the schedule.  0 if not within a schedule
+    Bool sharedText;            // Text is within a file mapped by the schedule
     actionNode * actionSet;
+    renderedCommand * rendered; // Commands rendered for this entry
+    uint64_t contentHash;       // See hashScheduleEntry.  0 until calculated
+    int alarmSlot;              // Position within the alarm queue
+    struct _wheelTimer * alarmTimer;    // Timer within the alarm wheel
+    uint32_t storeId;           // ID within the entry store of the schedule
+    int listPos;                // Position within the schedule list
+    struct _scheduleArena * arena;  // Generation holding the entry, its
+                                    // values and text.  NULL if heap
 } scheduleEntry;
 
 /**
@@ -91,18 +192,65 @@ typedef struct _scheduleNode {
 	struct _scheduleNode * next;
 } scheduleNode;
 
+/**
+ * Broken down local calendar time.  Unlike struct tm, year includes century.
+ * Month is 0 - 11 and day of month is 1 - 31.
+ */
+typedef struct _calTime {
+    int year;
+    int mon;
+    int mday;
+    int hour;
+    int min;
+} calTime;
+
+/**
+ * Iterator over every occurrence of a schedule entry within a time window.
+ * Allocated by the caller.  No memory is allocated while iterating.
+ * See initOccurrenceIter.
+ */
+typedef struct _occurrenceIter {
+    scheduleEntry * entry;
+    time_t stopTime;            // Last time included in the window
+    time_t lastTime;            // Previous occurrence returned
+    calTime next;               // Calendar time to resume the search from
+    Bool done;
+} occurrenceIter;
+
 /*
  * Represents the absolute time for an event based on the schedule and
- * the time it was created.  May be in the past.
+ * the time it was created.  May be in the past.  Text is borrowed from the
+ * string pool of the schedule, found by ID or directly.
  */
 typedef struct _eventStruct {
     time_t nextTime;            // Next scheduled time for this event
 	int durationInMin;
 	char * task;
 	char * reminderMessage;
+    uint32_t taskId;
+    uint32_t reminderId;
     actionNode * actionSet;
 } eventEntry;
 
+/**
+ * Stream of events for all schedule entries within a time window in time 
+ * order.  Each entry has an occurrence iterator and the iterators are merged
+ * using a min-heap ordered by their pending occurrence, so memory is 
+ * proportional to the number of entries rather than the number of events.
+ * See openAgenda.
+ */
+typedef struct _agendaStream {
+    occurrenceIter * iters;     // One iterator per schedule entry
+    occurrenceIter ** heap;     // Iterators with a pending occurrence
+    int heapCount;
+} agendaStream;
+
+/**
+ * Invoked by generateAgenda for each event.  The event and its strings are
+ * only valid during the call.  Return False to stop generating events.
+ */
+typedef Bool (*agendaCallback)(eventEntry * event, void * userData);
+
 /*
  * Represents the next set of tasks to execute providing the absolute time
  * and a list of tasks.
@@ -112,26 +260,291 @@ typedef struct _scheduledExec {
 	scheduleNode * taskHead;
 } scheduledExec;
 
+/**
+ * Structure used by calcNextTaskAlarm to order entries by next time.
+ *  DISPATCH_QUEUE  Min-heap of entries.  Default.
+ *  DISPATCH_WHEEL  Hierarchical timing wheel.  Suited to very large schedules
+ *                  as entries are inserted and expired in constant time.
+ *  DISPATCH_MATCH  No structure.  Each following minute is matched against
+ *                  all entries using matchEntriesAt.  Suited to schedules
+ *                  where most minutes have an alarm.  Near a change of UTC
+ *                  offset, such as DST, the queue's next times are used.
+ */
+enum DispatchMode {DISPATCH_QUEUE, DISPATCH_WHEEL, DISPATCH_MATCH};
+
+/**
+ * A schedule: its entries, defined actions and the structures used to 
+ * dispatch its alarms.  Each context is independent, so several schedules
+ * may be loaded in one process and a new schedule may be built while 
+ * another is running.  A context may only be used by one thread at a time,
+ * other than by the executors running its actions.
+ * Created with createScheduleContext and freed with freeScheduleContext.
+ */
+typedef struct _scheduleContext {
+    scheduleNode * schedHead;   // All entries in the order added
+    scheduleNode * schedTail;
+    int scheduleCount;
+    actionNode * cmdHead;       // All defined actions in the order added
+    actionNode * cmdTail;
+    actionIndex actions;        // Index of the defined actions
+    // Task and reminder text of all entries, each distinct string once.
+    // Created on first use.  See stringPool.
+    struct _stringPool * strings;
+    struct _mappedFile * mappedFiles;   // Holds text of shared entries
+    // Entries, actions and the nodes listing them are allocated from the
+    // current generation, followed by older generations still holding
+    // entries kept by a reload.  Created on first use.  See scheduleArena.
+    struct _scheduleArena * arena;
+    // Calendar fields and next times of all entries laid out by ID for 
+    // scans of the whole schedule.  Created on first use.  See entryStore.
+    struct _entryStore * store;
+
+    // Entries ordered by next time.  Built on first use by calcNextTaskAlarm.
+    // When using the timing wheel, the timers of the most recently returned
+    // alarm are held until that alarm has executed and they can be
+    // recalculated.
+    enum DispatchMode dispatchMode;
+    struct _taskQueue * alarmQueue;
+    struct _timingWheel * alarmWheel;
+    struct _wheelTimer * dueTimers;
+    time_t dueTime;
+
+    // Time of the most recently executed alarm.  The timer may expire before
+    // the current time reaches the alarm time, so this is used as the 
+    // current time if it is later to prevent the same alarm from being
+    // returned again.
+    time_t lastExecTime;
+
+    // Used in testing.  Allows test program to set "current" time.
+    time_t timeOverride;
+
+    // Reloads the schedule when its file changes.  See watchScheduleFile.
+    struct _scheduleWatch * watch;
+} scheduleContext;
 
-// Misc
-enum BoolEnum {False, True};
-typedef enum BoolEnum Bool;
 
 /* -----------------------------------------------------------------------------
  *  Prototypes
  * ---------------------------------------------------------------------------*/
-void displaySchedule(FILE * out);
-void displayTodaysSchedule(FILE * out);
-void runNotifications();
 
-time_t calcNextTimeForTask(scheduleEntry *entry);
+/**
+ * Create an empty schedule using the queue for dispatch.
+ * Must be freed using freeScheduleContext.
+ */
+scheduleContext * createScheduleContext();
+
+/**
+ * Free the schedule as with freeSchedule and the context itself.
+ */
+void freeScheduleContext(scheduleContext * ctx);
+
+/**
+ * Parse the schedule file, adding its actions and entries to the schedule.
+ * The parser and scanner keep no global state, so separate schedules may be
+ * parsed by concurrent threads.
+ * Returns:
+ *  0 if the file was parsed, otherwise non zero.
+ */
+int parseScheduleFile(scheduleContext * ctx, FILE * file);
+
+void displaySchedule(scheduleContext * ctx, FILE * out);
+void displayTodaysSchedule(scheduleContext * ctx, FILE * out);
+void displayUpcomingEvents(scheduleContext * ctx, FILE * out, int maxEvents);
+void runNotifications(scheduleContext * ctx);
+
+/**
+ * Returns the next time that the provided entry should be activated relative
+ * to the current time.  If in the past, TIME_IN_PAST (-1) is returned.
+ */
+time_t calcNextTimeForTask(scheduleContext * ctx, scheduleEntry *entry);
+
+/**
+ * Returns the next time that the provided entry should be activated relative
+ * to the provided time rather than the current time.  The next time is always
+ * after the minute containing currentTime.
+ */
+time_t calcNextTimeForTaskFrom(scheduleEntry *entry, time_t currentTime);
+
+/**
+ * Civil calendar arithmetic used in place of mktime and localtime.  Days are
+ * counted from 1970-01-01 and are negative before it.  Month is 0 - 11.
+ *  daysFromCivil    Days since 1970-01-01 of the date.
+ *  civilFromDays    Sets the year, month and day of month of cal.  Inverse of
+ *                   daysFromCivil.
+ *  weekdayFromDays  Day of week of the date, 0 is Sunday.
+ *  floorDiv         Division rounding toward negative infinity.
+ *  timeToCalTime    Local calendar time of time.  Seconds are discarded.
+ *  calTimeToTime    Time of the local calendar time.  A local time repeated
+ *                   by a change of UTC offset returns the first occurrence
+ *                   later than after.  A skipped one returns the time 
+ *                   following the change.
+ * Offsets from UTC are cached by local day.  The cache is discarded by
+ * resetTaskAlarmQueue.
+ */
+long daysFromCivil(int year, int month, int day);
+void civilFromDays(long days, calTime *cal);
+int weekdayFromDays(long days);
+long floorDiv(long value, long divisor);
+void timeToCalTime(time_t time, calTime *cal);
+time_t calTimeToTime(calTime *cal, time_t after);
+
+/**
+ * Calculate the next time for each entry relative to the current time.  The
+ * current time is read and converted to calendar time once for all entries.
+ * Args:
+ *  entries     Array of entries
+ *  numEntries  Number of entries within entries and nextTimes
+ *  nextTimes   Populated with the next time, or TIME_IN_PAST, for the entry
+ *              at the same index.
+ */
+void calcNextTimesForTasks(scheduleContext * ctx, scheduleEntry ** entries,
+        int numEntries, 
+        time_t * nextTimes);
+
+/**
+ * Calculate the next time for each entry relative to the provided time.  
+ * Results do not depend on the current time.  See calcNextTimesForTasks.
+ */
+void calcNextTimesForTasksFrom(scheduleEntry ** entries, int numEntries, 
+        time_t currentTime, time_t * nextTimes);
+
+/**
+ * Initialize the iterator to return each occurrence of the entry within the 
+ * window from startTime through stopTime inclusive.  Occurrences are found 
+ * by searching the calendar fields, not by testing each minute.
+ * Usage:
+ *  occurrenceIter iter;
+ *  initOccurrenceIter(&iter, entry, startTime, stopTime);
+ *  while (nextOccurrence(&iter, &occurrence)) { ... }
+ *  closeOccurrenceIter(&iter);
+ */
+void initOccurrenceIter(occurrenceIter * iter, scheduleEntry * entry,
+        time_t startTime, time_t stopTime);
+
+/**
+ * Set occurrence to the next occurrence within the window.  Occurrences are
+ * returned in ascending order.
+ * Returns:
+ *  True  if an occurrence was found.  
+ *  False if there are no more occurrences within the window.
+ */
+Bool nextOccurrence(occurrenceIter * iter, time_t * occurrence);
+
+/**
+ * Release the iterator.  No further occurrences will be returned.
+ */
+void closeOccurrenceIter(occurrenceIter * iter);
+
+/**
+ * Open a stream of all occurrences of all schedule entries from startTime 
+ * through stopTime inclusive.  Events are read in time order using 
+ * readAgenda.  Events at the same time are in schedule order.
+ * Must be freed using closeAgenda.
+ */
+agendaStream * openAgenda(scheduleContext * ctx, time_t startTime, 
+        time_t stopTime);
+
+/**
+ * Fill the buffer with the next events from the stream.  The task, reminder
+ * message and action set of each event are borrowed from the schedule entry 
+ * and must not be freed.
+ * Args:
+ *  agenda      Stream returned by openAgenda
+ *  events      Buffer to fill
+ *  maxEvents   Number of events the buffer can hold
+ * Returns:
+ *  Number of events placed in the buffer.  0 when the stream is complete.
+ */
+int readAgenda(agendaStream * agenda, eventEntry * events, int maxEvents);
+
+/**
+ * Free the stream and its iterators.
+ */
+void closeAgenda(agendaStream * agenda);
+
+/**
+ * Invoke the callback for each occurrence of all schedule entries from 
+ * startTime through stopTime inclusive in time order.  Stops early if the 
+ * callback returns False.  
+ */
+void generateAgenda(scheduleContext * ctx, time_t startTime, time_t stopTime, 
+        agendaCallback callback, void * userData);
+
+/**
+ * Fill the buffer with the next occurrences across all schedule entries in
+ * time order.  An entry may occur more than once.  Occurrences are generated
+ * only until it is known they cannot be among the first maxEvents.  The 
+ * strings and action set of each event are borrowed from the schedule entry.
+ * Args:
+ *  currentTime Occurrences are after the minute containing this time
+ *  events      Buffer to fill
+ *  maxEvents   Number of events the buffer can hold
+ * Returns:
+ *  Number of events placed in the buffer.
+ */
+int getUpcomingEvents(scheduleContext * ctx, time_t currentTime, 
+        eventEntry * events, int maxEvents);
+
+/**
+ * Find every entry whose calendar values all contain the local minute 
+ * holding time, that is every entry due at that minute.  The compiled 
+ * calendar fields of all entries are matched at once by the entry store,
+ * so no next time is calculated.
+ * Args:
+ *  time        Any time within the minute to match
+ *  matches     Buffer to fill in entry store order.  The entries are 
+ *              borrowed from the schedule.
+ *  maxMatches  Number of entries the buffer can hold
+ * Returns:
+ *  Number of entries placed in the buffer.
+ */
+int matchEntriesAt(scheduleContext * ctx, time_t time, 
+        scheduleEntry ** matches, int maxMatches);
 
-scheduledExec * calcNextTaskAlarm();
+/**
+ * Return next scheduled time and the list of tasks to execute at that time.  
+ * Entries are kept in a queue ordered by next time.  Only entries that have
+ * been executed since the previous call are recalculated.
+ * If no future tasks are scheduled, then a null value will be returned.  
+ * Returned value must be freed by caller. 
+ */
+scheduledExec * calcNextTaskAlarm(scheduleContext * ctx);
+
+/**
+ * Select the structure used by calcNextTaskAlarm.  Any existing structure is
+ * discarded as with resetTaskAlarmQueue.
+ */
+void setDispatchMode(scheduleContext * ctx, enum DispatchMode mode);
+
+/**
+ * Discard the queue of next times used by calcNextTaskAlarm. The queue will 
+ * be rebuilt from all schedule entries on the next call.  Must be invoked if 
+ * the current time changes other than by moving forward, e.g. the system 
+ * clock is set back, or the time zone changes.  Next times cached by the 
+ * entry store and UTC offsets are discarded as well.
+ */
+void resetTaskAlarmQueue(scheduleContext * ctx);
+
+/**
+ * Add the entry to the alarm queue or wheel at its next time if either has
+ * been built.  An entry earlier than an alarm already returned by 
+ * calcNextTaskAlarm, but not yet executed, will be returned first by the 
+ * next call.
+ */
+void addEntryAlarm(scheduleContext * ctx, scheduleEntry * entry);
+
+/**
+ * Remove the entry from the alarm queue or wheel, so it is no longer 
+ * returned by calcNextTaskAlarm.  Alarms already returned still refer to the
+ * entry and must be discarded before the entry is freed.
+ */
+void removeEntryAlarm(scheduleContext * ctx, scheduleEntry * entry);
 
 /**
  * Add a schedule entry to the list of entries using the 
  * values provided.  
  * Args:
+ *  ctx         Schedule receiving the entry
  *  year        4 digit year or -1 for wildcard
  *  month       Valid values: 1 - 12 or -1 for wildcard
  *  dayOfMonth  Valid values: 1 - 31 or -1 for wildcard
@@ -146,8 +559,8 @@ scheduledExec * calcNextTaskAlarm();
  *  SUCCESS if entry created.
  *  ERROR   if error occurred during add.  Entry was not created.
  */
-int addScheduleEntry(int year, int month, int dayOfMonth,
-		int dayOfWeek, int hour, int minute,  int duration,
+int addScheduleEntry(scheduleContext * ctx, int year, int month, 
+        int dayOfMonth, int dayOfWeek, int hour, int minute,  int duration,
 		const char * task, const char * reminder, 
         actionNode * actionSet);
 
@@ -155,6 +568,7 @@ int addScheduleEntry(int year, int month, int dayOfMonth,
  * Add a schedule entry to the list of entries using the 
  * values provided.  
  * Args:
+ *  ctx         Schedule receiving the entry
  *  year        4 digit year or -1 for wildcard
  *  month       Valid values: 1 - 12 or -1 for wildcard
  *  dayOfMonth  Valid values: 1 - 31 or -1 for wildcard
@@ -169,15 +583,16 @@ int addScheduleEntry(int year, int month, int dayOfMonth,
  *  SUCCESS if entry created.
  *  ERROR   if error occurred during add.  Entry was not created.
  */
-int addScheduleEntryAdv(valueStruct * year, valueStruct * month, 
-        valueStruct * dayOfMonth, valueStruct * dayOfWeek, valueStruct * hour, 
-        valueStruct * minute,  int duration,
+int addScheduleEntryAdv(scheduleContext * ctx, valueStruct * year, 
+        valueStruct * month, valueStruct * dayOfMonth, valueStruct * dayOfWeek,
+        valueStruct * hour, valueStruct * minute,  int duration,
 		const char * task, const char * reminder);
 
 /**
  * Add a schedule entry to the list of entries using the 
  * values provided.  
  * Args:
+ *  ctx         Schedule receiving the entry
  *  year        4 digit year 
  *  month       Valid values: 1 - 12 
  *  dayOfMonth  Valid values: 1 - 31 
@@ -193,12 +608,47 @@ int addScheduleEntryAdv(valueStruct * year, valueStruct * month,
  *  SUCCESS if entry created.
  *  ERROR   if error occurred during add.  Entry was not created.
  */
-int addScheduleEntryNormalize(valueStruct * year, valueStruct * month, 
-        valueStruct * dayOfMonth, valueStruct * dayOfWeek, valueStruct * hour, 
-        valueStruct * minute,  int duration,
+int addScheduleEntryNormalize(scheduleContext * ctx, valueStruct * year, 
+        valueStruct * month, valueStruct * dayOfMonth, valueStruct * dayOfWeek,
+        valueStruct * hour, valueStruct * minute,  int duration,
 		const char * task, const char * reminder,
         actionNode * actionSet);
 
+/**
+ * Add a schedule entry as with addScheduleEntryNormalize, but the entry 
+ * refers to task and reminder instead of copying them.  Both must remain 
+ * valid until the schedule is freed.  Used by parseMappedScheduleFile.
+ */
+int addScheduleEntryShared(scheduleContext * ctx, valueStruct * year, 
+        valueStruct * month, valueStruct * dayOfMonth, valueStruct * dayOfWeek,
+        valueStruct * hour, valueStruct * minute,  int duration,
+		char * task, char * reminder, actionNode * actionSet);
+
+/**
+ * Add a schedule entry as with addScheduleEntryShared, but the calendar 
+ * values are already normalized and compiled.  Used by the schedule cache.
+ */
+int addCompiledScheduleEntry(scheduleContext * ctx, valueStruct * year, 
+        valueStruct * month, valueStruct * dayOfMonth, valueStruct * dayOfWeek,
+        valueStruct * hour, valueStruct * minute, calendarMask * compiled,
+        int duration, char * task, char * reminder, actionNode * actionSet);
+
+/**
+ * Set the text of the entry to the task and reminder interned within the 
+ * string pool of the schedule, so entries with the same text share one 
+ * copy.  Shared text is within a file mapped by the schedule and is 
+ * referred to rather than copied unless already interned.
+ */
+void internEntryText(scheduleContext * ctx, scheduleEntry * entry, 
+        const char * task, const char * reminder, Bool shared);
+
+/**
+ * Add the entry to the entry store of the schedule unless already stored.
+ * Entries added to the schedule are stored as they are added.  Only needed
+ * for entries placed within the schedule otherwise, such as by a reload.
+ */
+void storeScheduleEntry(scheduleContext * ctx, scheduleEntry * entry);
+
 /**
  * Create a schedule entry using the values provided.  
  * Must be freed using freeScheduleEntry(entry *)
@@ -248,14 +698,64 @@ scheduleEntry * createScheduleEntryAdv(valueStruct * year, valueStruct * month,
         valueStruct * minute,  int duration,
 		const char * task, const char * reminder);
 /**
- * Free the schedule entry and all associated allocations.
+ * Compile the calendar values of the entry into bitsets used when calculating
+ * the next time for the entry.  Invoked when the entry is created and must be
+ * invoked again if any of the calendar values are modified afterwards.  The
+ * entries of a schedule must not be modified.
+ */
+void compileScheduleEntry(scheduleEntry *entry);
+
+/**
+ * Free the schedule entry and all associated allocations.  An entry of a 
+ * schedule is only marked as no longer in use, as its memory belongs to the
+ * generation of the schedule.
  */
 void freeScheduleEntry(scheduleEntry *entry);
 
+/**
+ * Allocate and initialize a scheduleNode 
+ */
+scheduleNode * createScheduleNode();
+
+/**
+ * Free the node list, but not the schedule entries contained within the nodes
+ */
+void freeScheduleNodeList(scheduleNode * current);
+
+/**
+ * Free all schedule entries, their action sets and all defined actions, 
+ * leaving an empty schedule.  A new schedule may then be loaded.  Each 
+ * generation is dropped as a whole.  Only commands rendered for entries are
+ * freed one by one.
+ */
+void freeSchedule(scheduleContext * ctx);
+
+/**
+ * Return the list of all schedule entries in the order they were added.  The
+ * list belongs to the schedule and must not be freed.
+ */
+scheduleNode * getScheduleEntries(scheduleContext * ctx);
+
+/**
+ * Returns sorted array of scheduled events based on start and stop times.
+ * For repeating events, will return only the next scheduled time from now
+ * within the range.  
+ * The size of the array will be returned in the out parameter numEvents
+ * Returned array should be freed using freeEventSchedule.  Event text is
+ * borrowed from the schedule, so the events must be freed before it.
+ */
+eventEntry ** getScheduledEvents(scheduleContext * ctx, time_t startTime, 
+        time_t stopTime, int * numEvents);
+
+/**
+ * Free an array returned by getScheduledEvents.
+ */
+void freeEventSchedule(eventEntry ** schedule, int numEvents);
+
 /**
  * Set the current time for testing purposes.
  */
-void setTestTime(time_t time);
+void setTestTime(scheduleContext * ctx, time_t time);
 
 /**
  * Creates a single value valueStruct instance.
@@ -297,16 +797,43 @@ void freeValueStructList(valueStruct * value);
 actionDef * createActionCommand(char * commandName, char * commandStr, 
         enum ActionType type);
 
+/**
+ * Free the action, its compiled command and name.  Entries must no longer
+ * refer to it.  As with freeScheduleEntry, an action of a schedule is only
+ * marked as no longer in use.
+ */
+void freeActionDef(actionDef * action);
+
+/**
+ * Render the command of the action for the schedule entry, replacing all
+ * placeholders.
+ * Args:
+ *  action          Action to render
+ *  entry           Entry providing the placeholder values
+ *  scheduledTime   Time the entry is scheduled for
+ * Returns:
+ *  Newly allocated null terminated argument list ready to execute.  The 
+ *  list and its strings are a single allocation freed by caller using free.
+ */
+char ** renderActionArgs(actionDef * action, scheduleEntry * entry, 
+        time_t scheduledTime);
+
 /**
  * Find an exsiting actionDef given the command name.
  */
-actionDef * findActionCommand(char * commandName);
+actionDef * findActionCommand(scheduleContext * ctx, char * commandName);
 
 /**
  * Create and add to the action set, a new action command.
  */
-void addActionCommand(char * commandName, char * commandStr, 
-        enum ActionType type);
+void addActionCommand(scheduleContext * ctx, char * commandName, 
+        char * commandStr, enum ActionType type);
+
+/**
+ * Rebuild the index of the defined actions from cmdHead.  Must be invoked
+ * whenever the list of defined actions is replaced rather than added to.
+ */
+void rebuildActionIndex(scheduleContext * ctx);
 
 /**
  * Create an action set and initialize using the provided action.
@@ -319,7 +846,72 @@ actionNode * createActionSet(actionDef * action);
 void addActionToActionSet(actionNode * node, actionDef * action);
 
 /**
- * Execute all actions associated with the scheduled task.
+ * Create an action set as createActionSet, allocated from the current
+ * generation of the schedule.  Used while loading a schedule.
+ */
+actionNode * createScheduleActionSet(scheduleContext * ctx, 
+        actionDef * action);
+
+/**
+ * Add the action to the set as addActionToActionSet, allocating the node
+ * from the current generation of the schedule.
+ */
+void addScheduleActionToSet(scheduleContext * ctx, actionNode * node, 
+        actionDef * action);
+
+/**
+ * Create a private action for a single entry of the schedule, allocated
+ * from its current generation.
+ */
+actionDef * createPrivateAction(scheduleContext * ctx, char * commandStr);
+
+/**
+ * Free the nodes of an entry action set.  Private actions belong to the 
+ * entry and are freed as well.  Defined actions are shared by all entries.
+ */
+void freeActionSet(actionNode * node);
+
+/**
+ * Execute all action commands for the entry as scheduled at scheduledTime.
+ */
+void execActionCommand(scheduleContext * ctx, scheduleEntry * entry, 
+        time_t scheduledTime);
+
+/**
+ * Execute all actions associated with the scheduled task.  Once executors
+ * are started, the actions are queued for them rather than run by the
+ * caller.
+ */
+void executeScheduledEntry(scheduleContext * ctx, scheduledExec *task);
+
+/**
+ * Execute the program named by argv[0], searching PATH, without waiting for 
+ * it to complete.  The child must later be collected using reapChildren.
+ * If the launcher has been started, the launcher executes the program.
+ * Returns:
+ *  Process id of the child or -1 if it could not be launched.
+ */
+pid_t spawnArgs(char * const argv[]);
+
+/**
+ * Launch the program without reporting errors and without using the 
+ * launcher.  See spawnArgs.
+ * Returns:
+ *  0 with childPid set, otherwise the error number.
+ */
+int spawnProcess(char * const argv[], pid_t * childPid);
+
+/**
+ * Launch the command using the shell.  See spawnArgs.
+ */
+pid_t spawnCommand(char *cmd);
+
+/**
+ * Collect all launched commands that have exited without blocking.  Invoked
+ * by the event loop when SIGCHLD is received or the launcher reports that
+ * a command has exited.
+ * Returns:
+ *  Number of children collected.
  */
-void executeScheduledEntry(scheduledExec *task);
+int reapChildren();
 #endif //_SCHEDULE_H_
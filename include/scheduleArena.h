@@ -0,0 +1,113 @@
+#ifndef _SCHEDULEARENA_H_
+#define _SCHEDULEARENA_H_
+#include <stddef.h>
+#include "schedule.h"
+
+// Size of the first chunk of an arena.  Each chunk doubles up to the max.
+#define ARENA_MIN_CHUNK (16 * 1024)
+#define ARENA_MAX_CHUNK (4 * 1024 * 1024)
+
+/**
+ * Block of memory allocated from by bumping used.  The memory follows the
+ * header.
+ */
+typedef struct _arenaChunk {
+    struct _arenaChunk * next;  // Previously filled chunk
+    size_t size;                // Bytes following the header
+    size_t used;
+} arenaChunk;
+
+/**
+ * Counters describing the use of one or more arenas.
+ */
+typedef struct _arenaStats {
+    size_t allocs;              // Allocations made from the chunks
+    size_t bytesUsed;           // Bytes of those allocations incl. padding
+    size_t bytesReserved;       // Bytes of all chunks
+    size_t chunks;
+    size_t generations;         // Arenas counted
+} arenaStats;
+
+/**
+ * Bump allocator holding everything loaded for one generation of a
+ * schedule: its entries, calendar values, text, actions and the nodes
+ * listing them.  Nothing is freed on its own.  The whole generation is
+ * released at once by freeScheduleArena, a few calls to free regardless of
+ * the number of entries.
+ *
+ * liveCount is the number of entries and actions within the arena still in
+ * use.  freeScheduleEntry and freeActionDef only lower it, so a generation
+ * whose entries have all been replaced by a reload can be found and dropped.
+ *
+ * A schedule holds its current generation followed by older generations
+ * still holding kept entries through next.  Not thread safe.
+ */
+typedef struct _scheduleArena {
+    arenaChunk * chunks;        // Chunk being allocated from first
+    size_t nextChunkSize;
+    long liveCount;
+    arenaStats stats;
+    struct _scheduleArena * next;   // Older generation
+} scheduleArena;
+
+/**
+ * Create an empty arena.  No chunk is allocated until first used.
+ * Must be freed using freeScheduleArena.
+ */
+scheduleArena * createScheduleArena();
+
+/**
+ * Free the arena and all memory allocated from it.  Older generations
+ * following it are not freed.
+ */
+void freeScheduleArena(scheduleArena * arena);
+
+/**
+ * Free the arena and every older generation following it.
+ */
+void freeScheduleArenas(scheduleArena * arena);
+
+/**
+ * Free each generation of the list that is no longer in use.
+ * Returns:
+ *  The remaining list.
+ */
+scheduleArena * freeIdleArenas(scheduleArena * arena);
+
+/**
+ * Allocate size bytes aligned for any type.  The memory is not cleared.  If
+ * arena is NULL, the memory is allocated using malloc and must be freed by
+ * the caller.
+ */
+void * arenaAlloc(scheduleArena * arena, size_t size);
+
+/**
+ * Copy at most maxLen characters of the string into the arena, adding a
+ * null term.  Uses malloc if arena is NULL, as arenaAlloc.
+ */
+char * arenaStrndup(scheduleArena * arena, const char * str, size_t maxLen);
+
+/**
+ * Copy the string into the arena.  Uses malloc if arena is NULL.
+ */
+char * arenaStrdup(scheduleArena * arena, const char * str);
+
+/**
+ * Count an entry or action allocated from the arena as in use.  Ignored if
+ * arena is NULL.
+ */
+void retainArena(scheduleArena * arena);
+
+/**
+ * Count an entry or action allocated from the arena as no longer in use.
+ * Ignored if arena is NULL.
+ */
+void releaseArena(scheduleArena * arena);
+
+/**
+ * Set stats to the sum of the counters of the arena and every older
+ * generation following it.
+ */
+void getArenaStats(scheduleArena * arena, arenaStats * stats);
+
+#endif // _SCHEDULEARENA_H_
@@ -0,0 +1,111 @@
+#ifndef _SCHEDULECACHE_H_
+#define _SCHEDULECACHE_H_
+#include <stdint.h>
+#include "schedule.h"
+#include "scheduleLoader.h"
+
+// Appended to the schedule file name to name its cache
+#define SCHEDULE_CACHE_SUFFIX ".cache"
+#define SCHEDULE_CACHE_MAGIC "DSCACHE"
+// Changed whenever the layout of the cache changes
+#define SCHEDULE_CACHE_VERSION 1
+
+/**
+ * Compiled form of a schedule file.  The cache is a header followed by
+ * arrays of fixed size records and a table of strings, each found by its
+ * offset from the start of the file.  Records refer to strings by offset
+ * within the table and to other records by index, so the file is used as
+ * mapped without fixups.  Each distinct string is stored once.
+ *
+ * The cache belongs to the machine that wrote it.  It is rebuilt if its
+ * version or record sizes differ, or if the schedule file has changed.  A
+ * change of modification time alone only updates the header when the hash
+ * of the schedule file is unchanged.
+ */
+typedef struct _cacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;        // Record sizes when written
+    uint32_t actionSize;
+    uint32_t entrySize;
+    uint32_t valueSize;
+    uint32_t refSize;
+    int64_t sourceMtime;        // Schedule file the cache was built from
+    int64_t sourceMtimeNsec;
+    int64_t sourceSize;
+    uint64_t sourceHash;        // FNV-1a of the schedule file
+    uint32_t actionCount;
+    uint32_t actionOffset;
+    uint32_t entryCount;
+    uint32_t entryOffset;
+    uint32_t valueCount;
+    uint32_t valueOffset;
+    uint32_t refCount;
+    uint32_t refOffset;
+    uint32_t stringSize;
+    uint32_t stringOffset;
+} cacheHeader;
+
+/**
+ * Action defined by the schedule, in the order defined.
+ */
+typedef struct _cacheAction {
+    uint32_t name;              // String offsets
+    uint32_t command;
+    int32_t type;               // enum ActionType
+} cacheAction;
+
+/**
+ * Single value, range or wildcard of a calendar field.  Normalized as held
+ * by the schedule entry.
+ */
+typedef struct _cacheValue {
+    int32_t type;               // enum ValType other than LIST
+    int32_t range[3];           // Single values use range[0]
+} cacheValue;
+
+/**
+ * Action of an entry: the index of a defined action or, if -1, the command
+ * of a private action.
+ */
+typedef struct _cacheRef {
+    int32_t action;
+    uint32_t command;
+} cacheRef;
+
+/**
+ * Schedule entry.  The values of its six calendar fields are consecutive
+ * starting at firstValue.  A field of more than one value is a list.
+ */
+typedef struct _cacheEntry {
+    uint64_t minute;            // Compiled calendar values
+    uint32_t hour;
+    uint32_t dayOfMonth;
+    uint16_t monOfYear;
+    uint8_t dayOfWeek;
+    uint8_t unused;
+    int32_t duration;
+    uint32_t task;              // String offsets
+    uint32_t reminder;
+    uint32_t firstValue;
+    uint8_t valueCount[6];      // Year, month, day of month, day of week,
+    uint8_t unused2[2];         // hour and minute
+    uint32_t firstRef;
+    uint32_t refCount;
+} cacheEntry;
+
+/**
+ * Load the schedule file using its cache, named by appending
+ * SCHEDULE_CACHE_SUFFIX to fileName.  If the cache is missing or out of
+ * date, the file is parsed using the parser requested and the cache is
+ * rebuilt.  Loading from the cache maps it and reads no schedule text, as
+ * entries refer to their text within the mapping until freeSchedule.  A
+ * file with syntax errors is loaded as loadScheduleFile does, but not
+ * cached.
+ * Returns:
+ *  SUCCESS if the schedule was loaded, ERROR if it could not be opened.
+ */
+int loadScheduleCached(scheduleContext * ctx, const char * fileName,
+        enum ParserType parser);
+
+#endif // _SCHEDULECACHE_H_
@@ -0,0 +1,50 @@
+#ifndef _SCHEDULELOADER_H_
+#define _SCHEDULELOADER_H_
+#include <stdio.h>
+#include "schedule.h"
+
+/**
+ * Parser used to load a schedule file.
+ *  PARSER_BISON    Flex scanner and bison grammar.  Default.
+ *  PARSER_MAPPED   Hand written scanner over the mapped file.  Task and
+ *                  reminder text are used in place rather than copied.
+ */
+enum ParserType {PARSER_BISON, PARSER_MAPPED};
+
+/**
+ * Schedule file mapped by parseMappedScheduleFile.  Held by the schedule
+ * until it is freed as its entries refer to text within the mapping.
+ */
+typedef struct _mappedFile {
+    char * addr;
+    size_t length;
+    struct _mappedFile * next;
+} mappedFile;
+
+/**
+ * Open the schedule file and add its actions and entries to the schedule
+ * using the parser requested.  Syntax errors are reported on stdout and the
+ * entries before the error are kept.
+ * Returns:
+ *  SUCCESS if the file was read, ERROR if it could not be opened.
+ */
+int loadScheduleFile(scheduleContext * ctx, const char * fileName,
+        enum ParserType parser);
+
+/**
+ * Parse the schedule file as parseScheduleFile does, but by mapping the file
+ * and scanning its lines directly.  Quoted text is terminated in place within
+ * a private mapping, and only text containing escaped quotes is rewritten,
+ * so task and reminder text is never copied.  The mapping is held by the
+ * schedule until freeSchedule.
+ * Returns:
+ *  0 if the file was parsed, otherwise non zero.
+ */
+int parseMappedScheduleFile(scheduleContext * ctx, FILE * file);
+
+/**
+ * Unmap and free the list of mapped files.
+ */
+void freeMappedFiles(mappedFile * file);
+
+#endif // _SCHEDULELOADER_H_
@@ -0,0 +1,96 @@
+#ifndef _SCHEDULERELOAD_H_
+#define _SCHEDULERELOAD_H_
+#include <stdint.h>
+#include "schedule.h"
+#include "scheduleLoader.h"
+
+/**
+ * Number of entries added, removed and left unchanged by a reload.  A
+ * changed entry is counted as removed and added.
+ */
+typedef struct _reloadStats {
+    int added;
+    int removed;
+    int unchanged;
+} reloadStats;
+
+/**
+ * Watch on a schedule file.  The directory holding the file is watched, so
+ * a file replaced by rename, as most editors save, is seen as well as one
+ * written in place.  Only supported on Linux.
+ */
+typedef struct _scheduleWatch {
+    int fd;                     // inotify instance.  Readable on change
+    int watch;
+    char * fileName;            // Schedule file as given
+    char * baseName;            // Name of the file within the directory
+    enum ParserType parser;     // Parser used to reload the file
+} scheduleWatch;
+
+/**
+ * Return a hash of the content of the entry: its calendar values, duration,
+ * task, reminder and the name, type and command of each of its actions.
+ * Entries with the same content have the same hash.  Calculated once and
+ * kept in contentHash, so the entry must not be modified afterwards.
+ */
+uint64_t hashScheduleEntry(scheduleEntry * entry);
+
+/**
+ * Update the schedule to match fresh, a newly loaded version of the same
+ * schedule.  Entries are matched by content.  Unchanged entries are kept,
+ * along with their place in the alarm queue or wheel and their rendered
+ * commands, and the copies within fresh are freed.  Entries only within
+ * the schedule are removed from the alarm queue or wheel and freed.
+ * Entries only within fresh are moved to the schedule and added to the
+ * alarm queue or wheel.  Actions are matched by name, command and type in
+ * the same way.  The entry list and defined actions then follow the order
+ * of fresh.
+ *
+ * Work on the alarm queue or wheel is proportional to the number of entries
+ * added and removed.  Matching is linear in the number of entries.  When an
+ * action definition is changed or removed, the kept entries are also
+ * visited once to drop commands rendered using it.
+ *
+ * The executors must not be running actions of the schedule and any alarm
+ * returned by calcNextTaskAlarm must be discarded and calculated again.
+ * Args:
+ *  ctx     Schedule being updated
+ *  fresh   Newly loaded schedule.  Left empty, but must still be freed.
+ *  stats   Set to the counts of the reload.  May be NULL.
+ */
+void applyScheduleReload(scheduleContext * ctx, scheduleContext * fresh,
+        reloadStats * stats);
+
+/**
+ * Parse the schedule file into a new schedule and apply it to ctx using
+ * applyScheduleReload.  The executors are drained first.  If the file
+ * cannot be read or has syntax errors, the schedule is left unchanged.
+ * Returns:
+ *  SUCCESS if the schedule was reloaded, otherwise ERROR.
+ */
+int reloadScheduleFile(scheduleContext * ctx, const char * fileName,
+        enum ParserType parser, reloadStats * stats);
+
+/**
+ * Watch the schedule file, so waitForTask reloads the schedule using
+ * reloadScheduleFile whenever the file is written or replaced.
+ * Returns:
+ *  SUCCESS if the file is being watched, otherwise ERROR.
+ */
+int watchScheduleFile(scheduleContext * ctx, const char * fileName,
+        enum ParserType parser);
+
+/**
+ * Read all pending events of the watch without blocking.  Several writes
+ * are reported as one change.
+ * Returns:
+ *  True if the schedule file was written or replaced.
+ */
+Bool readScheduleWatch(scheduleWatch * watch);
+
+/**
+ * Remove the watch and free it.
+ */
+void freeScheduleWatch(scheduleWatch * watch);
+
+#endif // _SCHEDULERELOAD_H_
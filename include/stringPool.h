@@ -0,0 +1,75 @@
+#ifndef _STRINGPOOL_H_
+#define _STRINGPOOL_H_
+#include <stdint.h>
+#include "schedule.h"
+
+// ID of no string.  Strings of a pool are numbered from 1.
+#define STRING_NONE 0
+// Fewest slots of the table finding strings.  Power of 2.
+#define MIN_POOL_SLOTS 64
+
+typedef uint32_t stringId;
+
+/**
+ * Slot of the table finding strings.  The hash is kept with the ID, so
+ * most probes do not visit the string itself.
+ */
+typedef struct _poolSlot {
+    uint32_t hash;
+    stringId id;                // STRING_NONE if the slot is empty
+} poolSlot;
+
+/**
+ * Set of distinct strings, each stored once and numbered in the order
+ * added.  Task and reminder text of a schedule is interned here, so entries
+ * with the same text share one copy and carry its ID.  Strings are found
+ * using a table with open addressing on the hash of the string, at most
+ * half full.  Strings are never removed; the pool is freed as a whole.  A
+ * reload interns only added text, and rebuilds the pool from the text of
+ * its entries once removed text outgrows it.
+ */
+typedef struct _stringPool {
+    const char ** strings;      // Text of each ID.  strings[0] is NULL
+    uint32_t count;             // IDs assigned including STRING_NONE
+    uint32_t capacity;          // Of strings
+    poolSlot * slots;
+    uint32_t slotCount;
+    struct _scheduleArena * text;   // Holds the copied strings
+    size_t bytes;               // Length of all strings incl. null terms
+} stringPool;
+
+/**
+ * Create an empty pool.
+ * Must be freed using freeStringPool.
+ */
+stringPool * createStringPool();
+
+/**
+ * Free the pool and the strings copied into it.
+ */
+void freeStringPool(stringPool * pool);
+
+/**
+ * Return the ID of the string, copying it into the pool if not already
+ * present.
+ */
+stringId internPoolString(stringPool * pool, const char * str);
+
+/**
+ * Return the ID of the string as internPoolString, but if not already present
+ * the pool refers to str rather than copying it.  str must remain valid
+ * until the pool is freed.  Used for text within a mapped file.
+ */
+stringId internSharedPoolString(stringPool * pool, const char * str);
+
+/**
+ * Return the text of the ID, or NULL for STRING_NONE.
+ */
+const char * poolString(stringPool * pool, stringId id);
+
+/**
+ * Return the number of distinct strings within the pool.
+ */
+uint32_t getStringPoolCount(stringPool * pool);
+
+#endif // _STRINGPOOL_H_
@@ -0,0 +1,80 @@
+#ifndef _TASKQUEUE_H_
+#define _TASKQUEUE_H_
+#include "schedule.h"
+
+/**
+ * Schedule entry and the next time it is to be executed.
+ */
+typedef struct _taskQueueNode {
+    time_t nextTime;
+    scheduleEntry * entry;
+} taskQueueNode;
+
+/**
+ * Priority queue of schedule entries ordered by next time.  Implemented as
+ * a binary min-heap stored in a growable array.  Each entry records its 
+ * position within the heap in alarmSlot, so it can be removed in O(log n).
+ */
+typedef struct _taskQueue {
+    taskQueueNode * nodes;
+    int count;
+    int capacity;
+} taskQueue;
+
+/**
+ * Create an empty queue with room for the provided number of entries.  The
+ * queue will grow as needed.
+ * Must be freed using freeTaskQueue.
+ */
+taskQueue * createTaskQueue(int capacity);
+
+/**
+ * Free the queue.  The schedule entries within the queue are not freed.
+ */
+void freeTaskQueue(taskQueue * queue);
+
+/**
+ * Add the entry to the queue using the provided time as the key.
+ */
+void pushTaskQueue(taskQueue * queue, time_t nextTime, scheduleEntry * entry);
+
+/**
+ * Return the node with the earliest time without removing it or NULL if the
+ * queue is empty.
+ */
+taskQueueNode * peekTaskQueue(taskQueue * queue);
+
+/**
+ * Remove the node with the earliest time and copy it to the node provided.
+ * Returns:
+ *  True  if a node was removed.
+ *  False if the queue was empty.
+ */
+Bool popTaskQueue(taskQueue * queue, taskQueueNode * node);
+
+/**
+ * Remove the entry from the queue using the position recorded in the entry.
+ * Returns:
+ *  True  if the entry was removed.
+ *  False if the entry was not within the queue.
+ */
+Bool removeTaskQueueEntry(taskQueue * queue, scheduleEntry * entry);
+
+/**
+ * Return a newly allocated list of all entries sharing the earliest time 
+ * within the queue, in schedule list order.  The entries remain in the 
+ * queue.  Returns NULL if the queue is empty.
+ * List should be freed using freeScheduleNodeList.
+ */
+scheduleNode * peekTaskQueueTies(taskQueue * queue);
+
+/**
+ * Relink the list of tieCount entries due at the same time in schedule list
+ * order, so they run in the order of the schedule file whatever the 
+ * dispatch mode.
+ * Returns:
+ *  The new head of the list.
+ */
+scheduleNode * sortTaskQueueTies(scheduleNode * list, int tieCount);
+
+#endif // _TASKQUEUE_H_
@@ -2,6 +2,6 @@
 #define _TIMEROUTINES_H_
 #include "schedule.h"
 
-int waitForTask(scheduledExec *task);
+int waitForTask(scheduleContext * ctx, scheduledExec *task);
 
 #endif // _TIMEROUTINES_H_
@@ -0,0 +1,113 @@
+#ifndef _TIMINGWHEEL_H_
+#define _TIMINGWHEEL_H_
+#include "schedule.h"
+
+#define WHEEL_MINUTE_SLOTS 60
+#define WHEEL_HOUR_SLOTS 24
+#define WHEEL_DAY_SLOTS 64
+
+/**
+ * Wheel level holding a timer.  Timers more than WHEEL_DAY_SLOTS days out
+ * are held in an overflow list until the day wheel reaches them.
+ */
+enum WheelLevel {WL_MINUTE, WL_HOUR, WL_DAY, WL_OVERFLOW, WL_DETACHED};
+
+/**
+ * Timer for a schedule entry within a timing wheel.  Timers are allocated
+ * by the wheel.  Timers within a slot are kept in a doubly linked list so
+ * they can be cancelled in constant time.
+ */
+typedef struct _wheelTimer {
+    time_t expires;
+    scheduleEntry * entry;
+    enum WheelLevel level;
+    int slot;
+    struct _wheelTimer * prev;
+    struct _wheelTimer * next;
+} wheelTimer;
+
+/**
+ * Hierarchical timing wheel with minute, hour and day levels.  Each level is
+ * an array of timer lists plus a bitset of the slots that are not empty, so
+ * the next slot holding timers is found with a count-trailing-zeros.
+ *
+ * The minute wheel holds timers in the same hour as base, the hour wheel
+ * holds timers in the same day and the day wheel holds timers within the
+ * next WHEEL_DAY_SLOTS days.  Minutes, hours and days are counted from the
+ * epoch.  When a coarser slot is reached, its timers are cascaded to the
+ * finer levels.  Insert and cancel are O(1) and expiring a minute is O(1)
+ * amortized.
+ */
+typedef struct _timingWheel {
+    long base;                  // Earliest minute that has not expired
+    wheelTimer * minutes[WHEEL_MINUTE_SLOTS];
+    wheelTimer * hours[WHEEL_HOUR_SLOTS];
+    wheelTimer * days[WHEEL_DAY_SLOTS];
+    wheelTimer * overflow;
+    uint64_t minuteBits;
+    uint32_t hourBits;
+    uint64_t dayBits;
+    int count;                  // Number of timers within the wheel
+} timingWheel;
+
+/**
+ * Create an empty wheel.  Nothing before the minute containing startTime
+ * will be expired.
+ * Must be freed using freeTimingWheel.
+ */
+timingWheel * createTimingWheel(time_t startTime);
+
+/**
+ * Free the wheel and all timers within the wheel.  Detached timers returned
+ * by expireNextWheelBucket must be freed using freeWheelTimers.
+ */
+void freeTimingWheel(timingWheel * wheel);
+
+/**
+ * Move the earliest minute that has not expired back to the minute 
+ * containing startTime.  Timers held relative to the later minute are placed
+ * again.  Does nothing if startTime is not before that minute.  Allows a
+ * timer to be added before timers that have already been expired.
+ */
+void rewindTimingWheel(timingWheel * wheel, time_t startTime);
+
+/**
+ * Create a timer for the entry and add it to the wheel.  The timer is 
+ * recorded in the alarmTimer of the entry until the timer is freed.  A time
+ * before the earliest minute that has not expired is treated as that 
+ * minute.
+ * Returns:
+ *  The new timer.  May be used to cancel the timer.
+ */
+wheelTimer * insertWheelTimer(timingWheel * wheel, time_t expires,
+        scheduleEntry * entry);
+
+/**
+ * Add a detached timer back into the wheel with a new time.
+ */
+void rescheduleWheelTimer(timingWheel * wheel, wheelTimer * timer,
+        time_t expires);
+
+/**
+ * Remove the timer from the wheel and free it.  The timer may be detached.
+ */
+void cancelWheelTimer(timingWheel * wheel, wheelTimer * timer);
+
+/**
+ * Remove all timers for the earliest minute holding timers and advance the
+ * wheel past that minute.
+ * Args:
+ *  wheel       Wheel to expire
+ *  bucketTime  Set to the earliest time within the returned timers
+ * Returns:
+ *  List of detached timers linked by next or NULL if the wheel is empty.
+ *  Each timer must be rescheduled or freed using freeWheelTimers.
+ */
+wheelTimer * expireNextWheelBucket(timingWheel * wheel, time_t * bucketTime);
+
+/**
+ * Free a list of detached timers.
+ */
+void freeWheelTimers(wheelTimer * timers);
+
+#endif // _TIMINGWHEEL_H_
@@ -7,6 +7,11 @@
 #include <limits.h>
 #include <unistd.h>
 #include "schedule.h"
+#include "launcher.h"
+#include "executor.h"
+#include "scheduleLoader.h"
+#include "scheduleCache.h"
+#include "scheduleReload.h"
 #include "schedule.tab.h"
 
 #define SUCCESS 0
@@ -47,13 +52,21 @@ void usage();
 void getFileLoc(const char *fileLoc);
 int processArgs(int argc, char **argv);
 
-int processScheduleFile(const char * fileName);
+int processScheduleFile(scheduleContext * ctx, const char * fileName);
+int finish(scheduleContext * ctx, int status);
 
 /* -----------------------------------------------------------------------------
  *  Arg Processing.
  * ---------------------------------------------------------------------------*/
-enum ActionVals {PRINT=1, TODAY=2, NOTIFY=4};
+enum ActionVals {PRINT=1, TODAY=2, NOTIFY=4, UPCOMING=8};
 int actions = 0;
+int upcomingCount = 0;
+enum DispatchMode dispatchMode = DISPATCH_QUEUE;
+enum ParserType parserType = PARSER_BISON;
+Bool useCache = False;
+Bool watchFile = False;
+Bool useLauncher = False;
+int executorThreads = 0;
 char *scheduleFileLoc = NULL;
 
 
@@ -61,27 +74,61 @@ char *scheduleFileLoc = NULL;
  *  Function definitions.
  * ---------------------------------------------------------------------------*/
 int main(int argc, char **argv) {
+	scheduleContext * ctx;
 	int status;
 	status = processArgs(argc, argv);
 	if (status == ERROR) {
 		usage();
 		return(status);
 	}
-	status = processScheduleFile(scheduleFileLoc);
+	// Fork the launcher while the process is small.
+	if (useLauncher == True && startLauncher() != SUCCESS) {
+		return ERROR;
+	}
+	ctx = createScheduleContext();
+	setDispatchMode(ctx, dispatchMode);
+	status = processScheduleFile(ctx, scheduleFileLoc);
 	if (status == ERROR) {
-		return(status);
+		return finish(ctx, status);
+	}
+	// Only entries that change are updated when the file is reloaded.
+	if ((actions & NOTIFY) && watchFile == True
+			&& watchScheduleFile(ctx, scheduleFileLoc, parserType) != SUCCESS) {
+		return finish(ctx, ERROR);
+	}
+	// With -e, actions run on executor threads so the timer is re-armed
+	// promptly.
+	if ((actions & NOTIFY) && executorThreads > 0
+			&& startExecutors(executorThreads, FIRE_QUEUE_CAPACITY) != SUCCESS) {
+		return finish(ctx, ERROR);
 	}
 	if (actions & PRINT) {
-     	displaySchedule(stdout);
+     	displaySchedule(ctx, stdout);
 	}
 	if (actions & TODAY) {
-    	displayTodaysSchedule(stdout);
+    	displayTodaysSchedule(ctx, stdout);
+	}
+	if (actions & UPCOMING) {
+    	displayUpcomingEvents(ctx, stdout, upcomingCount);
 	}
 	if (actions & NOTIFY) {
-    	runNotifications();
+    	runNotifications(ctx);
 	}
-	// TODO: release all memory
-	return SUCCESS;
+	return finish(ctx, SUCCESS);
+}
+
+/**
+ * Stop the executors and launcher, if started, and free the schedule.
+ * Returns:
+ *  status
+ */
+int finish(scheduleContext * ctx, int status) {
+	// Executors may still refer to entries until stopped.
+	stopExecutors();
+	stopLauncher();
+	freeScheduleContext(ctx);
+	free(scheduleFileLoc);
+	return status;
 }
 
 int processArgs(int argc, char **argv) {
@@ -99,9 +146,66 @@ int processArgs(int argc, char **argv) {
     		case 'n':
     			actions |= NOTIFY;
     			break;
+    		case 'u':
+    			actions |= UPCOMING;
+    			if (i + 1 >= argc || (upcomingCount = atoi(argv[++i])) <= 0) {
+    				return ERROR;
+    			}
+    			break;
     		case 'f':
     			getFileLoc(argv[++i]);
     			break;
+    		case 'z':
+    			useLauncher = True;
+    			break;
+    		case 'c':
+    			useCache = True;
+    			break;
+    		case 'w':
+    			watchFile = True;
+    			break;
+    		case 'e':
+    			if (i + 1 >= argc) {
+    				return ERROR;
+    			}
+    			executorThreads = atoi(argv[++i]);
+    			if (executorThreads < 0 || executorThreads > MAX_EXECUTORS) {
+    				return ERROR;
+    			}
+    			break;
+    		case 'd':
+    			if (i + 1 >= argc) {
+    				return ERROR;
+    			}
+    			i++;
+    			if (strcmp(argv[i], "wheel") == 0) {
+    				dispatchMode = DISPATCH_WHEEL;
+    			}
+    			else if (strcmp(argv[i], "queue") == 0) {
+    				dispatchMode = DISPATCH_QUEUE;
+    			}
+    			else if (strcmp(argv[i], "match") == 0) {
+    				dispatchMode = DISPATCH_MATCH;
+    			}
+    			else {
+    				return ERROR;
+    			}
+    			break;
+    		case 'l':
+    			if (i + 1 >= argc) {
+    				return ERROR;
+    			}
+    			i++;
+    			if (strcmp(argv[i], "mmap") == 0) {
+    				parserType = PARSER_MAPPED;
+    			}
+    			else if (strcmp(argv[i], "bison") == 0) {
+    				parserType = PARSER_BISON;
+    			}
+    			else {
+    				return ERROR;
+    			}
+    			break;
     		default: return ERROR;
     		}
     		break;
@@ -134,19 +238,14 @@ void getFileLoc(const char *fileLoc) {
 }
 
 void usage() {
-	printf("Usage:  schedule [-n] [-p] [-t] -f <file path>\n");
+	printf("Usage:  schedule [-n] [-p] [-t] [-u <count>] [-d queue|wheel|match] [-l bison|mmap] [-c] [-w] [-z] [-e <threads>] -f <file path>\n");
 }
 
-int processScheduleFile(const char * fileName) {
-    extern FILE *yyin;
-	yyin = fopen(fileName, "r");
-    if(yyin == NULL) {
-    	perror("Failed to open input file: ");
-    	return ERROR;
+int processScheduleFile(scheduleContext * ctx, const char * fileName) {
+    // The cache is rebuilt whenever the file changes.
+    if (useCache == True) {
+        return loadScheduleCached(ctx, fileName, parserType);
     }
-    yyparse();
-
-    fclose(yyin);
-    return SUCCESS;
+    return loadScheduleFile(ctx, fileName, parserType);
 }
 
@@ -0,0 +1,387 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "schedule.h"
+#include "entryStore.h"
+
+// The vector kernels are built for x86 processors only, regardless of the
+// compiler flags, and selected once the processor is known to support them.
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define MATCH_X86
+#include <immintrin.h>
+#define TARGET_SSE4 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+/* -----------------------------------------------------------------------------
+ *  Internal Structures
+ * ---------------------------------------------------------------------------*/
+
+/**
+ * Match a full block of MATCH_BLOCK IDs starting at base.  Bit n of the 
+ * result is set if ID base + n matches.
+ */
+typedef uint32_t (*matchBlockFunc)(entryStore * store, calendarMask * time,
+        uint32_t base);
+
+static enum MatchKernel matchKernel = MATCH_AUTO;
+static matchBlockFunc matchBlock = NULL;
+
+/* -----------------------------------------------------------------------------
+ *  Prototypes
+ * ---------------------------------------------------------------------------*/
+void growEntryStore(entryStore * store);
+void * growStoreArray(void * array, uint32_t capacity, size_t size);
+uint32_t matchIds(entryStore * store, calendarMask * time, uint32_t base,
+        uint32_t count);
+uint32_t matchBlockScalar(entryStore * store, calendarMask * time, 
+        uint32_t base);
+#ifdef MATCH_X86
+uint32_t matchBlockSse4(entryStore * store, calendarMask * time, 
+        uint32_t base);
+uint32_t matchBlockAvx2(entryStore * store, calendarMask * time, 
+        uint32_t base);
+#endif
+
+/* -----------------------------------------------------------------------------
+ *  Function definitions.
+ * ---------------------------------------------------------------------------*/
+
+entryStore * createEntryStore() {
+    entryStore * store;
+
+    store = malloc(sizeof(entryStore));
+    assert(store != NULL);
+    memset(store, 0, sizeof(entryStore));
+    return store;
+}
+
+void freeEntryStore(entryStore * store) {
+    if (store != NULL) {
+        free(store->minutes);
+        free(store->hours);
+        free(store->daysOfMonth);
+        free(store->monthsOfYear);
+        free(store->daysOfWeek);
+        free(store->flags);
+        free(store->nextTimes);
+        free(store->entries);
+        free(store->years);
+        free(store->freeIds);
+        free(store);
+    }
+}
+
+uint32_t addStoreEntry(entryStore * store, scheduleEntry * entry) {
+    uint32_t id;
+
+    if (store->freeCount > 0) {
+        id = store->freeIds[--store->freeCount];
+    }
+    else {
+        if (store->count == store->capacity) {
+            growEntryStore(store);
+        }
+        id = store->count++;
+    }
+    store->minutes[id] = entry->compiled.minute;
+    store->hours[id] = entry->compiled.hour;
+    store->daysOfMonth[id] = entry->compiled.dayOfMonth;
+    store->monthsOfYear[id] = entry->compiled.monOfYear;
+    store->daysOfWeek[id] = entry->compiled.dayOfWeek;
+    store->flags[id] = ENTRY_LIVE;
+    if (entry->year.type == WILDCARD) {
+        store->flags[id] |= ENTRY_ANY_YEAR;
+    }
+    store->nextTimes[id] = 0;
+    store->entries[id] = entry;
+    store->years[id] = &entry->year;
+    entry->storeId = id;
+    return id;
+}
+
+void removeStoreEntry(entryStore * store, scheduleEntry * entry) {
+    uint32_t id = entry->storeId;
+
+    if (isStoreEntry(store, entry) == False) {
+        return;
+    }
+    store->flags[id] = 0;
+    store->entries[id] = NULL;
+    store->years[id] = NULL;
+    store->freeIds[store->freeCount++] = id;
+    entry->storeId = ENTRY_NOT_STORED;
+}
+
+Bool isStoreEntry(entryStore * store, scheduleEntry * entry) {
+    return store != NULL && entry->storeId < store->count
+        && store->entries[entry->storeId] == entry ? True : False;
+}
+
+uint32_t getStoreEntryCount(entryStore * store) {
+    return store->count - store->freeCount;
+}
+
+void clearStoreTimes(entryStore * store) {
+    uint32_t id;
+
+    if (store == NULL) {
+        return;
+    }
+    for (id = 0; id < store->count; id++) {
+        store->flags[id] &= ~ENTRY_TIMED;
+    }
+}
+
+/**
+ * Double the capacity of every array.  Freed IDs never exceed the IDs used,
+ * so freeIds grows with the rest.
+ */
+void growEntryStore(entryStore * store) {
+    uint32_t capacity = store->capacity > 0 ? store->capacity * 2 :
+        MIN_STORE_ENTRIES;
+
+    store->minutes = growStoreArray(store->minutes, capacity,
+            sizeof(uint64_t));
+    store->hours = growStoreArray(store->hours, capacity, sizeof(uint32_t));
+    store->daysOfMonth = growStoreArray(store->daysOfMonth, capacity,
+            sizeof(uint32_t));
+    store->monthsOfYear = growStoreArray(store->monthsOfYear, capacity,
+            sizeof(uint16_t));
+    store->daysOfWeek = growStoreArray(store->daysOfWeek, capacity,
+            sizeof(uint8_t));
+    store->flags = growStoreArray(store->flags, capacity, sizeof(uint8_t));
+    store->nextTimes = growStoreArray(store->nextTimes, capacity,
+            sizeof(time_t));
+    store->entries = growStoreArray(store->entries, capacity,
+            sizeof(scheduleEntry *));
+    store->years = growStoreArray(store->years, capacity,
+            sizeof(valueStruct *));
+    store->freeIds = growStoreArray(store->freeIds, capacity,
+            sizeof(uint32_t));
+    store->capacity = capacity;
+}
+
+void * growStoreArray(void * array, uint32_t capacity, size_t size) {
+    array = realloc(array, size * capacity);
+    assert(array != NULL);
+    return array;
+}
+
+uint32_t matchStoreEntries(entryStore * store, calendarMask * time,
+        uint32_t startId, uint32_t * ids, uint32_t maxIds) {
+    uint32_t base, mask, numIds = 0;
+
+    if (matchBlock == NULL) {
+        setMatchKernel(matchKernel);
+    }
+    for (base = startId - startId % MATCH_BLOCK; 
+            base < store->count && numIds < maxIds; base += MATCH_BLOCK) {
+        if (store->count - base >= MATCH_BLOCK) {
+            mask = matchBlock(store, time, base);
+        }
+        else {
+            mask = matchIds(store, time, base, store->count - base);
+        }
+        if (base < startId) {
+            mask &= ~0U << (startId - base);
+        }
+        for (; mask != 0 && numIds < maxIds; mask &= mask - 1) {
+            ids[numIds++] = base + __builtin_ctz(mask);
+        }
+    }
+    return numIds;
+}
+
+enum MatchKernel setMatchKernel(enum MatchKernel kernel) {
+#ifdef MATCH_X86
+    __builtin_cpu_init();
+    if ((kernel == MATCH_AUTO || kernel == MATCH_AVX2) 
+            && __builtin_cpu_supports("avx2")) {
+        matchKernel = MATCH_AVX2;
+        matchBlock = matchBlockAvx2;
+        return matchKernel;
+    }
+    if (kernel != MATCH_SCALAR && __builtin_cpu_supports("sse4.1")) {
+        matchKernel = MATCH_SSE4;
+        matchBlock = matchBlockSse4;
+        return matchKernel;
+    }
+#endif
+    matchKernel = MATCH_SCALAR;
+    matchBlock = matchBlockScalar;
+    return matchKernel;
+}
+
+/**
+ * Match count IDs from base one at a time.  Used by the scalar kernel and
+ * for the IDs following the last full block.
+ */
+uint32_t matchIds(entryStore * store, calendarMask * time, uint32_t base,
+        uint32_t count) {
+    uint32_t idx, id, mask = 0;
+
+    for (idx = 0; idx < count; idx++) {
+        id = base + idx;
+        if ((store->flags[id] & ENTRY_LIVE) 
+                && (store->minutes[id] & time->minute)
+                && (store->hours[id] & time->hour)
+                && (store->daysOfMonth[id] & time->dayOfMonth)
+                && (store->monthsOfYear[id] & time->monOfYear)
+                && (store->daysOfWeek[id] & time->dayOfWeek)) {
+            mask |= 1U << idx;
+        }
+    }
+    return mask;
+}
+
+uint32_t matchBlockScalar(entryStore * store, calendarMask * time, 
+        uint32_t base) {
+    return matchIds(store, time, base, MATCH_BLOCK);
+}
+
+#ifdef MATCH_X86
+/*
+ * Each kernel tests the fields from the cheapest to load to the most 
+ * expensive and stops once no ID of the block remains.  A field contains
+ * the time if the field ANDed with the bit of the time equals that bit.
+ */
+
+TARGET_SSE4
+uint32_t matchBlockSse4(entryStore * store, calendarMask * time, 
+        uint32_t base) {
+    __m128i bit, lo, hi;
+    uint32_t mask = 0, part;
+    int idx;
+
+    // Flags and day of week: 16 IDs per vector.
+    for (idx = 0; idx < MATCH_BLOCK; idx += 16) {
+        bit = _mm_set1_epi8(ENTRY_LIVE);
+        lo = _mm_loadu_si128((const __m128i *)(store->flags + base + idx));
+        lo = _mm_cmpeq_epi8(_mm_and_si128(lo, bit), bit);
+        bit = _mm_set1_epi8((char)time->dayOfWeek);
+        hi = _mm_loadu_si128(
+                (const __m128i *)(store->daysOfWeek + base + idx));
+        hi = _mm_cmpeq_epi8(_mm_and_si128(hi, bit), bit);
+        mask |= (uint32_t)_mm_movemask_epi8(_mm_and_si128(lo, hi)) << idx;
+    }
+    if (mask == 0) {
+        return 0;
+    }
+
+    // Month: 8 IDs per vector, packed to bytes 16 at a time.
+    bit = _mm_set1_epi16((short)time->monOfYear);
+    for (idx = 0, part = 0; idx < MATCH_BLOCK; idx += 16) {
+        lo = _mm_loadu_si128(
+                (const __m128i *)(store->monthsOfYear + base + idx));
+        hi = _mm_loadu_si128(
+                (const __m128i *)(store->monthsOfYear + base + idx + 8));
+        lo = _mm_cmpeq_epi16(_mm_and_si128(lo, bit), bit);
+        hi = _mm_cmpeq_epi16(_mm_and_si128(hi, bit), bit);
+        part |= (uint32_t)_mm_movemask_epi8(_mm_packs_epi16(lo, hi)) << idx;
+    }
+    if ((mask &= part) == 0) {
+        return 0;
+    }
+
+    // Hour: 4 IDs per vector.
+    bit = _mm_set1_epi32((int)time->hour);
+    for (idx = 0, part = 0; idx < MATCH_BLOCK; idx += 4) {
+        lo = _mm_loadu_si128((const __m128i *)(store->hours + base + idx));
+        lo = _mm_cmpeq_epi32(_mm_and_si128(lo, bit), bit);
+        part |= (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(lo)) << idx;
+    }
+    if ((mask &= part) == 0) {
+        return 0;
+    }
+
+    // Minute: 2 IDs per vector.
+    bit = _mm_set1_epi64x((long long)time->minute);
+    for (idx = 0, part = 0; idx < MATCH_BLOCK; idx += 2) {
+        lo = _mm_loadu_si128((const __m128i *)(store->minutes + base + idx));
+        lo = _mm_cmpeq_epi64(_mm_and_si128(lo, bit), bit);
+        part |= (uint32_t)_mm_movemask_pd(_mm_castsi128_pd(lo)) << idx;
+    }
+    if ((mask &= part) == 0) {
+        return 0;
+    }
+
+    // Day of month: 4 IDs per vector.
+    bit = _mm_set1_epi32((int)time->dayOfMonth);
+    for (idx = 0, part = 0; idx < MATCH_BLOCK; idx += 4) {
+        lo = _mm_loadu_si128(
+                (const __m128i *)(store->daysOfMonth + base + idx));
+        lo = _mm_cmpeq_epi32(_mm_and_si128(lo, bit), bit);
+        part |= (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(lo)) << idx;
+    }
+    return mask & part;
+}
+
+TARGET_AVX2
+uint32_t matchBlockAvx2(entryStore * store, calendarMask * time, 
+        uint32_t base) {
+    __m256i bit, lo, hi;
+    uint32_t mask, part;
+    int idx;
+
+    // Flags and day of week: 32 IDs per vector.
+    bit = _mm256_set1_epi8(ENTRY_LIVE);
+    lo = _mm256_loadu_si256((const __m256i *)(store->flags + base));
+    lo = _mm256_cmpeq_epi8(_mm256_and_si256(lo, bit), bit);
+    bit = _mm256_set1_epi8((char)time->dayOfWeek);
+    hi = _mm256_loadu_si256((const __m256i *)(store->daysOfWeek + base));
+    hi = _mm256_cmpeq_epi8(_mm256_and_si256(hi, bit), bit);
+    mask = (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(lo, hi));
+    if (mask == 0) {
+        return 0;
+    }
+
+    // Month: 16 IDs per vector.  Packing works within each 128 bit lane, so
+    // the 64 bit quarters are put back in ID order.
+    bit = _mm256_set1_epi16((short)time->monOfYear);
+    lo = _mm256_loadu_si256((const __m256i *)(store->monthsOfYear + base));
+    hi = _mm256_loadu_si256(
+            (const __m256i *)(store->monthsOfYear + base + 16));
+    lo = _mm256_cmpeq_epi16(_mm256_and_si256(lo, bit), bit);
+    hi = _mm256_cmpeq_epi16(_mm256_and_si256(hi, bit), bit);
+    lo = _mm256_permute4x64_epi64(_mm256_packs_epi16(lo, hi), 
+            _MM_SHUFFLE(3, 1, 2, 0));
+    if ((mask &= (uint32_t)_mm256_movemask_epi8(lo)) == 0) {
+        return 0;
+    }
+
+    // Hour: 8 IDs per vector.
+    bit = _mm256_set1_epi32((int)time->hour);
+    for (idx = 0, part = 0; idx < MATCH_BLOCK; idx += 8) {
+        lo = _mm256_loadu_si256((const __m256i *)(store->hours + base + idx));
+        lo = _mm256_cmpeq_epi32(_mm256_and_si256(lo, bit), bit);
+        part |= (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(lo)) << idx;
+    }
+    if ((mask &= part) == 0) {
+        return 0;
+    }
+
+    // Minute: 4 IDs per vector.
+    bit = _mm256_set1_epi64x((long long)time->minute);
+    for (idx = 0, part = 0; idx < MATCH_BLOCK; idx += 4) {
+        lo = _mm256_loadu_si256(
+                (const __m256i *)(store->minutes + base + idx));
+        lo = _mm256_cmpeq_epi64(_mm256_and_si256(lo, bit), bit);
+        part |= (uint32_t)_mm256_movemask_pd(_mm256_castsi256_pd(lo)) << idx;
+    }
+    if ((mask &= part) == 0) {
+        return 0;
+    }
+
+    // Day of month: 8 IDs per vector.
+    bit = _mm256_set1_epi32((int)time->dayOfMonth);
+    for (idx = 0, part = 0; idx < MATCH_BLOCK; idx += 8) {
+        lo = _mm256_loadu_si256(
+                (const __m256i *)(store->daysOfMonth + base + idx));
+        lo = _mm256_cmpeq_epi32(_mm256_and_si256(lo, bit), bit);
+        part |= (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(lo)) << idx;
+    }
+    return mask & part;
+}
+#endif
@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <signal.h>
+#include <pthread.h>
+#include "schedule.h"
+#include "executor.h"
+
+/* -----------------------------------------------------------------------------
+ *  Prototypes
+ * ---------------------------------------------------------------------------*/
+void * runExecutor(void * arg);
+Bool waitForFire(fireRecord * record);
+
+/* -----------------------------------------------------------------------------
+ *  Internal Structures
+ * ---------------------------------------------------------------------------*/
+
+/*
+ * Records handed from the dispatcher to the executors.  NULL if the
+ * executors are not running.
+ */
+static fireQueue * fires = NULL;
+static pthread_t executors[MAX_EXECUTORS];
+static int executorCount = 0;
+static size_t fireCapacity = 0;
+
+/*
+ * Idle executors sleep on wakeCond.  The dispatcher only takes wakeLock
+ * when sleepers shows an executor may be waiting.
+ */
+static pthread_mutex_t wakeLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wakeCond = PTHREAD_COND_INITIALIZER;
+static atomic_int sleepers = 0;
+static atomic_bool stopping = False;
+
+/* -----------------------------------------------------------------------------
+ *  Function definitions.
+ * ---------------------------------------------------------------------------*/
+
+int startExecutors(int count, size_t queueCapacity) {
+    sigset_t allSignals, oldSignals;
+    int status = 0;
+
+    if (executorCount > 0 || count <= 0 || count > MAX_EXECUTORS) {
+        return executorCount > 0 ? 0 : 1;
+    }
+    fires = createFireQueue(queueCapacity);
+    fireCapacity = queueCapacity;
+    atomic_store(&stopping, False);
+
+    // Executors inherit a mask blocking all signals, so SIGCHLD stays
+    // pending for the signalfd of the event loop.
+    sigfillset(&allSignals);
+    pthread_sigmask(SIG_BLOCK, &allSignals, &oldSignals);
+    while (executorCount < count) {
+        status = pthread_create(&executors[executorCount], NULL, runExecutor,
+                NULL);
+        if (status != 0) {
+            fprintf(stderr, "Failed to start executor: %s\n",
+                    strerror(status));
+            break;
+        }
+        executorCount++;
+    }
+    pthread_sigmask(SIG_SETMASK, &oldSignals, NULL);
+
+    if (status != 0) {
+        stopExecutors();
+        return 1;
+    }
+    return 0;
+}
+
+void stopExecutors() {
+    int idx;
+
+    if (fires == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&wakeLock);
+    atomic_store(&stopping, True);
+    pthread_cond_broadcast(&wakeCond);
+    pthread_mutex_unlock(&wakeLock);
+    for (idx = 0; idx < executorCount; idx++) {
+        pthread_join(executors[idx], NULL);
+    }
+    executorCount = 0;
+    freeFireQueue(fires);
+    fires = NULL;
+}
+
+int drainExecutors() {
+    int count = executorCount;
+
+    if (count == 0) {
+        return 0;
+    }
+    // Joining is the only point at which no executor holds a record.
+    stopExecutors();
+    return startExecutors(count, fireCapacity);
+}
+
+int getExecutorCount() {
+    return executorCount;
+}
+
+Bool dispatchFire(scheduleContext * ctx, scheduleEntry * entry, 
+        time_t absTime) {
+    fireRecord record;
+
+    if (fires == NULL) {
+        return False;
+    }
+    record.context = ctx;
+    record.entry = entry;
+    record.absTime = absTime;
+    if (pushFireQueue(fires, &record) == False) {
+        return False;
+    }
+    // Pairs with the fence in waitForFire.  Either the executor sees the
+    // record or the dispatcher sees the sleeper.
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&sleepers, memory_order_relaxed) > 0) {
+        pthread_mutex_lock(&wakeLock);
+        pthread_cond_signal(&wakeCond);
+        pthread_mutex_unlock(&wakeLock);
+    }
+    return True;
+}
+
+void getExecutorStats(fireQueueStats * stats) {
+    if (fires == NULL) {
+        memset(stats, 0, sizeof(fireQueueStats));
+        return;
+    }
+    getFireQueueStats(fires, stats);
+}
+
+/**
+ * Main loop of an executor thread.  Runs the actions of each record until
+ * stopped and the queue is empty.
+ */
+void * runExecutor(void * arg) {
+    fireRecord record;
+
+    (void)arg;
+    while (waitForFire(&record) == True) {
+        #ifdef DEBUG
+        printf("Executing %s at %ld\n", record.entry->task,
+                (long)record.absTime);
+        #endif // DEBUG
+        execActionCommand(record.context, record.entry, record.absTime);
+    }
+    return NULL;
+}
+
+/**
+ * Pop the next record, sleeping while the queue is empty.
+ * Returns:
+ *  True if a record was popped, False if stopping and the queue is empty.
+ */
+Bool waitForFire(fireRecord * record) {
+    Bool found;
+
+    if (popFireQueue(fires, record) == True) {
+        return True;
+    }
+    pthread_mutex_lock(&wakeLock);
+    atomic_fetch_add_explicit(&sleepers, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    while ((found = popFireQueue(fires, record)) == False
+            && atomic_load(&stopping) == False) {
+        pthread_cond_wait(&wakeCond, &wakeLock);
+    }
+    atomic_fetch_sub_explicit(&sleepers, 1, memory_order_relaxed);
+    pthread_mutex_unlock(&wakeLock);
+    return found;
+}
@@ -0,0 +1,145 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include "schedule.h"
+#include "fireQueue.h"
+
+/* -----------------------------------------------------------------------------
+ *  Prototypes
+ * ---------------------------------------------------------------------------*/
+void noteFireQueueDepth(fireQueue * queue, size_t depth);
+
+/* -----------------------------------------------------------------------------
+ *  Function definitions.
+ * ---------------------------------------------------------------------------*/
+
+fireQueue * createFireQueue(size_t capacity) {
+    fireQueue * queue;
+    size_t size = 2, idx;
+
+    while (size < capacity) {
+        size <<= 1;
+    }
+    queue = malloc(sizeof(fireQueue));
+    assert(queue != NULL);
+    memset(queue, 0, sizeof(fireQueue));
+    queue->slots = malloc(sizeof(fireSlot) * size);
+    assert(queue->slots != NULL);
+    queue->mask = size - 1;
+    // A slot is free for the producer at position p when its sequence is p.
+    for (idx = 0; idx < size; idx++) {
+        atomic_init(&queue->slots[idx].sequence, idx);
+    }
+    atomic_init(&queue->tail, 0);
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->pushed, 0);
+    atomic_init(&queue->dropped, 0);
+    atomic_init(&queue->maxDepth, 0);
+    return queue;
+}
+
+void freeFireQueue(fireQueue * queue) {
+    if (queue != NULL) {
+        free(queue->slots);
+        free(queue);
+    }
+}
+
+Bool pushFireQueue(fireQueue * queue, const fireRecord * record) {
+    fireSlot * slot;
+    size_t pos, sequence, head;
+    intptr_t diff;
+
+    pos = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    for (;;) {
+        slot = &queue->slots[pos & queue->mask];
+        sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        diff = (intptr_t)sequence - (intptr_t)pos;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&queue->tail, &pos,
+                        pos + 1, memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        }
+        else if (diff < 0) {
+            // Slot still holds the record from one lap ago.  Ring is full.
+            atomic_fetch_add_explicit(&queue->dropped, 1,
+                    memory_order_relaxed);
+            return False;
+        }
+        else {
+            pos = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+        }
+    }
+
+    slot->record = *record;
+    atomic_store_explicit(&slot->sequence, pos + 1, memory_order_release);
+    atomic_fetch_add_explicit(&queue->pushed, 1, memory_order_relaxed);
+    head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    noteFireQueueDepth(queue, pos + 1 > head ? pos + 1 - head : 0);
+    return True;
+}
+
+Bool popFireQueue(fireQueue * queue, fireRecord * record) {
+    fireSlot * slot;
+    size_t pos, sequence;
+    intptr_t diff;
+
+    pos = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    for (;;) {
+        slot = &queue->slots[pos & queue->mask];
+        sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        diff = (intptr_t)sequence - (intptr_t)(pos + 1);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&queue->head, &pos,
+                        pos + 1, memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        }
+        else if (diff < 0) {
+            // Slot not yet published.  Ring is empty.
+            return False;
+        }
+        else {
+            pos = atomic_load_explicit(&queue->head, memory_order_relaxed);
+        }
+    }
+
+    *record = slot->record;
+    // Free the slot for the producer one lap ahead.
+    atomic_store_explicit(&slot->sequence, pos + queue->mask + 1,
+            memory_order_release);
+    return True;
+}
+
+void getFireQueueStats(fireQueue * queue, fireQueueStats * stats) {
+    size_t head, tail;
+
+    head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    stats->capacity = queue->mask + 1;
+    stats->depth = tail > head ? tail - head : 0;
+    stats->maxDepth = atomic_load_explicit(&queue->maxDepth,
+            memory_order_relaxed);
+    stats->pushed = atomic_load_explicit(&queue->pushed, memory_order_relaxed);
+    stats->dropped = atomic_load_explicit(&queue->dropped,
+            memory_order_relaxed);
+}
+
+/**
+ * Raise the high water mark to depth if it is larger.  depth is computed
+ * from a head that may be stale, so it is limited to the capacity.
+ */
+void noteFireQueueDepth(fireQueue * queue, size_t depth) {
+    size_t current;
+
+    if (depth > queue->mask + 1) {
+        depth = queue->mask + 1;
+    }
+    current = atomic_load_explicit(&queue->maxDepth, memory_order_relaxed);
+    while (depth > current && !atomic_compare_exchange_weak_explicit(
+                &queue->maxDepth, &current, depth, memory_order_relaxed,
+                memory_order_relaxed));
+}
@@ -0,0 +1,377 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include "schedule.h"
+#include "launcher.h"
+
+#ifdef MSG_NOSIGNAL
+#define SEND_FLAGS MSG_NOSIGNAL
+#else
+#define SEND_FLAGS 0
+#endif
+
+/* -----------------------------------------------------------------------------
+ *  Prototypes
+ * ---------------------------------------------------------------------------*/
+void closeLauncher();
+void runLauncher(int fd);
+void launchRequest(int fd, char * request, size_t requestLen);
+void sendLaunchReply(int fd, enum LaunchMsgType type, pid_t pid, int status);
+void reportExits(int fd);
+void childExited(int signum);
+Bool readLauncherReply(launchReply * reply, Bool wait);
+Bool readFull(int fd, void * buffer, size_t len);
+Bool writeFull(int fd, const void * buffer, size_t len);
+
+/* -----------------------------------------------------------------------------
+ *  Internal Structures
+ * ---------------------------------------------------------------------------*/
+
+/*
+ * Scheduler end of the socketpair.  -1 if the launcher is not running.
+ */
+static int launcherFd = -1;
+static pid_t launcherPid = -1;
+
+/*
+ * Exit reports received while waiting for a launch to be confirmed.
+ */
+static int pendingExits = 0;
+
+/*
+ * Serializes use of the socket by executors and the event loop, so each
+ * launch reads its own reply.
+ */
+static pthread_mutex_t launcherLock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Within the launcher, written to by the SIGCHLD handler to wake poll.
+ */
+static int exitPipe[2];
+
+/* -----------------------------------------------------------------------------
+ *  Function definitions.
+ * ---------------------------------------------------------------------------*/
+
+int startLauncher() {
+    int fds[2];
+    pid_t childPid;
+
+    if (launcherFd >= 0) {
+        return 0;
+    }
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        perror("socketpair failed");
+        return 1;
+    }
+    childPid = fork();
+    if (childPid < 0) {
+        perror("fork failed");
+        close(fds[0]);
+        close(fds[1]);
+        return 1;
+    }
+    if (childPid == 0) {
+        close(fds[0]);
+        runLauncher(fds[1]);
+        _exit(0);
+    }
+
+    close(fds[1]);
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    launcherFd = fds[0];
+    launcherPid = childPid;
+    pendingExits = 0;
+    return 0;
+}
+
+void stopLauncher() {
+    pthread_mutex_lock(&launcherLock);
+    closeLauncher();
+    pthread_mutex_unlock(&launcherLock);
+}
+
+/**
+ * Stop the launcher.  Called with launcherLock held.
+ */
+void closeLauncher() {
+    if (launcherFd >= 0) {
+        close(launcherFd);
+        launcherFd = -1;
+        // The launcher exits as soon as it sees the connection closed.
+        while (waitpid(launcherPid, NULL, 0) < 0 && errno == EINTR);
+        launcherPid = -1;
+    }
+}
+
+int getLauncherFd() {
+    return launcherFd;
+}
+
+/**
+ * A request is its length followed by the null terminated arguments.
+ */
+pid_t launcherSpawn(char * const argv[]) {
+    char request[sizeof(uint32_t) + LAUNCH_MAX_REQUEST];
+    launchReply reply;
+    uint32_t requestLen = 0;
+    size_t argLen;
+    int argIdx;
+    pid_t childPid = -1;
+
+    for (argIdx = 0; argv[argIdx] != NULL; argIdx++) {
+        argLen = strlen(argv[argIdx]) + 1;
+        if (argIdx >= LAUNCH_MAX_ARGS
+                || requestLen + argLen > LAUNCH_MAX_REQUEST) {
+            fprintf(stderr, "Failed to launch %s: Command too long\n", 
+                    argv[0]);
+            return -1;
+        }
+        memcpy(request + sizeof(requestLen) + requestLen, argv[argIdx], 
+                argLen);
+        requestLen += argLen;
+    }
+    memcpy(request, &requestLen, sizeof(requestLen));
+
+    pthread_mutex_lock(&launcherLock);
+    if (launcherFd < 0 || writeFull(launcherFd, request, 
+                sizeof(requestLen) + requestLen) == False) {
+        if (launcherFd >= 0) {
+            perror("Launcher request failed");
+            closeLauncher();
+        }
+        pthread_mutex_unlock(&launcherLock);
+        return spawnArgs(argv);
+    }
+
+    // Exit reports may arrive ahead of the reply to this request.
+    while (readLauncherReply(&reply, True) == True) {
+        if (reply.type == LM_EXITED) {
+            pendingExits++;
+        }
+        else {
+            if (reply.status != 0) {
+                fprintf(stderr, "Failed to launch %s: %s\n", argv[0],
+                        strerror(reply.status));
+            }
+            else {
+                childPid = reply.pid;
+            }
+            break;
+        }
+    }
+    pthread_mutex_unlock(&launcherLock);
+    return childPid;
+}
+
+int collectLauncherExits() {
+    launchReply reply;
+    int exited;
+
+    pthread_mutex_lock(&launcherLock);
+    exited = pendingExits;
+    pendingExits = 0;
+    while (launcherFd >= 0 && readLauncherReply(&reply, False) == True) {
+        if (reply.type == LM_EXITED) {
+            #ifdef DEBUG
+            printf("Launcher reaped %d: status %d\n", (int)reply.pid,
+                    reply.status);
+            #endif // DEBUG
+            exited++;
+        }
+    }
+    pthread_mutex_unlock(&launcherLock);
+    return exited;
+}
+
+/**
+ * Read one reply from the launcher.  Unless waiting, returns False if a
+ * complete reply is not available.  If the launcher has exited, it is
+ * stopped so later commands are launched directly.
+ */
+Bool readLauncherReply(launchReply * reply, Bool wait) {
+    ssize_t readLen = sizeof(launchReply);
+
+    if (wait == False) {
+        do {
+            readLen = recv(launcherFd, reply, sizeof(launchReply), 
+                    MSG_PEEK | MSG_DONTWAIT);
+        } while (readLen < 0 && errno == EINTR);
+        if (readLen < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return False;
+        }
+    }
+
+    if (readLen > 0 && (size_t)readLen < sizeof(launchReply)) {
+        return False;
+    }
+    if (readLen > 0 && readFull(launcherFd, reply, sizeof(launchReply))) {
+        return True;
+    }
+    fprintf(stderr, "Launcher exited\n");
+    closeLauncher();
+    return False;
+}
+
+/**
+ * Read exactly len bytes.  Returns False on end of file or error.
+ */
+Bool readFull(int fd, void * buffer, size_t len) {
+    ssize_t readLen;
+
+    while (len > 0) {
+        readLen = read(fd, buffer, len);
+        if (readLen < 0 && errno == EINTR) {
+            continue;
+        }
+        if (readLen <= 0) {
+            return False;
+        }
+        buffer = (char *)buffer + readLen;
+        len -= readLen;
+    }
+    return True;
+}
+
+Bool writeFull(int fd, const void * buffer, size_t len) {
+    ssize_t writeLen;
+
+    while (len > 0) {
+        writeLen = send(fd, buffer, len, SEND_FLAGS);
+        if (writeLen < 0 && errno == EINTR) {
+            continue;
+        }
+        if (writeLen <= 0) {
+            return False;
+        }
+        buffer = (const char *)buffer + writeLen;
+        len -= writeLen;
+    }
+    return True;
+}
+
+/**
+ * Main loop of the launcher.  Waits for launch requests from the scheduler
+ * and for launched commands to exit.  Returns when the scheduler closes its
+ * end of the socketpair.
+ */
+void runLauncher(int fd) {
+    char request[LAUNCH_MAX_REQUEST + 1];
+    struct pollfd fds[2];
+    struct sigaction action;
+    sigset_t signals;
+    uint32_t requestLen;
+    char drain[64];
+
+    if (pipe(exitPipe) < 0) {
+        perror("Launcher pipe failed");
+        return;
+    }
+    fcntl(exitPipe[0], F_SETFL, O_NONBLOCK);
+    fcntl(exitPipe[1], F_SETFL, O_NONBLOCK);
+    fcntl(exitPipe[0], F_SETFD, FD_CLOEXEC);
+    fcntl(exitPipe[1], F_SETFD, FD_CLOEXEC);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = childExited;
+    action.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+    sigaction(SIGCHLD, &action, NULL);
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGCHLD);
+    sigprocmask(SIG_UNBLOCK, &signals, NULL);
+
+    fds[0].fd = fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = exitPipe[0];
+    fds[1].events = POLLIN;
+    for (;;) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("Launcher poll failed");
+            return;
+        }
+        if (fds[1].revents & POLLIN) {
+            while (read(exitPipe[0], drain, sizeof(drain)) > 0);
+            reportExits(fd);
+        }
+        if (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+            // Exit when the scheduler closes the connection.
+            if (readFull(fd, &requestLen, sizeof(requestLen)) == False
+                    || requestLen > LAUNCH_MAX_REQUEST
+                    || readFull(fd, request, requestLen) == False) {
+                return;
+            }
+            launchRequest(fd, request, requestLen);
+        }
+    }
+}
+
+/**
+ * Split the request into arguments, launch it and reply with the result.
+ */
+void launchRequest(int fd, char * request, size_t requestLen) {
+    char * argv[LAUNCH_MAX_ARGS + 1];
+    char * current = request;
+    int argc = 0, status;
+    pid_t childPid;
+
+    // Arguments are null terminated.  Terminate the last in case it is not.
+    request[requestLen] = '\0';
+    while (current < request + requestLen && argc < LAUNCH_MAX_ARGS) {
+        argv[argc++] = current;
+        current += strlen(current) + 1;
+    }
+    argv[argc] = NULL;
+    if (argc == 0) {
+        sendLaunchReply(fd, LM_LAUNCHED, -1, EINVAL);
+        return;
+    }
+
+    status = spawnProcess(argv, &childPid);
+    sendLaunchReply(fd, LM_LAUNCHED, status == 0 ? childPid : -1, status);
+}
+
+void sendLaunchReply(int fd, enum LaunchMsgType type, pid_t pid, int status) {
+    launchReply reply;
+
+    memset(&reply, 0, sizeof(reply));
+    reply.type = type;
+    reply.pid = pid;
+    reply.status = status;
+    writeFull(fd, &reply, sizeof(reply));
+}
+
+/**
+ * Reap all exited commands and report each to the scheduler.
+ */
+void reportExits(int fd) {
+    pid_t childPid;
+    int status;
+
+    while ((childPid = waitpid(-1, &status, WNOHANG)) > 0) {
+        sendLaunchReply(fd, LM_EXITED, childPid, status);
+    }
+}
+
+/**
+ * SIGCHLD handler within the launcher.  Only wakes the main loop.
+ */
+void childExited(int signum) {
+    int savedErrno = errno;
+
+    (void)signum;
+    write(exitPipe[1], "c", 1);
+    errno = savedErrno;
+}
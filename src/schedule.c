@@ -7,9 +7,20 @@
 #include <signal.h>
 #include <limits.h>
 #include <unistd.h>
-#include <math.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <pthread.h>
 #include "schedule.h"
 #include "timeRoutines.h"
+#include "taskQueue.h"
+#include "timingWheel.h"
+#include "launcher.h"
+#include "executor.h"
+#include "scheduleLoader.h"
+#include "scheduleReload.h"
+#include "scheduleArena.h"
+#include "stringPool.h"
+#include "entryStore.h"
 #include "schedule.tab.h"
 
 #define SUCCESS 0
@@ -21,6 +32,31 @@
 
 #define TIME_IN_PAST -1
 
+// Number of years past the current year searched before giving up on an entry
+// whose calendar values can never occur, e.g. Feb 30.
+#define MAX_YEAR_SEARCH 400
+
+#define SECS_PER_MIN 60
+#define SECS_PER_HOUR 3600
+#define SECS_PER_DAY 86400
+
+// Number of local days for which the offset from UTC is cached.  Power of 2.
+#define OFFSET_CACHE_SIZE 64
+
+// Number of events read from an agenda stream at a time by generateAgenda
+#define AGENDA_BUFFER_SIZE 32
+
+// Number of entry IDs matched at a time by matchEntriesAt
+#define MATCH_BUFFER_SIZE 64
+// Minutes matched by calcNextMatchAlarm before finding the next alarm from
+// the next times of the entries
+#define MATCH_SEARCH_MINUTES 60
+
+// Fewest slots of the defined action index.  Power of 2.
+#define MIN_ACTION_SLOTS 16
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
 #define ERR_FILE stdout
 
 // Local implementation of strnlen.
@@ -35,37 +71,46 @@ size_t strnlen(const char *s, size_t n)
  * ---------------------------------------------------------------------------*/
 
 /*
- * Head and tail of linked list containing all schedule entries.
+ * Guards the rendered commands of entries, which executors share.
  */
-static scheduleNode * schedHead;
-static scheduleNode * schedTail;
+static pthread_mutex_t renderLock = PTHREAD_MUTEX_INITIALIZER;
 
 /*
- * Current number of schedule entries
+ * Time calc variables
  */
-int scheduleCount = 0;
-
+const int monthDaysNorm[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+const int monthDaysLeap[] = {31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
 
 /*
- * Head and tail of linked list containing all action entries.
+ * Offset from UTC of one local day.  The offset is only cached if it is the
+ * same for the entire day.  Days on which the offset changes, such as the 
+ * start and end of DST, are converted using the C library.
  */
-static actionNode * cmdHead;
-static actionNode * cmdTail;
+enum OffsetState {OFFSET_EMPTY, OFFSET_FIXED, OFFSET_CHANGES};
+typedef struct _utcOffsetStruct {
+    long day;                   // Local days since 1970-01-01
+    long offset;                // Seconds east of UTC
+    enum OffsetState state;
+} utcOffsetEntry;
 
 /*
- * Time calc variables
+ * The cache only depends on the time zone, so it is shared by all schedules.
+ * Each thread has its own so schedules may be used on different threads.
  */
-const int monthDaysNorm[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
-const int monthDaysLeap[] = {31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
-const int INIT_MON_VAL  = 0;
-const int INIT_DOM_VAL  = 1;
-const int INIT_HOUR_VAL = 0;
-const int INIT_MIN_VAL  = 0;
+static _Thread_local utcOffsetEntry offsetCache[OFFSET_CACHE_SIZE];
 
-enum CalIndex {CI_YEAR, CI_MOY, CI_DOM, CI_DOW, CI_HOUR, CI_MIN};
+// Offset of the most recent conversion.  Used to guess the local day.
+static _Thread_local long lastUtcOffset = 0;
 
-// Used in testing.  Allows test program to set "current" time.
-static time_t timeOverride = 0;
+/*
+ * Occurrence held by getUpcomingEvents.  entryIdx is the position of the 
+ * entry within the schedule and orders occurrences at the same time.
+ */
+typedef struct _upcomingStruct {
+    time_t nextTime;
+    int entryIdx;
+    scheduleEntry * entry;
+} upcomingEvent;
 
 /* -----------------------------------------------------------------------------
  *  Prototypes
@@ -79,50 +124,100 @@ int processScheduleFile(const char * fileName);
 void runNotifications();
 void displayCalValue(FILE * out, valueStruct * value);
 
-int rollYear(scheduleEntry * entry, struct tm * scheduled);
-int rollMonth(scheduleEntry * entry, struct tm * scheduled);
-int rollDayOfMonth(scheduleEntry * entry, struct tm * scheduled);
-int rollHour(scheduleEntry * entry, struct tm * scheduled);
-int rollMinute(scheduleEntry * entry, struct tm * scheduled);
-
 int daysInMonth(int year, int month);
 
-void initValues(scheduleEntry *entry, struct tm *scheduled, enum CalIndex level);
-int returnFirstValue(valueStruct values);
-
-void execActionCommand(scheduleEntry * entry);
+uint64_t compileValueStruct(valueStruct * value, int minVal, int maxVal);
+int nextMaskValue(uint64_t mask, int current);
+uint32_t dayOfMonthMask(calendarMask *compiled, int year, int month);
+int findNextScheduledTime(scheduleEntry *entry, calTime *next);
+int findNextMaskTime(calendarMask *compiled, valueStruct *year, 
+        calTime *next);
+void initSearchStart(time_t currentTime, calTime *start);
+time_t calcNextTimeFromStart(scheduleEntry *entry, calTime *start, 
+        time_t currentTime);
+entryStore * scanNextTimes(scheduleContext * ctx, time_t currentTime);
+
+utcOffsetEntry * lookupUtcOffset(long day);
+void resetUtcOffsetCache();
+
+void launchAction(scheduleEntry * entry, actionDef * action, 
+        time_t scheduledTime);
+actionDef * createArenaAction(scheduleArena * arena, char * commandName, 
+        char * commandStr, enum ActionType type);
+void compileActionCommand(scheduleArena * arena, actionDef * action);
+commandSegment * addCommandSegment(scheduleArena * arena, 
+        commandSegment ** tail, enum SegmentType type);
+actionNode * allocActionNode(scheduleArena * arena, actionDef * action);
+uint32_t hashActionName(const char * name);
+void indexActionCommand(actionIndex * index, actionDef * action);
+Bool placeActionSlot(actionIndex * index, actionDef * action);
+actionDef ** appendActionList(actionDef ** list, int * count, 
+        actionDef * action);
+void freeActionIndex(actionIndex * index);
+void freeCommandArgs(commandArg * arg);
+const char * segmentValue(commandSegment * segment, scheduleEntry * entry,
+        time_t scheduledTime, char * buffer, int bufferLen, int * valueLen);
+void freeRenderedCommands(renderedCommand * rendered);
 
 scheduleEntry * parseSchedule(const char * buffer);
-void addEntryToList(scheduleEntry * entry);
+scheduleEntry * allocScheduleEntry(scheduleArena * arena, valueStruct * year, 
+        valueStruct * month, valueStruct * dayOfMonth, valueStruct * dayOfWeek,
+        valueStruct * hour, valueStruct * minute,  calendarMask * compiled, 
+        int duration);
+void addEntryToList(scheduleContext * ctx, scheduleEntry * entry);
+scheduleArena * currentArena(scheduleContext * ctx);
+void setEventEntry(eventEntry * event, scheduleEntry * entry, 
+        time_t nextTime);
 
-time_t setDebugTime(time_t time);
-time_t getCurrentTime();
+time_t getCurrentTime(scheduleContext * ctx);
 
 valueStruct * copyValueStruct(valueStruct * dest, valueStruct * source);
+valueStruct * copyArenaValueStruct(scheduleArena * arena, valueStruct * dest, 
+        valueStruct * source);
 void normalizeValueStruct(valueStruct * value);
 
 int compareCurrentToSchedule(int current, valueStruct *values);
 
 int compareEventTime(const void * event1, const void * event2);
-eventEntry ** getScheduledEvents(time_t startTime, time_t stopTime, 
-        int * numEvents);
-
+Bool isEarlierOccurrence(occurrenceIter * iter1, occurrenceIter * iter2);
+void siftDownAgenda(agendaStream * agenda, int idx);
+Bool displayAgendaEvent(eventEntry * event, void * userData);
+Bool isLaterUpcoming(upcomingEvent * event1, upcomingEvent * event2);
+void siftDownUpcoming(upcomingEvent * heap, int heapCount, int idx);
 int setTaskAlarm(time_t timeToSleep);
 
-scheduleNode * createScheduleNode();
-void freeScheduleNodeList(scheduleNode * current);
-void freeEventSchedule(eventEntry ** schedule, int numEvents);
-/**
- * Fork off the process and spawn the provided command using
- * the system(3) call.
- * @cmd Fully qualified command string to pass to system().
- */
-void spawnCommand(char *cmd);
+void buildTaskAlarmQueue(scheduleContext * ctx, time_t currentTime);
+scheduledExec * calcNextQueueAlarm(scheduleContext * ctx, time_t currentTime);
+scheduledExec * calcNextWheelAlarm(scheduleContext * ctx, time_t currentTime);
+void buildTaskAlarmWheel(scheduleContext * ctx, time_t currentTime);
+scheduledExec * calcNextMatchAlarm(scheduleContext * ctx, time_t currentTime);
+int findEarliestEntries(scheduleContext * ctx, time_t currentTime, 
+        scheduleEntry ** matches, time_t * earliest);
+Bool offsetChangesWithin(time_t startTime, time_t stopTime);
+void returnDueTimers(scheduleContext * ctx, time_t startTime);
 
 /* -----------------------------------------------------------------------------
  *  Function definitions.
  * ---------------------------------------------------------------------------*/
 
+scheduleContext * createScheduleContext() {
+    scheduleContext * ctx;
+
+    ctx = (scheduleContext*)malloc(sizeof(scheduleContext));
+    assert(ctx != NULL);
+    memset(ctx, 0, sizeof(scheduleContext));
+    ctx->dispatchMode = DISPATCH_QUEUE;
+    return ctx;
+}
+
+void freeScheduleContext(scheduleContext * ctx) {
+    if (ctx != NULL) {
+        freeSchedule(ctx);
+        freeScheduleWatch(ctx->watch);
+        free(ctx);
+    }
+}
+
 /**
  * Add a schedule entry to the list of entries using the 
  * values provided.  
@@ -141,23 +236,24 @@ void spawnCommand(char *cmd);
  *  SUCCESS if entry created.
  *  ERROR   if error occurred during add.  Entry was not created.
  */
-int addScheduleEntryAdv(valueStruct * year, valueStruct * month, 
-        valueStruct * dayOfMonth, valueStruct * dayOfWeek, valueStruct * hour, 
-        valueStruct * minute,  int duration,
+int addScheduleEntryAdv(scheduleContext * ctx, valueStruct * year, 
+        valueStruct * month, valueStruct * dayOfMonth, valueStruct * dayOfWeek,
+        valueStruct * hour, valueStruct * minute,  int duration,
 		const char * task, const char * reminder) {
 
 	scheduleEntry * entry;
 
     // Create entry.  
-	entry = createScheduleEntryAdv(year, month, dayOfMonth, dayOfWeek,
-			hour, minute, duration, task, reminder);
+	entry = allocScheduleEntry(currentArena(ctx), year, month, dayOfMonth, 
+            dayOfWeek, hour, minute, NULL, duration);
     if(entry == NULL) {
         // Unable to create entry
         printf("Error for task: %s. Cannot continue.",
                 task);
         return (ERROR);
     }
-    addEntryToList(entry);
+    internEntryText(ctx, entry, task, reminder, False);
+    addEntryToList(ctx, entry);
     return SUCCESS;
 }
 
@@ -180,9 +276,9 @@ int addScheduleEntryAdv(valueStruct * year, valueStruct * month,
  *  SUCCESS if entry created.
  *  ERROR   if error occurred during add.  Entry was not created.
  */
-int addScheduleEntryNormalize(valueStruct * year, valueStruct * month, 
-        valueStruct * dayOfMonth, valueStruct * dayOfWeek, valueStruct * hour, 
-        valueStruct * minute,  int duration,
+int addScheduleEntryNormalize(scheduleContext * ctx, valueStruct * year, 
+        valueStruct * month, valueStruct * dayOfMonth, valueStruct * dayOfWeek,
+        valueStruct * hour, valueStruct * minute,  int duration,
 		const char * task, const char * reminder,
         actionNode * actionSet) {
 
@@ -192,16 +288,60 @@ int addScheduleEntryNormalize(valueStruct * year, valueStruct * month,
     normalizeValueStruct(dayOfWeek);
 
     // Create entry.  
-	entry = createScheduleEntryAdv(year, month, dayOfMonth, dayOfWeek,
-			hour, minute, duration, task, reminder);
+	entry = allocScheduleEntry(currentArena(ctx), year, month, dayOfMonth, 
+            dayOfWeek, hour, minute, NULL, duration);
     if(entry == NULL) {
         // Unable to create entry
         printf("Error for task: %s. Cannot continue.",
                 task);
         return (ERROR);
     }
+    internEntryText(ctx, entry, task, reminder, False);
+    entry->actionSet = actionSet;
+    addEntryToList(ctx, entry);
+    return SUCCESS;
+}
+
+int addScheduleEntryShared(scheduleContext * ctx, valueStruct * year, 
+        valueStruct * month, valueStruct * dayOfMonth, valueStruct * dayOfWeek,
+        valueStruct * hour, valueStruct * minute,  int duration,
+		char * task, char * reminder, actionNode * actionSet) {
+
+	scheduleEntry * entry;
+
+    normalizeValueStruct(month);
+    normalizeValueStruct(dayOfWeek);
+
+	entry = allocScheduleEntry(currentArena(ctx), year, month, dayOfMonth, 
+            dayOfWeek, hour, minute, NULL, duration);
+    if(entry == NULL) {
+        printf("Error for task: %s. Cannot continue.",
+                task);
+        return (ERROR);
+    }
+    internEntryText(ctx, entry, task, reminder, True);
+    entry->actionSet = actionSet;
+    addEntryToList(ctx, entry);
+    return SUCCESS;
+}
+
+int addCompiledScheduleEntry(scheduleContext * ctx, valueStruct * year, 
+        valueStruct * month, valueStruct * dayOfMonth, valueStruct * dayOfWeek,
+        valueStruct * hour, valueStruct * minute, calendarMask * compiled,
+        int duration, char * task, char * reminder, actionNode * actionSet) {
+
+	scheduleEntry * entry;
+
+	entry = allocScheduleEntry(currentArena(ctx), year, month, dayOfMonth, 
+            dayOfWeek, hour, minute, compiled, duration);
+    if(entry == NULL) {
+        printf("Error for task: %s. Cannot continue.",
+                task);
+        return (ERROR);
+    }
+    internEntryText(ctx, entry, task, reminder, True);
     entry->actionSet = actionSet;
-    addEntryToList(entry);
+    addEntryToList(ctx, entry);
     return SUCCESS;
 }
 
@@ -281,18 +421,11 @@ scheduleEntry * createScheduleEntryAdv(valueStruct * year, valueStruct * month,
         valueStruct * minute,  int duration,
 		const char * task, const char * reminder) {
 	scheduleEntry * entry;
-	entry = (scheduleEntry*) malloc(sizeof(scheduleEntry));
+	entry = allocScheduleEntry(NULL, year, month, dayOfMonth, dayOfWeek, 
+            hour, minute, NULL, duration);
 	if(entry == NULL) {
-		perror("Failed to allocate memory for schedule entry");
 		return NULL;
 	}
-	copyValueStruct(&entry->year, year);
-	copyValueStruct(&entry->monOfYear, month);
-	copyValueStruct(&entry->dayOfMonth, dayOfMonth);
-	copyValueStruct(&entry->dayOfWeek, dayOfWeek);
-	copyValueStruct(&entry->hour, hour);
-	copyValueStruct(&entry->minute, minute);
-	entry->durationInMin = duration;
 
 	// Task field
     entry->task = strdup(task);
@@ -305,9 +438,58 @@ scheduleEntry * createScheduleEntryAdv(valueStruct * year, valueStruct * month,
 	return entry;
 }
 
+/**
+ * Allocate an entry holding a copy of the calendar values from the arena,
+ * or the heap if arena is NULL.  The values are compiled unless already 
+ * compiled is provided.  Task and reminder are left for the caller.
+ */
+scheduleEntry * allocScheduleEntry(scheduleArena * arena, valueStruct * year, 
+        valueStruct * month, valueStruct * dayOfMonth, valueStruct * dayOfWeek,
+        valueStruct * hour, valueStruct * minute,  calendarMask * compiled, 
+        int duration) {
+	scheduleEntry * entry;
+	entry = (scheduleEntry*) arenaAlloc(arena, sizeof(scheduleEntry));
+    entry->arena = arena;
+    retainArena(arena);
+	copyArenaValueStruct(arena, &entry->year, year);
+	copyArenaValueStruct(arena, &entry->monOfYear, month);
+	copyArenaValueStruct(arena, &entry->dayOfMonth, dayOfMonth);
+	copyArenaValueStruct(arena, &entry->dayOfWeek, dayOfWeek);
+	copyArenaValueStruct(arena, &entry->hour, hour);
+	copyArenaValueStruct(arena, &entry->minute, minute);
+    if (compiled != NULL) {
+        entry->compiled = *compiled;
+    }
+    else {
+        compileScheduleEntry(entry);
+    }
+	entry->durationInMin = duration;
+    entry->actionSet = NULL;
+    entry->rendered = NULL;
+    entry->contentHash = 0;
+    entry->alarmSlot = -1;
+    entry->alarmTimer = NULL;
+    entry->task = NULL;
+    entry->reminderMessage = NULL;
+    entry->taskId = entry->reminderId = 0;
+    entry->sharedText = False;
+    entry->storeId = ENTRY_NOT_STORED;
+    entry->listPos = 0;
+
+	return entry;
+}
+
 void freeScheduleEntry(scheduleEntry *entry) {
-	free(entry->task);
-	free(entry->reminderMessage);
+    freeRenderedCommands(entry->rendered);
+    // Freed with its generation.
+    if (entry->arena != NULL) {
+        releaseArena(entry->arena);
+        return;
+    }
+    if (entry->sharedText == False) {
+	    free(entry->task);
+	    free(entry->reminderMessage);
+    }
     if (entry->year.type == LIST)       freeValueStructList(&entry->year);
     if (entry->monOfYear.type == LIST)  freeValueStructList(&entry->monOfYear);
     if (entry->dayOfMonth.type == LIST) freeValueStructList(&entry->dayOfMonth);
@@ -317,23 +499,129 @@ void freeScheduleEntry(scheduleEntry *entry) {
 	free(entry); 
 }
 
-void addEntryToList(scheduleEntry * entry) {
+void addEntryToList(scheduleContext * ctx, scheduleEntry * entry) {
 	scheduleNode * current;
-	current = createScheduleNode();
+	current = arenaAlloc(currentArena(ctx), sizeof(scheduleNode));
 	current->entry = entry;
-	if (schedTail != NULL) {
-		schedTail->next = current;
-		schedTail = current;
+    current->next = NULL;
+	if (ctx->schedTail != NULL) {
+		ctx->schedTail->next = current;
+		ctx->schedTail = current;
 	}
 	else {
-		schedHead = schedTail = current;
+		ctx->schedHead = ctx->schedTail = current;
 	}
 
-    scheduleCount++;
+    entry->listPos = ctx->scheduleCount++;
+    storeScheduleEntry(ctx, entry);
+
+    // Keep an existing alarm queue or wheel in step with the schedule.
+    addEntryAlarm(ctx, entry);
+}
+
+void addEntryAlarm(scheduleContext * ctx, scheduleEntry * entry) {
+    time_t schedTimer, currentTime;
+
+    if (ctx->alarmQueue == NULL && ctx->alarmWheel == NULL) {
+        return;
+    }
+    currentTime = getCurrentTime(ctx);
+    if (currentTime < ctx->lastExecTime) {
+        currentTime = ctx->lastExecTime;
+    }
+    schedTimer = calcNextTimeForTaskFrom(entry, currentTime);
+    if (schedTimer == TIME_IN_PAST) {
+        return;
+    }
+    if (ctx->alarmQueue != NULL) {
+        pushTaskQueue(ctx->alarmQueue, schedTimer, entry);
+        return;
+    }
+    // The wheel has moved past the alarm being held, so it can only be
+    // joined or preceded once the held timers are back in the wheel.
+    if (ctx->dueTimers != NULL && schedTimer <= ctx->dueTime) {
+        returnDueTimers(ctx, schedTimer);
+    }
+    insertWheelTimer(ctx->alarmWheel, schedTimer, entry);
+}
+
+void removeEntryAlarm(scheduleContext * ctx, scheduleEntry * entry) {
+    wheelTimer ** link, * timer = entry->alarmTimer;
+
+    if (ctx->alarmQueue != NULL) {
+        removeTaskQueueEntry(ctx->alarmQueue, entry);
+    }
+    else if (ctx->alarmWheel != NULL && timer != NULL) {
+        // Detached timers are held as the most recently returned alarm.
+        if (timer->level == WL_DETACHED) {
+            for (link = &ctx->dueTimers; *link != NULL; 
+                    link = &(*link)->next) {
+                if (*link == timer) {
+                    *link = timer->next;
+                    break;
+                }
+            }
+        }
+        cancelWheelTimer(ctx->alarmWheel, timer);
+    }
+}
+
+void internEntryText(scheduleContext * ctx, scheduleEntry * entry, 
+        const char * task, const char * reminder, Bool shared) {
+    if (ctx->strings == NULL) {
+        ctx->strings = createStringPool();
+    }
+    if (shared) {
+        entry->taskId = internSharedPoolString(ctx->strings, task);
+        entry->reminderId = internSharedPoolString(ctx->strings, reminder);
+    }
+    else {
+        entry->taskId = internPoolString(ctx->strings, task);
+        entry->reminderId = internPoolString(ctx->strings, reminder);
+    }
+    entry->task = (char *)poolString(ctx->strings, entry->taskId);
+    entry->reminderMessage = (char *)poolString(ctx->strings, 
+            entry->reminderId);
+    entry->sharedText = shared;
+}
+
+void storeScheduleEntry(scheduleContext * ctx, scheduleEntry * entry) {
+    if (ctx->store == NULL) {
+        ctx->store = createEntryStore();
+    }
+    if (isStoreEntry(ctx->store, entry) == False) {
+        addStoreEntry(ctx->store, entry);
+    }
+}
+
+/**
+ * Return the generation new entries and actions of the schedule are 
+ * allocated from, creating it if the schedule has none.
+ */
+scheduleArena * currentArena(scheduleContext * ctx) {
+    if (ctx->arena == NULL) {
+        ctx->arena = createScheduleArena();
+    }
+    return ctx->arena;
+}
+
+/**
+ * Place the timers of the alarm being held back into the wheel, rewinding 
+ * the wheel to startTime so they expire in order with earlier timers.
+ */
+void returnDueTimers(scheduleContext * ctx, time_t startTime) {
+    wheelTimer * timer, * next;
+
+    rewindTimingWheel(ctx->alarmWheel, startTime);
+    for (timer = ctx->dueTimers; timer != NULL; timer = next) {
+        next = timer->next;
+        rescheduleWheelTimer(ctx->alarmWheel, timer, timer->expires);
+    }
+    ctx->dueTimers = NULL;
 }
 
-void displaySchedule(FILE * out) {
-	scheduleNode * current = schedHead;
+void displaySchedule(scheduleContext * ctx, FILE * out) {
+	scheduleNode * current = ctx->schedHead;
 	while (current != NULL) {
 		printf("Y: ");
         displayCalValue(out, &current->entry->year);
@@ -402,14 +690,14 @@ void displayCalValue(FILE * out, valueStruct * value) {
     }
 }
 
-void displayTodaysSchedulex(FILE * out) {
+void displayTodaysSchedulex(scheduleContext * ctx, FILE * out) {
     int calCompDoW, calCompDoM;
 	time_t timer;
 	struct tm *today;
-	timer = getCurrentTime();
+	timer = getCurrentTime(ctx);
 	today = localtime(&timer);
 
-	scheduleNode * current = schedHead;
+	scheduleNode * current = ctx->schedHead;
 	while (current != NULL) {
         calCompDoW = compareCurrentToSchedule(today->tm_wday, 
             &current->entry->dayOfWeek);
@@ -426,261 +714,701 @@ void displayTodaysSchedulex(FILE * out) {
 	fflush(out);
 }
 
-void displayTodaysSchedule(FILE * out) {
-    int numEvents;
-    int eventIdx;
-    char *formattedTime;
-    eventEntry ** schedule;
-    eventEntry * currentEvent;
-	time_t timer, startTime, stopTime;
-	struct tm *today, start, stop;
-	timer = getCurrentTime();
+/**
+ * Display every remaining occurrence of all entries for today in time order.
+ * Each remaining minute of the day is matched against all entries.  If the 
+ * offset from UTC changes today, local times may be skipped or repeated, so
+ * the agenda is generated from next times instead.
+ */
+void displayTodaysSchedule(scheduleContext * ctx, FILE * out) {
+	time_t timer, stopTime, minuteTime;
+	struct tm *today, stop;
+    scheduleEntry ** matches;
+    eventEntry event;
+    int numMatches, matchIdx;
+
+	timer = getCurrentTime(ctx);
 	today = localtime(&timer);
 
-    memcpy(&start, today, sizeof(struct tm));
-    start.tm_hour = 0;
-    start.tm_min = 0;
-    start.tm_sec = 0;
-    startTime = mktime(&start);
-
     memcpy(&stop, today, sizeof(struct tm));
     stop.tm_hour = 23;
     stop.tm_min = 59;
     stop.tm_sec = 59;
+    // DST may differ at the end of the day.
+    stop.tm_isdst = -1;
     stopTime = mktime(&stop);
 
-    schedule = getScheduledEvents(startTime, stopTime, &numEvents);
+    if (ctx->scheduleCount == 0) {
+        return;
+    }
+    if (offsetChangesWithin(timer, stopTime) == True) {
+        generateAgenda(ctx, timer + 1, stopTime, displayAgendaEvent, out);
+        fflush(out);
+        return;
+    }
+    matches = malloc(sizeof(scheduleEntry *) * ctx->scheduleCount);
+    assert(matches != NULL);
+    // The current minute has already been activated.
+    for (minuteTime = (floorDiv(timer, SECS_PER_MIN) + 1) * SECS_PER_MIN; 
+            minuteTime <= stopTime; minuteTime += SECS_PER_MIN) {
+        numMatches = matchEntriesAt(ctx, minuteTime, matches, 
+                ctx->scheduleCount);
+        for (matchIdx = 0; matchIdx < numMatches; matchIdx++) {
+            setEventEntry(&event, matches[matchIdx], minuteTime);
+            displayAgendaEvent(&event, out);
+        }
+    }
+    free(matches);
+	fflush(out);
+}
 
-    for( eventIdx=0; eventIdx < numEvents; eventIdx++) {
-        currentEvent = schedule[eventIdx];
-        // ctime returns \n in formatted time at position second to last pos
-        formattedTime = ctime(&(currentEvent)->nextTime);
-        formattedTime[24] = '\0';
-        printf("%s For %d Minutes - %s : %s\n",
-                formattedTime, (currentEvent)->durationInMin,
-                (currentEvent)->task, (currentEvent)->reminderMessage);
-	}
+/**
+ * Display the next occurrences across all entries.
+ */
+void displayUpcomingEvents(scheduleContext * ctx, FILE * out, int maxEvents) {
+    eventEntry * events;
+    int numEvents, eventIdx;
+
+    events = malloc(sizeof(eventEntry) * maxEvents);
+    assert(events != NULL);
+    numEvents = getUpcomingEvents(ctx, getCurrentTime(ctx), events, maxEvents);
+    for (eventIdx = 0; eventIdx < numEvents; eventIdx++) {
+        displayAgendaEvent(&events[eventIdx], out);
+    }
 	fflush(out);
-    freeEventSchedule(schedule, numEvents);
+    free(events);
+}
+
+/**
+ * Agenda callback used to display an event.  userData is the output file.
+ */
+Bool displayAgendaEvent(eventEntry * event, void * userData) {
+    char formattedTime[26];
+
+    // ctime returns \n in formatted time at position second to last pos
+    ctime_r(&event->nextTime, formattedTime);
+    formattedTime[24] = '\0';
+    fprintf((FILE *)userData, "%s For %d Minutes - %s : %s\n",
+            formattedTime, event->durationInMin,
+            event->task, event->reminderMessage);
+    return True;
 }
 
 /**
  * Create a new action set and populate with the provided action.
  */
 actionNode * createActionSet(actionDef * action) {
+    return allocActionNode(NULL, action);
+}
+
+actionNode * createScheduleActionSet(scheduleContext * ctx, 
+        actionDef * action) {
+    return allocActionNode(currentArena(ctx), action);
+}
+
+/**
+ * Allocate a node holding the action from the arena, or the heap if arena
+ * is NULL.
+ */
+actionNode * allocActionNode(scheduleArena * arena, actionDef * action) {
 	actionNode * newNode;
 
-	newNode = (actionNode*)malloc(sizeof(actionNode));
-	assert(newNode != NULL);
+	newNode = (actionNode*)arenaAlloc(arena, sizeof(actionNode));
 	memset(newNode, 0, sizeof(actionNode));
 
     newNode->action = action;
+    newNode->arena = arena;
     
     return newNode;
 }
 
-/**
- * Create a command 
- */
 actionDef * createActionCommand(char * commandName, char * commandStr, 
         enum ActionType type) {
+    return createArenaAction(NULL, commandName, commandStr, type);
+}
+
+actionDef * createPrivateAction(scheduleContext * ctx, char * commandStr) {
+    return createArenaAction(currentArena(ctx), "private", commandStr, 
+            PRIVATE);
+}
+
+/**
+ * Create a command and compile it into segments, allocated from the arena 
+ * or the heap if arena is NULL.  Commands longer than MAX_CMD_LEN are 
+ * truncated.
+ */
+actionDef * createArenaAction(scheduleArena * arena, char * commandName, 
+        char * commandStr, enum ActionType type) {
     actionDef * action;
-    int fieldLen;
 
-	action = (actionDef*)malloc(sizeof(actionDef));
-	assert(action != NULL);
+	action = (actionDef*)arenaAlloc(arena, sizeof(actionDef));
 	memset(action, 0, sizeof(actionDef));
+    action->arena = arena;
+    retainArena(arena);
 
-    action->name = strdup(commandName);
-
-    fieldLen = strnlen(commandStr, MAX_CMD_LEN) + 1;
-	action->command = (char*) malloc( sizeof(char) * fieldLen);
-	strncpy(action->command, commandStr, fieldLen);
+    action->name = arenaStrdup(arena, commandName);
+    action->command = arenaStrndup(arena, commandStr, MAX_CMD_LEN);
 
     action->type = type;
+    compileActionCommand(arena, action);
 
     return action;
 }
 
-
 /**
- * Find an existing action command for the provided name.
+ * Split the command into arguments, each made up of text and placeholder 
+ * segments.  A command starting with ! is a single argument for the shell,
+ * so quotes, escapes and white space are kept as is.
  */
-actionDef * findActionCommand(char * commandName) {
-	actionNode * current = cmdHead;
-	while (current != NULL) {
-        if (strcmp(current->action->name, commandName) == 0 ) {
-            return current->action;
-        }
-		current = current->next;
-	}
+void compileActionCommand(scheduleArena * arena, actionDef * action) {
+    static const struct {
+        const char * name;
+        enum SegmentType type;
+    } placeholders[] = {
+        {"%s", SEG_MESSAGE},
+        {"%{message}", SEG_MESSAGE},
+        {"%{task}", SEG_TASK},
+        {"%{time}", SEG_TIME},
+        {"%{duration}", SEG_DURATION}
+    };
+    const int numPlaceholders = sizeof(placeholders) / sizeof(placeholders[0]);
+    commandArg ** argTail = &action->args, * arg = NULL;
+    commandSegment ** tail = NULL, * text = NULL;
+    const char * current = action->command;
+    char quote = '\0';
+    int idx, nameLen = 0;
+
+    action->useShell = current[0] == '!';
+    if (action->useShell) {
+        for (current++; *current == ' ' || *current == '\t'; current++);
+    }
 
-    return NULL;
-}
+    for (; *current != '\0'; current++) {
+        if (!action->useShell && quote == '\0' 
+                && (*current == ' ' || *current == '\t')) {
+            arg = NULL;
+            continue;
+        }
 
+        if (arg == NULL) {
+            arg = (commandArg*)arenaAlloc(arena, sizeof(commandArg));
+            memset(arg, 0, sizeof(commandArg));
+            *argTail = arg;
+            argTail = &arg->next;
+            tail = &arg->segments;
+            text = NULL;
+            action->argCount++;
+        }
 
-/**
- * Add an action to a provided set of actions.
- */
-void addActionToActionSet(actionNode * node, actionDef * action) {
-    actionNode * newNode;
-    actionNode * currentNode = node;
+        if (!action->useShell && quote != '\'' && *current == '\\' 
+                && current[1] != '\0') {
+            current++;
+        }
+        else if (!action->useShell && quote == '\0' 
+                && (*current == '\'' || *current == '"')) {
+            quote = *current;
+            continue;
+        }
+        else if (!action->useShell && *current == quote) {
+            quote = '\0';
+            continue;
+        }
+        else if (*current == '%' && quote != '\'') {
+            for (idx = 0; idx < numPlaceholders; idx++) {
+                nameLen = strlen(placeholders[idx].name);
+                if (strncmp(current, placeholders[idx].name, nameLen) == 0) {
+                    break;
+                }
+            }
+            if (idx < numPlaceholders) {
+                addCommandSegment(arena, tail, placeholders[idx].type);
+                tail = &(*tail)->next;
+                action->timeDependent |= placeholders[idx].type == SEG_TIME;
+                current += nameLen - 1;
+                text = NULL;
+                continue;
+            }
+            // %% is a single percent.
+            current += current[1] == '%' ? 1 : 0;
+        }
 
-    assert(node != NULL);
-    while (currentNode->next != NULL) {
-        currentNode = currentNode->next;
+        // Extend the current text segment.
+        if (text == NULL) {
+            text = addCommandSegment(arena, tail, SEG_TEXT);
+            text->text = arenaAlloc(arena, strlen(current) + 1);
+            tail = &text->next;
+        }
+        text->text[text->textLen++] = *current;
+        text->text[text->textLen] = '\0';
     }
-
-	newNode = (actionNode*)malloc(sizeof(actionNode));
-	assert(newNode != NULL);
-	memset(newNode, 0, sizeof(actionNode));
-
-    newNode->action = action;
-    currentNode->next = newNode;
 }
 
 /**
- * Add a command string to the current list of reminder commands.
+ * Append a new segment at the tail of the segment list.
  */
-void addActionCommand(char * commandName, char * commandStr, 
-        enum ActionType type) {
-    actionDef * action;
-	actionNode * newNode;
-    int fieldLen;
-
-	action = (actionDef*)malloc(sizeof(actionDef));
-	assert(action != NULL);
-	memset(action, 0, sizeof(actionDef));
-
-	newNode = (actionNode*)malloc(sizeof(actionNode));
-	assert(newNode != NULL);
-	memset(newNode, 0, sizeof(actionNode));
-
-    action->name = strdup(commandName);
-
-    fieldLen = strnlen(commandStr, MAX_CMD_LEN) + 1;
-	action->command = (char*) malloc( sizeof(char) * fieldLen);
-	strncpy(action->command, commandStr, fieldLen);
-
-    action->type = type;
+commandSegment * addCommandSegment(scheduleArena * arena, 
+        commandSegment ** tail, enum SegmentType type) {
+    commandSegment * segment;
+
+	segment = (commandSegment*)arenaAlloc(arena, sizeof(commandSegment));
+	memset(segment, 0, sizeof(commandSegment));
+    segment->type = type;
+    *tail = segment;
+    return segment;
+}
 
-    newNode->action = action;
+void freeCommandArgs(commandArg * arg) {
+    commandArg * nextArg;
+    commandSegment * segment, * next;
 
-	if (cmdTail != NULL) {
-		cmdTail->next = newNode;
-		cmdTail = newNode;
-	}
-	else {
-		cmdHead = cmdTail = newNode;
-	}
+    for (; arg != NULL; arg = nextArg) {
+        nextArg = arg->next;
+        for (segment = arg->segments; segment != NULL; segment = next) {
+            next = segment->next;
+            free(segment->text);
+            free(segment);
+        }
+        free(arg);
+    }
 }
 
 /**
- * Fork off the process and spawn the provided command using
- * the system(3) call.
- * @cmd Fully qualified command string to pass to system().
+ * Return the value of the segment for the entry.  Numeric values are 
+ * formatted into the buffer.
  */
-void spawnCommand(char *cmd) {
-    int childPid = fork();
-    if (childPid == 0) {
-        // execv(cmd, (char*)0);
-        system(cmd);
-        _exit(1);
+const char * segmentValue(commandSegment * segment, scheduleEntry * entry,
+        time_t scheduledTime, char * buffer, int bufferLen, int * valueLen) {
+    struct tm scheduled;
+    const char * value = buffer;
+
+    switch (segment->type) {
+        case SEG_TEXT:
+            *valueLen = segment->textLen;
+            return segment->text;
+        case SEG_MESSAGE:
+            value = entry->reminderMessage;
+            break;
+        case SEG_TASK:
+            value = entry->task;
+            break;
+        case SEG_TIME:
+            localtime_r(&scheduledTime, &scheduled);
+            strftime(buffer, bufferLen, "%H:%M", &scheduled);
+            break;
+        case SEG_DURATION:
+            snprintf(buffer, bufferLen, "%d", entry->durationInMin);
+            break;
     }
+    *valueLen = strlen(value);
+    return value;
 }
 
 /**
- * Execute all action commands for the current entry.  If the entry 
- * has specific commands, then these will be executed in order.  If not,
- * them all default commands will be executed in order. After all commands
- * are executed, all commands with the ALWAYS action type will be executed
- * in order.  
+ * The argument pointers are followed by the strings within one allocation.  
+ * The allocation is sized exactly before any value is copied.
  */
-void execActionCommand(scheduleEntry * entry) {
-	char execBuffer[1024];
-    memset(execBuffer, 0, sizeof(execBuffer));
-    if (entry->actionSet != NULL) {
-        actionNode * current = entry->actionSet;
-        while (current != NULL) {
-            sprintf(execBuffer, current->action->command, 
-                    entry->reminderMessage);
-            #ifdef DEBUG
-            puts(execBuffer);
-            #endif
-            spawnCommand(execBuffer);
-            current = current->next;
+char ** renderActionArgs(actionDef * action, scheduleEntry * entry, 
+        time_t scheduledTime) {
+    static char * shellArgs[] = {"/bin/sh", "-c"};
+    commandArg * arg;
+    commandSegment * segment;
+    char buffer[32], ** argv, * next;
+    const char * value;
+    int valueLen, argIdx = 0, numArgs = action->argCount;
+    size_t size;
+
+    numArgs += action->useShell ? 2 : 0;
+    size = sizeof(char *) * (numArgs + 1);
+    if (action->useShell) {
+        size += strlen(shellArgs[0]) + strlen(shellArgs[1]) + 2;
+    }
+    for (arg = action->args; arg != NULL; arg = arg->next) {
+        for (segment = arg->segments; segment != NULL; 
+                segment = segment->next) {
+            segmentValue(segment, entry, scheduledTime, buffer, 
+                    sizeof(buffer), &valueLen);
+            size += valueLen;
         }
+        size++;
     }
-    else {
-        actionNode * current = cmdHead;
-        while (current != NULL) {
-            if (current->action->type == DEFAULT) {
-                sprintf(execBuffer, current->action->command, 
-                        entry->reminderMessage);
-                spawnCommand(execBuffer);
-            }
-            current = current->next;
+
+    argv = malloc(size);
+    assert(argv != NULL);
+    next = (char *)(argv + numArgs + 1);
+    if (action->useShell) {
+        for (; argIdx < 2; argIdx++) {
+            argv[argIdx] = strcpy(next, shellArgs[argIdx]);
+            next += strlen(next) + 1;
         }
     }
-    // Execute the ALWAYS tasks
-    // TODO If there is an ALWAYS in the specific list, should it be 
-    // executed twice?
-    actionNode * current = cmdHead;
-    while (current != NULL) {
-        if (current->action->type == ALWAYS) {
-            sprintf(execBuffer, current->action->command, 
-                    entry->reminderMessage);
-            spawnCommand(execBuffer);
+    for (arg = action->args; arg != NULL; arg = arg->next) {
+        argv[argIdx++] = next;
+        for (segment = arg->segments; segment != NULL; 
+                segment = segment->next) {
+            value = segmentValue(segment, entry, scheduledTime, buffer, 
+                    sizeof(buffer), &valueLen);
+            memcpy(next, value, valueLen);
+            next += valueLen;
         }
-        current = current->next;
+        *next++ = '\0';
     }
+    argv[argIdx] = NULL;
+    return argv;
 }
 
+void freeRenderedCommands(renderedCommand * rendered) {
+    renderedCommand * next;
+
+    for (; rendered != NULL; rendered = next) {
+        next = rendered->next;
+        free(rendered->argv);
+        free(rendered);
+    }
+}
 
 /**
- * Compare two eventEntry elements and return - int, 0, or + int for 
- * event1 < event2, event1 = event2, or event1 > event2 respectively.
+ * Find an existing action command for the provided name.
  */
-int compareEventTime(const void * event1, const void * event2) {
-    return (*(eventEntry**)event1)->nextTime - (*(eventEntry**)event2)->nextTime;
+actionDef * findActionCommand(scheduleContext * ctx, char * commandName) {
+    actionIndex * index = &ctx->actions;
+    actionDef * action;
+    uint32_t slot;
+
+    if (index->slotCount == 0) {
+        return NULL;
+    }
+    slot = hashActionName(commandName) & (index->slotCount - 1);
+    for (; (action = index->slots[slot]) != NULL; 
+            slot = (slot + 1) & (index->slotCount - 1)) {
+        if (strcmp(action->name, commandName) == 0) {
+            return action;
+        }
+    }
+    return NULL;
 }
 
 /**
- * Returns sorted array of scheduled events based on start and stop times.
- * For repeating events, will return only the next scheduled time from now
- * within the range.  
- * The size of the array will be returned in the out parameter numEvents
- * Returned array should be freed using freeEventSchedule.
+ * FNV-1a hash of the name.
  */
-eventEntry ** getScheduledEvents(time_t startTime, time_t stopTime, 
-        int * numEvents) {
-    eventEntry ** eventList, ** base;
-	time_t schedTimer;
-	scheduleNode * current;
-    int eventCount = 0;
+uint32_t hashActionName(const char * name) {
+    uint64_t hash = FNV_OFFSET_BASIS;
 
-    // Allocate an array of eventEntry * assuming that all tasks will
-    // have an event created for the time period.
-    /* TODO: Wasting resources.  Could start with smaller
-       size and then double until reaching scheduleCount */
-    base = eventList = malloc(sizeof(eventEntry *) * scheduleCount);
-    assert(eventList != NULL);
-    memset(eventList, 0, sizeof(eventEntry *) * scheduleCount);
+    for (; *name != '\0'; name++) {
+        hash ^= (unsigned char)*name;
+        hash *= FNV_PRIME;
+    }
+    return (uint32_t)(hash ^ (hash >> 32));
+}
 
-    // Iterate schedule entries and convert to absolute time based on now.
-    for (current = schedHead;current != NULL; current = current->next) {
-        schedTimer = calcNextTimeForTask(current->entry);
-        if (schedTimer >= startTime && schedTimer <= stopTime) {
-            // Create event entry for scheduled event
-            *eventList = malloc(sizeof(eventEntry));
-            assert(*eventList != NULL);
-            memset(*eventList, 0, sizeof(eventEntry));
-            (*eventList)->nextTime = schedTimer;
-            (*eventList)->durationInMin = current->entry->durationInMin;
-            (*eventList)->task = strdup(current->entry->task);
-            (*eventList)->reminderMessage = strdup(current->entry->reminderMessage);
-            eventCount++;
-            eventList++; // Set up for next entry
+/**
+ * Add the action to the index, doubling the table once it would be more 
+ * than half full.
+ */
+void indexActionCommand(actionIndex * index, actionDef * action) {
+    actionDef ** oldSlots = index->slots;
+    uint32_t oldCount = index->slotCount, slot;
+
+    if ((index->used + 1) * 2 > index->slotCount) {
+        index->slotCount = oldCount > 0 ? oldCount * 2 : MIN_ACTION_SLOTS;
+        index->slots = calloc(index->slotCount, sizeof(actionDef *));
+        assert(index->slots != NULL);
+        index->used = 0;
+        for (slot = 0; slot < oldCount; slot++) {
+            if (oldSlots[slot] != NULL) {
+                placeActionSlot(index, oldSlots[slot]);
+            }
+        }
+        free(oldSlots);
+    }
+    placeActionSlot(index, action);
+
+    if (action->type == DEFAULT) {
+        index->defaults = appendActionList(index->defaults, 
+                &index->defaultCount, action);
+    }
+    else if (action->type == ALWAYS) {
+        index->always = appendActionList(index->always, &index->alwaysCount,
+                action);
+    }
+}
+
+/**
+ * Place the action in the first empty slot of its probe sequence, unless 
+ * an action of the same name is already placed.
+ * Returns:
+ *  True if placed.
+ */
+Bool placeActionSlot(actionIndex * index, actionDef * action) {
+    uint32_t slot = hashActionName(action->name) & (index->slotCount - 1);
+
+    for (; index->slots[slot] != NULL; 
+            slot = (slot + 1) & (index->slotCount - 1)) {
+        if (strcmp(index->slots[slot]->name, action->name) == 0) {
+            return False;
+        }
+    }
+    index->slots[slot] = action;
+    index->used++;
+    return True;
+}
+
+/**
+ * Append the action to the list, growing it to the next power of 2 when 
+ * full.
+ */
+actionDef ** appendActionList(actionDef ** list, int * count, 
+        actionDef * action) {
+    // Full when count is 0 or a power of 2.
+    if ((*count & (*count - 1)) == 0) {
+        list = realloc(list, 
+                sizeof(actionDef *) * (*count > 0 ? *count * 2 : 1));
+        assert(list != NULL);
+    }
+    list[(*count)++] = action;
+    return list;
+}
+
+void rebuildActionIndex(scheduleContext * ctx) {
+    actionNode * cmd;
+
+    freeActionIndex(&ctx->actions);
+    for (cmd = ctx->cmdHead; cmd != NULL; cmd = cmd->next) {
+        indexActionCommand(&ctx->actions, cmd->action);
+    }
+}
+
+void freeActionIndex(actionIndex * index) {
+    free(index->slots);
+    free(index->defaults);
+    free(index->always);
+    memset(index, 0, sizeof(actionIndex));
+}
+
+
+/**
+ * Add an action to a provided set of actions.
+ */
+void addActionToActionSet(actionNode * node, actionDef * action) {
+    actionNode * currentNode = node;
+
+    assert(node != NULL);
+    while (currentNode->next != NULL) {
+        currentNode = currentNode->next;
+    }
+    currentNode->next = allocActionNode(NULL, action);
+}
+
+void addScheduleActionToSet(scheduleContext * ctx, actionNode * node, 
+        actionDef * action) {
+    actionNode * currentNode = node;
+
+    assert(node != NULL);
+    while (currentNode->next != NULL) {
+        currentNode = currentNode->next;
+    }
+    currentNode->next = allocActionNode(currentArena(ctx), action);
+}
+
+/**
+ * Add a command string to the current list of reminder commands.
+ */
+void addActionCommand(scheduleContext * ctx, char * commandName, 
+        char * commandStr, enum ActionType type) {
+	actionNode * newNode;
+    scheduleArena * arena = currentArena(ctx);
+
+    newNode = allocActionNode(arena, 
+            createArenaAction(arena, commandName, commandStr, type));
+
+	if (ctx->cmdTail != NULL) {
+		ctx->cmdTail->next = newNode;
+		ctx->cmdTail = newNode;
+	}
+	else {
+		ctx->cmdHead = ctx->cmdTail = newNode;
+	}
+    indexActionCommand(&ctx->actions, newNode->action);
+}
+
+pid_t spawnArgs(char * const argv[]) {
+    pid_t childPid;
+    int status;
+
+    if (getLauncherFd() >= 0) {
+        return launcherSpawn(argv);
+    }
+    status = spawnProcess(argv, &childPid);
+    if (status != 0) {
+        fprintf(stderr, "Failed to launch %s: %s\n", argv[0], 
+                strerror(status));
+        return -1;
+    }
+    #ifdef DEBUG
+    printf("Launched %d: %s\n", (int)childPid, argv[0]);
+    #endif // DEBUG
+    return childPid;
+}
+
+/**
+ * Launch the program with posix_spawnp rather than fork and exec, so the
+ * parent is not copied.  The event loop may block SIGCHLD, so the child 
+ * starts with an empty signal mask and default signal handling.
+ */
+int spawnProcess(char * const argv[], pid_t * childPid) {
+    extern char **environ;
+    posix_spawnattr_t attr;
+    sigset_t signals;
+    int status;
+
+    posix_spawnattr_init(&attr);
+    sigemptyset(&signals);
+    posix_spawnattr_setsigmask(&attr, &signals);
+    sigaddset(&signals, SIGCHLD);
+    posix_spawnattr_setsigdefault(&attr, &signals);
+    posix_spawnattr_setflags(&attr, 
+            POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+    status = posix_spawnp(childPid, argv[0], NULL, &attr, argv, environ);
+    posix_spawnattr_destroy(&attr);
+    return status;
+}
+
+pid_t spawnCommand(char *cmd) {
+    char *argv[] = {"/bin/sh", "-c", cmd, NULL};
+
+    return spawnArgs(argv);
+}
+
+int reapChildren() {
+    pid_t childPid;
+    int status, reaped = 0;
+
+    if (getLauncherFd() >= 0) {
+        return collectLauncherExits();
+    }
+
+    while ((childPid = waitpid(-1, &status, WNOHANG)) > 0) {
+        #ifdef DEBUG
+        printf("Reaped %d: status %d\n", (int)childPid, status);
+        #endif // DEBUG
+        reaped++;
+    }
+    return reaped;
+}
+
+/**
+ * Execute all action commands for the current entry.  If the entry 
+ * has specific commands, then these will be executed in order.  If not,
+ * them all default commands will be executed in order. After all commands
+ * are executed, all commands with the ALWAYS action type will be executed
+ * in order.  
+ */
+void execActionCommand(scheduleContext * ctx, scheduleEntry * entry, 
+        time_t scheduledTime) {
+    actionIndex * index = &ctx->actions;
+    int idx;
+
+    if (entry->actionSet != NULL) {
+        actionNode * current = entry->actionSet;
+        while (current != NULL) {
+            launchAction(entry, current->action, scheduledTime);
+            current = current->next;
+        }
+    }
+    else {
+        for (idx = 0; idx < index->defaultCount; idx++) {
+            launchAction(entry, index->defaults[idx], scheduledTime);
+        }
+    }
+    // Execute the ALWAYS tasks
+    // TODO If there is an ALWAYS in the specific list, should it be 
+    // executed twice?
+    for (idx = 0; idx < index->alwaysCount; idx++) {
+        launchAction(entry, index->always[idx], scheduledTime);
+    }
+}
+
+/**
+ * Launch the command of the action for the entry.  The rendered command is
+ * kept with the entry unless it depends on the scheduled time.
+ */
+void launchAction(scheduleEntry * entry, actionDef * action, 
+        time_t scheduledTime) {
+    renderedCommand * rendered;
+    char ** argv;
+
+    if (action == NULL || action->argCount == 0) {
+        return;
+    }
+    if (action->timeDependent) {
+        argv = renderActionArgs(action, entry, scheduledTime);
+        spawnArgs(argv);
+        free(argv);
+        return;
+    }
+
+    // Rendered commands are only added, so argv remains valid once unlocked.
+    pthread_mutex_lock(&renderLock);
+    for (rendered = entry->rendered; rendered != NULL 
+            && rendered->action != action; rendered = rendered->next);
+    if (rendered == NULL) {
+        rendered = (renderedCommand*)malloc(sizeof(renderedCommand));
+        assert(rendered != NULL);
+        rendered->action = action;
+        rendered->argv = renderActionArgs(action, entry, scheduledTime);
+        rendered->next = entry->rendered;
+        entry->rendered = rendered;
+    }
+    pthread_mutex_unlock(&renderLock);
+    spawnArgs(rendered->argv);
+}
+
+
+/**
+ * Compare two eventEntry elements and return - int, 0, or + int for 
+ * event1 < event2, event1 = event2, or event1 > event2 respectively.
+ */
+int compareEventTime(const void * event1, const void * event2) {
+    return (*(eventEntry**)event1)->nextTime - (*(eventEntry**)event2)->nextTime;
+}
+
+/**
+ * Returns sorted array of scheduled events based on start and stop times.
+ * For repeating events, will return only the next scheduled time from now
+ * within the range.  
+ * The size of the array will be returned in the out parameter numEvents
+ * Returned array should be freed using freeEventSchedule.
+ */
+eventEntry ** getScheduledEvents(scheduleContext * ctx, time_t startTime, 
+        time_t stopTime, int * numEvents) {
+    eventEntry ** eventList, ** base, * events;
+	time_t schedTimer;
+    entryStore * store;
+    uint32_t id;
+    int eventCount = 0;
+
+    // Allocate an array of eventEntry * assuming that all tasks will
+    // have an event created for the time period, followed by the events.
+    /* TODO: Wasting resources.  Could start with smaller
+       size and then double until reaching scheduleCount */
+    base = eventList = malloc((sizeof(eventEntry *) + sizeof(eventEntry)) 
+            * ctx->scheduleCount);
+    assert(eventList != NULL);
+    memset(eventList, 0, sizeof(eventEntry *) * ctx->scheduleCount);
+    events = (eventEntry *)(eventList + ctx->scheduleCount);
+
+    // Scan the next times of all entries based on now.  Only the entries
+    // within the range are read.
+    store = scanNextTimes(ctx, getCurrentTime(ctx));
+    for (id = 0; id < store->count; id++) {
+        schedTimer = store->nextTimes[id];
+        if ((store->flags[id] & ENTRY_LIVE) 
+                && schedTimer >= startTime && schedTimer <= stopTime) {
+            // Create event entry for scheduled event
+            *eventList = &events[eventCount];
+            setEventEntry(*eventList, store->entries[id], schedTimer);
+            eventCount++;
+            eventList++; // Set up for next entry
         }
     }
     eventList = base; 
@@ -690,28 +1418,248 @@ eventEntry ** getScheduledEvents(time_t startTime, time_t stopTime,
     return eventList;
 }
 
-void freeEventEntry(eventEntry * entry) {
-    free(entry->task);
-    free(entry->reminderMessage);
-    free(entry);
+/**
+ * Open a stream of all occurrences of all entries within the window.  The 
+ * heap holds each iterator that has a pending occurrence.
+ */
+agendaStream * openAgenda(scheduleContext * ctx, time_t startTime, 
+        time_t stopTime) {
+    agendaStream * agenda;
+    scheduleNode * current;
+    time_t occurrence;
+    int iterIdx;
+
+    agenda = malloc(sizeof(agendaStream));
+    assert(agenda != NULL);
+    memset(agenda, 0, sizeof(agendaStream));
+    agenda->iters = malloc(sizeof(occurrenceIter) * (ctx->scheduleCount + 1));
+    assert(agenda->iters != NULL);
+    agenda->heap = malloc(sizeof(occurrenceIter *) * (ctx->scheduleCount + 1));
+    assert(agenda->heap != NULL);
+
+    for (current = ctx->schedHead, iterIdx = 0; current != NULL; 
+            current = current->next, iterIdx++) {
+        initOccurrenceIter(&agenda->iters[iterIdx], current->entry, 
+                startTime, stopTime);
+        if (nextOccurrence(&agenda->iters[iterIdx], &occurrence)) {
+            agenda->heap[agenda->heapCount++] = &agenda->iters[iterIdx];
+        }
+    }
+    for (iterIdx = agenda->heapCount / 2 - 1; iterIdx >= 0; iterIdx--) {
+        siftDownAgenda(agenda, iterIdx);
+    }
+    return agenda;
 }
 
-void freeEventSchedule(eventEntry ** schedule, int numEvents) {
-    int eventIdx;
-    for( eventIdx=0; eventIdx < numEvents; eventIdx++) {
-        if (schedule[eventIdx] != NULL) {
-            freeEventEntry(schedule[eventIdx]);
+/**
+ * Fill the buffer with the next events from the stream.  The earliest 
+ * iterator is advanced after each event and moved to its new position.
+ */
+int readAgenda(agendaStream * agenda, eventEntry * events, int maxEvents) {
+    occurrenceIter * iter;
+    time_t occurrence;
+    int numEvents = 0;
+
+    while (numEvents < maxEvents && agenda->heapCount > 0) {
+        iter = agenda->heap[0];
+        setEventEntry(&events[numEvents], iter->entry, iter->lastTime);
+        numEvents++;
+
+        if (nextOccurrence(iter, &occurrence) == False) {
+            agenda->heap[0] = agenda->heap[--agenda->heapCount];
+        }
+        if (agenda->heapCount > 0) {
+            siftDownAgenda(agenda, 0);
+        }
+    }
+    return numEvents;
+}
+
+void closeAgenda(agendaStream * agenda) {
+    free(agenda->iters);
+    free(agenda->heap);
+    free(agenda);
+}
+
+/**
+ * Invoke the callback for each event within the window.  Events are read
+ * from an agenda stream into a fixed size buffer.
+ */
+void generateAgenda(scheduleContext * ctx, time_t startTime, time_t stopTime, 
+        agendaCallback callback, void * userData) {
+    eventEntry events[AGENDA_BUFFER_SIZE];
+    agendaStream * agenda;
+    int numEvents, eventIdx;
+    Bool more = True;
+
+    agenda = openAgenda(ctx, startTime, stopTime);
+    while (more 
+            && (numEvents = readAgenda(agenda, events, AGENDA_BUFFER_SIZE)) > 0) {
+        for (eventIdx = 0; more && eventIdx < numEvents; eventIdx++) {
+            more = callback(&events[eventIdx], userData);
+        }
+    }
+    closeAgenda(agenda);
+}
+
+/**
+ * Find the first maxEvents occurrences across all entries.  The best 
+ * occurrences found so far are kept in a max-heap bounded to maxEvents, so 
+ * the root is the latest one that would currently be returned.  Occurrences
+ * of an entry are generated in time order and generation of that entry stops
+ * at the first one that is not earlier than the root of a full heap.
+ */
+int getUpcomingEvents(scheduleContext * ctx, time_t currentTime, 
+        eventEntry * events, int maxEvents) {
+    upcomingEvent * heap, candidate, latest;
+    occurrenceIter iter;
+    scheduleNode * current;
+    int heapCount = 0, entryIdx = 0, eventIdx;
+
+    if (maxEvents <= 0) {
+        return 0;
+    }
+    heap = malloc(sizeof(upcomingEvent) * maxEvents);
+    assert(heap != NULL);
+
+    for (current = ctx->schedHead; current != NULL; current = current->next) {
+        candidate.entryIdx = entryIdx++;
+        candidate.entry = current->entry;
+        // The current minute has already been activated.
+        initOccurrenceIter(&iter, current->entry, currentTime + 1, 
+                heapCount == maxEvents ? heap[0].nextTime : LONG_MAX);
+        while (nextOccurrence(&iter, &candidate.nextTime)) {
+            if (heapCount < maxEvents) {
+                // Not full.  Add at the bottom and move up.
+                eventIdx = heapCount++;
+                while (eventIdx > 0 
+                        && isLaterUpcoming(&candidate, &heap[(eventIdx - 1) / 2])) {
+                    heap[eventIdx] = heap[(eventIdx - 1) / 2];
+                    eventIdx = (eventIdx - 1) / 2;
+                }
+                heap[eventIdx] = candidate;
+            }
+            else if (isLaterUpcoming(&heap[0], &candidate)) {
+                // Replace the latest
+                heap[0] = candidate;
+                siftDownUpcoming(heap, heapCount, 0);
+            }
+            else {
+                break;
+            }
+        }
+        closeOccurrenceIter(&iter);
+    }
+
+    // Remove the latest until empty, filling the buffer from the end.
+    for (eventIdx = heapCount - 1; eventIdx >= 0; eventIdx--) {
+        latest = heap[0];
+        heap[0] = heap[eventIdx];
+        siftDownUpcoming(heap, eventIdx, 0);
+
+        setEventEntry(&events[eventIdx], latest.entry, latest.nextTime);
+    }
+    free(heap);
+    return heapCount;
+}
+
+/**
+ * Return True if event1 is later than event2.  Events at the same time are
+ * ordered by position within the schedule.
+ */
+Bool isLaterUpcoming(upcomingEvent * event1, upcomingEvent * event2) {
+    if (event1->nextTime != event2->nextTime) {
+        return event1->nextTime > event2->nextTime ? True : False;
+    }
+    return event1->entryIdx > event2->entryIdx ? True : False;
+}
+
+/**
+ * Move the event at idx down the max-heap until neither child is later.
+ */
+void siftDownUpcoming(upcomingEvent * heap, int heapCount, int idx) {
+    upcomingEvent event = heap[idx];
+    int child;
+
+    while ((child = 2 * idx + 1) < heapCount) {
+        if (child + 1 < heapCount 
+                && isLaterUpcoming(&heap[child + 1], &heap[child])) {
+            child++;
+        }
+        if (isLaterUpcoming(&event, &heap[child])) {
+            break;
         }
+        heap[idx] = heap[child];
+        idx = child;
+    }
+    heap[idx] = event;
+}
+
+/**
+ * Return True if the pending occurrence of iter1 is before that of iter2.  
+ * Iterators are allocated in schedule order, so ties are broken by address 
+ * to keep events at the same time in schedule order.
+ */
+Bool isEarlierOccurrence(occurrenceIter * iter1, occurrenceIter * iter2) {
+    if (iter1->lastTime != iter2->lastTime) {
+        return iter1->lastTime < iter2->lastTime ? True : False;
     }
+    return iter1 < iter2 ? True : False;
+}
+
+/**
+ * Move the iterator at idx down the heap until neither child is earlier.
+ */
+void siftDownAgenda(agendaStream * agenda, int idx) {
+    occurrenceIter * iter = agenda->heap[idx];
+    int child;
+
+    while ((child = 2 * idx + 1) < agenda->heapCount) {
+        if (child + 1 < agenda->heapCount 
+                && isEarlierOccurrence(agenda->heap[child + 1], 
+                    agenda->heap[child])) {
+            child++;
+        }
+        if (isEarlierOccurrence(iter, agenda->heap[child])) {
+            break;
+        }
+        agenda->heap[idx] = agenda->heap[child];
+        idx = child;
+    }
+    agenda->heap[idx] = iter;
+}
+
+/**
+ * Set the event to the occurrence of the entry at nextTime.  The text and
+ * action set are borrowed from the entry.
+ */
+void setEventEntry(eventEntry * event, scheduleEntry * entry, 
+        time_t nextTime) {
+    event->nextTime = nextTime;
+    event->durationInMin = entry->durationInMin;
+    event->task = entry->task;
+    event->reminderMessage = entry->reminderMessage;
+    event->taskId = entry->taskId;
+    event->reminderId = entry->reminderId;
+    event->actionSet = entry->actionSet;
+}
+
+/**
+ * The events follow the array of pointers within the same allocation, so 
+ * numEvents is not needed.  Kept so callers are unchanged.
+ */
+void freeEventSchedule(eventEntry ** schedule, int numEvents) {
+    (void)numEvents;
     free(schedule);
 }
 
-void runNotifications() {
+void runNotifications(scheduleContext * ctx) {
     scheduledExec * nextTask;
     
-    nextTask = calcNextTaskAlarm();
+    nextTask = calcNextTaskAlarm(ctx);
     // This will start a event driven loop that will not return.
-    waitForTask(nextTask);
+    waitForTask(ctx, nextTask);
+    stopExecutors();
 }
 
 /**
@@ -720,69 +1668,80 @@ void runNotifications() {
  *
  * Returned value must be freed by caller. 
  */
-scheduledExec * calcNextTaskAlarm() {
-	time_t schedTimer, currentTime, nextTaskTime;
-    // scheduleEntry * nextScheduledEntry = NULL;
-	scheduleNode * nextSchedHead, * nextSchedTail, * listPtr, *listTemp;
-	scheduleNode * current;
-	scheduledExec * nextExec = NULL;
+scheduledExec * calcNextTaskAlarm(scheduleContext * ctx) {
+	time_t currentTime;
+    #ifdef DEBUG
     char *formattedTime;
+    #endif // DEBUG
 
-    nextTaskTime = LONG_MAX;
-    nextSchedHead = nextSchedTail = NULL;
-    currentTime = getCurrentTime();
+    currentTime = getCurrentTime(ctx);
+    if (currentTime < ctx->lastExecTime) {
+        currentTime = ctx->lastExecTime;
+    }
     #ifdef DEBUG
     // ctime returns \n in formatted time at position second to last pos
     formattedTime = ctime(&currentTime);
     formattedTime[24] = '\0';
     printf("Time: %s\n", formattedTime);
     #endif // DEBUG
+
+    if (ctx->dispatchMode == DISPATCH_WHEEL) {
+        return calcNextWheelAlarm(ctx, currentTime);
+    }
+    if (ctx->dispatchMode == DISPATCH_MATCH) {
+        return calcNextMatchAlarm(ctx, currentTime);
+    }
+    return calcNextQueueAlarm(ctx, currentTime);
+}
+
+/**
+ * Return the next alarm using the queue.  Entries with a next time that is 
+ * no longer in the future have been executed, so they are removed, 
+ * recalculated and added back to the queue.  All other entries keep their 
+ * previously calculated time.
+ */
+scheduledExec * calcNextQueueAlarm(scheduleContext * ctx, time_t currentTime) {
+	time_t schedTimer;
+    taskQueueNode * nextNode, firedNode;
+	scheduledExec * nextExec = NULL;
+    calTime start;
+    #ifdef DEBUG
+    char *formattedTime;
+    #endif // DEBUG
+
+    if (ctx->alarmQueue == NULL) {
+        buildTaskAlarmQueue(ctx, currentTime);
+    }
     
-    // Iterate over all tasks and find the task closest to now.
-    for (current = schedHead;current != NULL; current = current->next) {
-        schedTimer = calcNextTimeForTask(current->entry);
+    // Recalculate the entries that have been executed.
+    initSearchStart(currentTime, &start);
+    while ((nextNode = peekTaskQueue(ctx->alarmQueue)) != NULL 
+            && nextNode->nextTime <= currentTime) {
+        popTaskQueue(ctx->alarmQueue, &firedNode);
+        schedTimer = calcNextTimeFromStart(firedNode.entry, &start, currentTime);
 
         #ifdef DEBUG
         // ctime returns \n in formatted time at position second to last pos
         formattedTime = ctime(&schedTimer);
         formattedTime[24] = '\0';
         printf("%s\t%s\tSecs from now: %ld\n",
-            formattedTime, current->entry->task, schedTimer - currentTime);
+            formattedTime, firedNode.entry->task, schedTimer - currentTime);
         #endif // DEBUG
 
         if (schedTimer > currentTime) {
-            if (schedTimer < nextTaskTime) {
-                nextTaskTime = schedTimer;
-
-                if (nextSchedHead != NULL) {
-                    // Replacing current schedule time.  Clear out list
-                    for (listPtr = nextSchedHead; listPtr != NULL;) {
-                        listTemp = listPtr->next;
-                        free(listPtr);
-                        listPtr = listTemp;
-                    }
-                }
-
-                nextSchedHead = nextSchedTail = createScheduleNode();
-                nextSchedHead->entry = current->entry;
-            }
-            else if (schedTimer == nextTaskTime) {
-                // List must already exist, just append new entry
-                nextSchedTail->next = createScheduleNode();
-                nextSchedTail->next->entry = current->entry;
-                nextSchedTail = nextSchedTail->next;
-            }
+            pushTaskQueue(ctx->alarmQueue, schedTimer, firedNode.entry);
         }
     }
-    if (nextSchedHead != NULL) {
+
+    if (nextNode != NULL) {
         #ifdef DEBUG
-        printf("Next Entry: %s\n", nextSchedHead->entry->task);
+        printf("Next Entry: %s\n", nextNode->entry->task);
         #endif // DEBUG
         nextExec = malloc(sizeof(scheduledExec));
         assert(nextExec != NULL);
         memset(nextExec, 0, sizeof(scheduledExec));
-        nextExec->absTime = nextTaskTime;
-        nextExec->taskHead = nextSchedHead;
+        nextExec->absTime = nextNode->nextTime;
+        nextExec->taskHead = peekTaskQueueTies(ctx->alarmQueue);
     }
 
     return nextExec;
@@ -790,14 +1749,304 @@ scheduledExec * calcNextTaskAlarm() {
 }
 
 /**
- * Execute all actions associated with the scheduled task.
+ * Return the next alarm using the timing wheel.  The timers of the previously
+ * returned alarm are recalculated and placed back in the wheel once that 
+ * alarm is no longer in the future.  The next alarm is the bucket of timers
+ * for the earliest minute remaining in the wheel.  Entries of the alarm are
+ * in schedule list order.
  */
-void executeScheduledEntry( scheduledExec * task ) {
+scheduledExec * calcNextWheelAlarm(scheduleContext * ctx, time_t currentTime) {
+	time_t schedTimer;
+    wheelTimer * timer, * next;
+	scheduledExec * nextExec = NULL;
+    scheduleNode * node, * tail = NULL;
+    calTime start;
+    int dueCount = 0;
+
+    if (ctx->alarmWheel == NULL) {
+        buildTaskAlarmWheel(ctx, currentTime);
+    }
+
+    initSearchStart(currentTime, &start);
+    while (ctx->dueTimers == NULL || ctx->dueTime <= currentTime) {
+        for (timer = ctx->dueTimers; timer != NULL; timer = next) {
+            next = timer->next;
+            schedTimer = calcNextTimeFromStart(timer->entry, &start, currentTime);
+            if (schedTimer > currentTime) {
+                rescheduleWheelTimer(ctx->alarmWheel, timer, schedTimer);
+            }
+            else {
+                cancelWheelTimer(ctx->alarmWheel, timer);
+            }
+        }
+        ctx->dueTimers = expireNextWheelBucket(ctx->alarmWheel, &ctx->dueTime);
+        if (ctx->dueTimers == NULL) {
+            return NULL;
+        }
+    }
+
+    nextExec = malloc(sizeof(scheduledExec));
+    assert(nextExec != NULL);
+    memset(nextExec, 0, sizeof(scheduledExec));
+    nextExec->absTime = ctx->dueTime;
+    for (timer = ctx->dueTimers; timer != NULL; timer = timer->next) {
+        node = createScheduleNode();
+        node->entry = timer->entry;
+        if (tail == NULL) {
+            nextExec->taskHead = node;
+        }
+        else {
+            tail->next = node;
+        }
+        tail = node;
+        dueCount++;
+    }
+    // Buckets are in reverse order of insertion.
+    nextExec->taskHead = sortTaskQueueTies(nextExec->taskHead, dueCount);
+    return nextExec;
+}
+
+/**
+ * Return the next alarm by matching each minute after currentTime against 
+ * all entries.  If none of the next MATCH_SEARCH_MINUTES has an alarm, the 
+ * alarm is found from the next times of the entries instead, so a sparse 
+ * schedule is not searched minute by minute.  Next times are also used if
+ * the offset from UTC changes within the minutes searched, as local times 
+ * may then be skipped or repeated.  Entries of the alarm are in schedule 
+ * list order.
+ */
+scheduledExec * calcNextMatchAlarm(scheduleContext * ctx, time_t currentTime) {
+    scheduleEntry ** matches;
+	scheduledExec * nextExec;
+    scheduleNode * node, * tail = NULL;
+    time_t alarmTime;
+    int numMatches = 0, minute, matchIdx;
+
+    if (ctx->scheduleCount == 0) {
+        return NULL;
+    }
+    matches = malloc(sizeof(scheduleEntry *) * ctx->scheduleCount);
+    assert(matches != NULL);
+
+    // The minute containing currentTime has already been activated.
+    alarmTime = (floorDiv(currentTime, SECS_PER_MIN) + 1) * SECS_PER_MIN;
+    if (offsetChangesWithin(alarmTime, 
+            alarmTime + (MATCH_SEARCH_MINUTES - 1) * SECS_PER_MIN) == False) {
+        for (minute = 0; minute < MATCH_SEARCH_MINUTES; minute++) {
+            numMatches = matchEntriesAt(ctx, alarmTime, matches, 
+                    ctx->scheduleCount);
+            if (numMatches > 0) {
+                break;
+            }
+            alarmTime += SECS_PER_MIN;
+        }
+    }
+    if (numMatches == 0) {
+        numMatches = findEarliestEntries(ctx, currentTime, matches, 
+                &alarmTime);
+    }
+    if (numMatches == 0) {
+        free(matches);
+        return NULL;
+    }
+
+    nextExec = malloc(sizeof(scheduledExec));
+    assert(nextExec != NULL);
+    memset(nextExec, 0, sizeof(scheduledExec));
+    nextExec->absTime = alarmTime;
+    for (matchIdx = 0; matchIdx < numMatches; matchIdx++) {
+        node = createScheduleNode();
+        node->entry = matches[matchIdx];
+        if (tail == NULL) {
+            nextExec->taskHead = node;
+        }
+        else {
+            tail->next = node;
+        }
+        tail = node;
+    }
+    free(matches);
+    // Matches are in entry store order.  IDs are reused after a reload.
+    nextExec->taskHead = sortTaskQueueTies(nextExec->taskHead, numMatches);
+    return nextExec;
+}
+
+/**
+ * Returns:
+ *  True if the offset from UTC is not the same for the entire local day of
+ *  any time from startTime through stopTime.
+ */
+Bool offsetChangesWithin(time_t startTime, time_t stopTime) {
+    calTime cal;
+    long day, stopDay;
+
+    timeToCalTime(startTime, &cal);
+    day = daysFromCivil(cal.year, cal.mon, cal.mday);
+    timeToCalTime(stopTime, &cal);
+    stopDay = daysFromCivil(cal.year, cal.mon, cal.mday);
+    for (; day <= stopDay; day++) {
+        if (lookupUtcOffset(day)->state == OFFSET_CHANGES) {
+            return True;
+        }
+    }
+    return False;
+}
+
+/**
+ * Find the entries sharing the earliest next time relative to currentTime.
+ * The next times of the store are read twice: to find the earliest time and
+ * then the entries at that time.  Entries are placed in matches in entry
+ * store order.
+ * Returns:
+ *  Number of entries found.  earliest is set to their time.
+ */
+int findEarliestEntries(scheduleContext * ctx, time_t currentTime, 
+        scheduleEntry ** matches, time_t * earliest) {
+    entryStore * store;
+    uint32_t id;
+    int numMatches = 0;
+
+    store = scanNextTimes(ctx, currentTime);
+    *earliest = TIME_IN_PAST;
+    for (id = 0; id < store->count; id++) {
+        if ((store->flags[id] & ENTRY_LIVE) 
+                && store->nextTimes[id] != TIME_IN_PAST
+                && (*earliest == TIME_IN_PAST 
+                    || store->nextTimes[id] < *earliest)) {
+            *earliest = store->nextTimes[id];
+        }
+    }
+    if (*earliest == TIME_IN_PAST) {
+        return 0;
+    }
+    for (id = 0; id < store->count; id++) {
+        if ((store->flags[id] & ENTRY_LIVE) 
+                && store->nextTimes[id] == *earliest) {
+            matches[numMatches++] = store->entries[id];
+        }
+    }
+    return numMatches;
+}
+
+/**
+ * Create the alarm wheel and add every schedule entry with a future time.
+ */
+void buildTaskAlarmWheel(scheduleContext * ctx, time_t currentTime) {
+    entryStore * store;
+    uint32_t id;
+
+    ctx->alarmWheel = createTimingWheel(currentTime);
+    store = scanNextTimes(ctx, currentTime);
+    for (id = 0; id < store->count; id++) {
+        if ((store->flags[id] & ENTRY_LIVE) 
+                && store->nextTimes[id] != TIME_IN_PAST) {
+            insertWheelTimer(ctx->alarmWheel, store->nextTimes[id], 
+                    store->entries[id]);
+        }
+    }
+}
+
+/**
+ * Create the alarm queue and add every schedule entry with a future time.
+ */
+void buildTaskAlarmQueue(scheduleContext * ctx, time_t currentTime) {
+    entryStore * store;
+    uint32_t id;
+
+    ctx->alarmQueue = createTaskQueue(ctx->scheduleCount);
+    store = scanNextTimes(ctx, currentTime);
+    for (id = 0; id < store->count; id++) {
+        if ((store->flags[id] & ENTRY_LIVE) 
+                && store->nextTimes[id] != TIME_IN_PAST) {
+            pushTaskQueue(ctx->alarmQueue, store->nextTimes[id], 
+                    store->entries[id]);
+        }
+    }
+}
+
+/**
+ * Match the bits of the local minute holding time against the entry store,
+ * a buffer of IDs at a time.  Entries limited to certain years are checked
+ * against their year once matched.
+ */
+int matchEntriesAt(scheduleContext * ctx, time_t time, 
+        scheduleEntry ** matches, int maxMatches) {
+    uint32_t ids[MATCH_BUFFER_SIZE], startId = 0, numIds, idIdx, id;
+    entryStore * store = ctx->store;
+    calendarMask bits;
+    calTime cal;
+    int numMatches = 0;
+
+    if (store == NULL || maxMatches <= 0) {
+        return 0;
+    }
+    timeToCalTime(time, &cal);
+    bits.minute = 1ULL << cal.min;
+    bits.hour = 1U << cal.hour;
+    bits.dayOfMonth = 1U << cal.mday;
+    bits.monOfYear = 1U << cal.mon;
+    bits.dayOfWeek = 1U << weekdayFromDays(
+            daysFromCivil(cal.year, cal.mon, cal.mday));
+
+    do {
+        numIds = matchStoreEntries(store, &bits, startId, ids, 
+                MATCH_BUFFER_SIZE);
+        for (idIdx = 0; idIdx < numIds && numMatches < maxMatches; idIdx++) {
+            id = ids[idIdx];
+            if ((store->flags[id] & ENTRY_ANY_YEAR) 
+                    || compareCurrentToSchedule(cal.year, 
+                        store->years[id]) == 0) {
+                matches[numMatches++] = store->entries[id];
+            }
+        }
+        startId = numIds > 0 ? ids[numIds - 1] + 1 : 0;
+    } while (numIds == MATCH_BUFFER_SIZE && numMatches < maxMatches);
+    return numMatches;
+}
+
+/**
+ * Discard the alarm queue.  It will be rebuilt on the next call to 
+ * calcNextTaskAlarm.
+ */
+void resetTaskAlarmQueue(scheduleContext * ctx) {
+    freeTaskQueue(ctx->alarmQueue);
+    ctx->alarmQueue = NULL;
+    freeTimingWheel(ctx->alarmWheel);
+    ctx->alarmWheel = NULL;
+    freeWheelTimers(ctx->dueTimers);
+    ctx->dueTimers = NULL;
+    ctx->lastExecTime = 0;
+    // The time zone may have changed along with the clock.
+    tzset();
+    resetUtcOffsetCache();
+    clearStoreTimes(ctx->store);
+}
+
+void setDispatchMode(scheduleContext * ctx, enum DispatchMode mode) {
+    resetTaskAlarmQueue(ctx);
+    ctx->dispatchMode = mode;
+}
+
+/**
+ * Execute all actions associated with the scheduled task.  If executors are
+ * running, the entries are handed to them and the actions run on their
+ * threads.  An entry the executors have no room for is run inline, so a 
+ * due reminder is never dropped.
+ */
+void executeScheduledEntry(scheduleContext * ctx, scheduledExec * task ) {
     scheduleNode *current;
+    Bool useExecutors = getExecutorCount() > 0;
 
+    ctx->lastExecTime = task->absTime;
     // Execute reminder using entry for which the sleep was entered.
     for (current = task->taskHead; current != NULL; current = current->next) {
-        execActionCommand(current->entry);
+        if (useExecutors == False) {
+            execActionCommand(ctx, current->entry, task->absTime);
+        }
+        else if (dispatchFire(ctx, current->entry, task->absTime) == False) {
+            // Executors are behind.  Run it here rather than drop it.
+            execActionCommand(ctx, current->entry, task->absTime);
+        }
     }
     freeScheduleNodeList(task->taskHead);
     // free(task);
@@ -831,474 +2080,569 @@ int setTaskAlarm(time_t timeToSleep) {
 */
 
 /**
- * Increment the year if mutable.  If not, return ERROR
+ * Return the number of days in the month for the given year.
  */
-int rollYear(scheduleEntry * entry, struct tm * scheduled) {
-    unsigned int newYear;
-    int calComp;
-    switch (entry->year.type) {
-    case SINGLE:
-        // Unable to modify year
-        return ERROR;
-        
-    case RANGE:
-    case LIST:
-        newYear = scheduled->tm_year + 1;
-        calComp = 
-            compareCurrentToSchedule(newYear + 1900, &entry->year);
-        if (calComp < 0) {
-            // In the past, can't roll
-            return ERROR;
-        } 
-        else {
-            scheduled->tm_year = newYear + calComp;
-            initValues(entry, scheduled, CI_MOY);
-        }
-        break;
+int daysInMonth(int year, int month) {
+    if ((year % 400 == 0) || (year % 4 == 0 && year % 100 != 0)) {
+        return monthDaysLeap[month];
+    } 
+    else {
+        return monthDaysNorm[month];
+    }
+}
+
+/**
+ * Returns the next time that the provided entry should be activated.
+ * If in the past, TIME_IN_PAST, a negative value wil be returned.
+ */
+time_t calcNextTimeForTask(scheduleContext * ctx, scheduleEntry *entry) {
+    return calcNextTimeForTaskFrom(entry, getCurrentTime(ctx));
+}
+
+/**
+ * Returns the first time after the minute containing currentTime that the 
+ * provided entry should be activated or TIME_IN_PAST if there is none.
+ */
+time_t calcNextTimeForTaskFrom(scheduleEntry *entry, time_t currentTime) {
+    calTime start;
+
+    initSearchStart(currentTime, &start);
+    return calcNextTimeFromStart(entry, &start, currentTime);
+}
+
+/**
+ * Calculate the next time for each of the entries relative to the current
+ * time.  See calcNextTimesForTasksFrom.
+ */
+void calcNextTimesForTasks(scheduleContext * ctx, scheduleEntry ** entries,
+        int numEntries, time_t * nextTimes) {
+    calcNextTimesForTasksFrom(entries, numEntries, getCurrentTime(ctx), 
+            nextTimes);
+}
 
-    case WILDCARD:
-        scheduled->tm_year++;
-        initValues(entry, scheduled, CI_MOY);
-        break;
+/**
+ * Calculate the next time for each of the entries relative to the provided
+ * time.  The time is converted to calendar time once for all entries.
+ */
+void calcNextTimesForTasksFrom(scheduleEntry ** entries, int numEntries, 
+        time_t currentTime, time_t * nextTimes) {
+    calTime start;
+    int entryIdx;
+
+    initSearchStart(currentTime, &start);
+    for (entryIdx = 0; entryIdx < numEntries; entryIdx++) {
+        nextTimes[entryIdx] = 
+            calcNextTimeFromStart(entries[entryIdx], &start, currentTime);
     }
-    return SUCCESS;
 }
+
 /**
- * Increment the month if mutable.  If not, the attempt incrementing 
- * coarser grained calendar variables.  If date could not be incremented,
- * return ERROR.
- */
-int rollMonth(scheduleEntry * entry, struct tm * scheduled) {
-    unsigned int newMonth;
-    int calComp;
-    switch (entry->monOfYear.type) {
-    case SINGLE:
-        // Unable to modify month
-        return rollYear(entry, scheduled);
-        
-    case RANGE:
-    case LIST:
-        newMonth = scheduled->tm_mon + 1;
-        calComp = 
-            compareCurrentToSchedule(newMonth, &entry->monOfYear);
-        if (calComp < 0) {
-            return rollYear(entry, scheduled);
-        } 
-        else {
-            scheduled->tm_mon = newMonth + calComp;
-            initValues(entry, scheduled, CI_DOM);
-        }
-        break;
+ * Initialize the iterator to return each occurrence of the entry from 
+ * startTime through stopTime inclusive. 
+ */
+void initOccurrenceIter(occurrenceIter * iter, scheduleEntry * entry,
+        time_t startTime, time_t stopTime) {
+    memset(iter, 0, sizeof(occurrenceIter));
+    iter->entry = entry;
+    iter->stopTime = stopTime;
+    iter->lastTime = startTime - 1;
+    // Start with the first whole minute at or after startTime
+    initSearchStart(iter->lastTime, &iter->next);
+    iter->done = startTime > stopTime ? True : False;
+}
+
+/**
+ * Return the next occurrence within the window.  Each call resumes the 
+ * search from the local minute after the previous occurrence, as 
+ * calcNextTaskAlarm does from the time an alarm ran.  The local minutes 
+ * skipped by a DST change all map to the first minute after it, so they 
+ * produce a single occurrence there.
+ * Returns:
+ *  True  if an occurrence was found.  occurrence is set to its time.
+ *  False if there are no more occurrences within the window.
+ */
+Bool nextOccurrence(occurrenceIter * iter, time_t * occurrence) {
+    time_t nextTime;
 
-    case WILDCARD:
-        if (scheduled->tm_mon + 1 < 12) {
-            scheduled->tm_mon++;
-            initValues(entry, scheduled, CI_DOM);
+    while (iter->done == False) {
+        if (findNextScheduledTime(iter->entry, &iter->next) == ERROR) {
+            iter->done = True;
+            break;
+        }
+        nextTime = calTimeToTime(&iter->next, iter->lastTime);
+        if (nextTime > iter->stopTime) {
+            iter->done = True;
+        }
+        else if (nextTime > iter->lastTime) {
+            iter->lastTime = nextTime;
+            initSearchStart(nextTime, &iter->next);
+            *occurrence = nextTime;
+            return True;
         }
         else {
-            // Would cause change in year.  If year is wildcard, update year
-            // and that will init the month
-            return rollYear(entry, scheduled);
+            iter->next.min++;
         }
     }
-    return SUCCESS;
+    return False;
 }
+
 /**
- * Increment the day of month, if mutable, by the number of days provided.  
- * This may be constrained by the Day of Week setting. 
- * If not, then attempt incrementing coarser grained calendar variables.  
- * If date could not be incremented, return ERROR.
- *
- * Assumptions: both scheduled tm_wday and tm_mday are set 
- */
-int rollDayOfMonth(scheduleEntry * entry, struct tm * scheduled) {
-    unsigned int newDay, daysInSchedMonth, numDays;
-    int calComp;
-
-    switch (entry->dayOfMonth.type) {
-    case SINGLE:
-        // Unable to modify day of month
-        return rollMonth(entry, scheduled);
-        
-    case RANGE:
-    case LIST:
-        newDay = scheduled->tm_mday + 1; 
-        daysInSchedMonth = daysInMonth(scheduled->tm_year, scheduled->tm_mon);
-        if (newDay > daysInSchedMonth) {
-            return rollMonth(entry, scheduled);
-        }
-
-        calComp = compareCurrentToSchedule(newDay, &entry->dayOfMonth);
-        if (calComp < 0) {
-            return rollMonth(entry, scheduled);
-        } 
-        else {
-            scheduled->tm_mday = newDay + calComp;
-        }
-        break;
+ * Release the iterator.  No further occurrences will be returned.
+ */
+void closeOccurrenceIter(occurrenceIter * iter) {
+    iter->done = True;
+    iter->entry = NULL;
+}
 
-    case WILDCARD:
+/**
+ * Set the calendar time from which to search for the next time of entries
+ * relative to currentTime.  The minute containing currentTime has already 
+ * been activated, so the search starts at the next minute.  Overflow is 
+ * handled by findNextScheduledTime.
+ */
+void initSearchStart(time_t currentTime, calTime *start) {
+    timeToCalTime(currentTime, start);
+    start->min++;
+}
 
-        // Day of Week processing.  Can be specified only if Day of Mon is wild
-        switch (entry->dayOfWeek.type) {
-        case SINGLE:
-            numDays = 7;
-            break;
-        case RANGE:
-        case LIST:
-            newDay = scheduled->tm_wday + 1; 
-            calComp = compareCurrentToSchedule(newDay, &entry->dayOfWeek);
-            numDays = (7 + calComp + 1) % 7; 
-            break;
-        case WILDCARD:
-            numDays = 1;  // Default number of days to add.
-            break;
-        } // Day of Week processing complete.
-        
-        daysInSchedMonth = daysInMonth(scheduled->tm_year, scheduled->tm_mon);
+/**
+ * Returns the next time for the entry searching from the provided start or
+ * TIME_IN_PAST if there is none.  The start is not modified.
+ */
+time_t calcNextTimeFromStart(scheduleEntry *entry, calTime *start, 
+        time_t currentTime) {
+    calTime next = *start;
 
-        newDay = scheduled->tm_mday + numDays;
-        if (newDay > daysInSchedMonth) {
-            return rollMonth(entry, scheduled);
+    if (findNextScheduledTime(entry, &next) == ERROR) {
+        return TIME_IN_PAST;
+    }
+    return calTimeToTime(&next, currentTime);
+}
+
+/**
+ * Bring the next time of every stored entry up to date relative to 
+ * currentTime, creating the store if the schedule has none.  The hot 
+ * arrays are read from start to end.  The year of an entry is only read if
+ * it is not a wildcard.  A cached time is kept if it was calculated from a 
+ * time no later than currentTime and is after the minute containing 
+ * currentTime, or there was no time.
+ * Returns:
+ *  The store, with nextTimes valid for each live ID.
+ */
+entryStore * scanNextTimes(scheduleContext * ctx, time_t currentTime) {
+    entryStore * store;
+    calendarMask compiled;
+    calTime start, next;
+    time_t nextTime;
+    long minute = floorDiv(currentTime, SECS_PER_MIN);
+    uint32_t id;
+    Bool reuse;
+
+    if (ctx->store == NULL) {
+        ctx->store = createEntryStore();
+    }
+    store = ctx->store;
+    reuse = store->calcTime <= currentTime ? True : False;
+    initSearchStart(currentTime, &start);
+    for (id = 0; id < store->count; id++) {
+        if ((store->flags[id] & ENTRY_LIVE) == 0) {
+            continue;
+        }
+        nextTime = store->nextTimes[id];
+        if (reuse && (store->flags[id] & ENTRY_TIMED) 
+                && (nextTime == TIME_IN_PAST 
+                    || floorDiv(nextTime, SECS_PER_MIN) > minute)) {
+            continue;
+        }
+        compiled.minute = store->minutes[id];
+        compiled.hour = store->hours[id];
+        compiled.dayOfMonth = store->daysOfMonth[id];
+        compiled.monOfYear = store->monthsOfYear[id];
+        compiled.dayOfWeek = store->daysOfWeek[id];
+        next = start;
+        if (findNextMaskTime(&compiled, (store->flags[id] & ENTRY_ANY_YEAR) 
+                    ? NULL : store->years[id], &next) == ERROR) {
+            store->nextTimes[id] = TIME_IN_PAST;
         }
         else {
-            scheduled->tm_mday = newDay;
+            store->nextTimes[id] = calTimeToTime(&next, currentTime);
         }
+        store->flags[id] |= ENTRY_TIMED;
     }
+    // Kept times were calculated no later than the previous scan.
+    store->calcTime = currentTime;
+    return store;
+}
 
-    // Day rolled, set all finer grained variables to initial values
-    initValues(entry, scheduled, CI_HOUR);
-    return SUCCESS;
+/**
+ * Search forward from the provided calendar time for the first time that
+ * matches all calendar values of the entry.  Each field is resolved using
+ * the compiled bitsets.  If a field has no remaining value, the next coarser
+ * field is incremented and all finer fields are reset to their first value.
+ * Fields may be past their maximum on entry, e.g. minute 60. 
+ * Returns:
+ *  SUCCESS if a time was found.  next is updated with the time.
+ *  ERROR   if the entry has no future times. 
+ */
+int findNextScheduledTime(scheduleEntry *entry, calTime *next) {
+    return findNextMaskTime(&entry->compiled, 
+            entry->year.type != WILDCARD ? &entry->year : NULL, next);
 }
+
 /**
- * Increment the hour if mutable.  If not, then attempt incrementing 
- * coarser grained calendar variables.  If date could not be incremented,
- * return ERROR.
- */
-int rollHour(scheduleEntry * entry, struct tm * scheduled) {
-    unsigned int newHour;
-    int calComp;
-    switch (entry->hour.type) {
-    case SINGLE:
-        // Unable to modify hour
-        return rollDayOfMonth(entry, scheduled);
-        
-    case RANGE:
-    case LIST:
-        newHour = scheduled->tm_hour + 1; 
-        calComp = compareCurrentToSchedule(newHour, &entry->hour);
-        if (calComp < 0) {
-            return rollDayOfMonth(entry, scheduled);
-        } 
-        else {
-            scheduled->tm_hour = newHour + calComp;
-            initValues(entry, scheduled, CI_MIN);
+ * Search as findNextScheduledTime using the compiled fields and year of an
+ * entry.  year is NULL if any year is allowed.
+ */
+int findNextMaskTime(calendarMask *compiled, valueStruct *year, 
+        calTime *next) {
+    int lastYear = next->year + MAX_YEAR_SEARCH;
+    int calComp, value;
+
+    if (compiled->minute == 0 || compiled->hour == 0 
+            || compiled->dayOfMonth == 0 || compiled->monOfYear == 0 
+            || compiled->dayOfWeek == 0) {
+        // No valid values for at least one field.
+        return ERROR;
+    }
+
+    while (next->year <= lastYear) {
+        if (year != NULL && year->type != WILDCARD) {
+            calComp = compareCurrentToSchedule(next->year, year);
+            if (calComp < 0) {
+                // No future entries for this task.
+                return ERROR;
+            }
+            else if (calComp > 0) {
+                next->year += calComp;
+                next->mon = next->mday = next->hour = next->min = 0;
+            }
         }
-        break;
 
-    case WILDCARD:
-        newHour = scheduled->tm_hour + 1; 
-        if (newHour > 23) {
-            return rollDayOfMonth(entry, scheduled);
-        } 
-        else {
-            scheduled->tm_hour = newHour;
-            initValues(entry, scheduled, CI_MIN);
+        value = nextMaskValue(compiled->monOfYear, next->mon);
+        if (value < 0) {
+            next->year++;
+            next->mon = next->mday = next->hour = next->min = 0;
+            continue;
+        }
+        else if (value != next->mon) {
+            next->mon = value;
+            next->mday = next->hour = next->min = 0;
+        }
+
+        value = nextMaskValue(dayOfMonthMask(compiled, next->year, next->mon),
+                next->mday);
+        if (value < 0) {
+            next->mon++;
+            next->mday = next->hour = next->min = 0;
+            continue;
         }
+        else if (value != next->mday) {
+            next->mday = value;
+            next->hour = next->min = 0;
+        }
+
+        value = nextMaskValue(compiled->hour, next->hour);
+        if (value < 0) {
+            next->mday++;
+            next->hour = next->min = 0;
+            continue;
+        }
+        else if (value != next->hour) {
+            next->hour = value;
+            next->min = 0;
+        }
+
+        value = nextMaskValue(compiled->minute, next->min);
+        if (value < 0) {
+            next->hour++;
+            next->min = 0;
+            continue;
+        }
+        next->min = value;
+        return SUCCESS;
     }
-    return SUCCESS;
+
+    return ERROR;
 }
 
 /**
- * Increment the minute if mutable.  If not, attempt incrementing 
- * coarser grained calendar variables.  If date could not be incremented,
- * return ERROR.
- */
-int rollMinute(scheduleEntry * entry, struct tm * scheduled) {
-    unsigned int newMinute;
-    int calComp;
-    switch (entry->minute.type) {
-    case SINGLE:
-        // Unable to modify minute
-        return rollHour(entry, scheduled);
-        
-    case RANGE:
-    case LIST:
-        newMinute = scheduled->tm_min + 1; 
-        calComp = compareCurrentToSchedule(newMinute, &entry->minute);
-        if (calComp < 0) {
-            return rollHour(entry, scheduled);
-        } 
-        else {
-            scheduled->tm_min = newMinute + calComp;
+ * Return the smallest value within the mask that is greater than or equal
+ * to current.  If there is no such value, -1 is returned.
+ */
+int nextMaskValue(uint64_t mask, int current) {
+    if (current >= 64) {
+        return -1;
+    }
+    mask &= ~0ULL << current;
+    return mask == 0 ? -1 : __builtin_ctzll(mask);
+}
+
+/**
+ * Return the days of the provided month allowed by both the day of month and
+ * day of week values of an entry.  Bit n is set if day n is allowed.
+ */
+uint32_t dayOfMonthMask(calendarMask *compiled, int year, int month) {
+    uint32_t mask;
+    uint64_t weekMask;
+    int firstDow, dow;
+
+    mask = compiled->dayOfMonth 
+        & (((1U << daysInMonth(year, month)) - 1) << 1);
+
+    if (compiled->dayOfWeek != 0x7f) {
+        firstDow = weekdayFromDays(daysFromCivil(year, month, 1));
+
+        // Rotate the week so bit 0 is the 1st, then repeat it for the month.
+        weekMask = 0;
+        for (dow = 0; dow < 7; dow++) {
+            if (compiled->dayOfWeek & (1 << ((firstDow + dow) % 7))) {
+                weekMask |= 1ULL << dow;
+            }
         }
-        break;
+        weekMask |= weekMask << 7;
+        weekMask |= weekMask << 14;
+        weekMask |= weekMask << 28;
+        mask &= (uint32_t)(weekMask << 1);
+    }
+    return mask;
+}
 
-    case WILDCARD:
-        // ERROR:  Minute cannot be wild
-        break;
+/**
+ * Return the number of days since 1970-01-01 for the provided date using
+ * only integer arithmetic.  Month is 0 - 11.  Dates before 1970 are negative.
+ * Based on the days_from_civil algorithm described by Howard Hinnant.
+ */
+long daysFromCivil(int year, int month, int day) {
+    long era, yearOfEra, dayOfYear, dayOfEra;
+    int marchMonth;
+
+    // Years start in March so the leap day is the last day of the year.
+    marchMonth = month >= 2 ? month - 2 : month + 10;
+    if (month < 2) {
+        year--;
     }
-    return SUCCESS;
+    era = floorDiv(year, 400);
+    yearOfEra = year - era * 400;
+    dayOfYear = (153 * marchMonth + 2) / 5 + day - 1;
+    dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
 }
 
+/**
+ * Set the year, month and day of month of the calendar time from the number
+ * of days since 1970-01-01.  Inverse of daysFromCivil.
+ */
+void civilFromDays(long days, calTime *cal) {
+    long era, dayOfEra, yearOfEra, dayOfYear, marchMonth;
+
+    days += 719468;
+    era = floorDiv(days, 146097);
+    dayOfEra = days - era * 146097;
+    yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 
+            - dayOfEra / 146096) / 365;
+    dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    marchMonth = (5 * dayOfYear + 2) / 153;
+
+    cal->mday = dayOfYear - (153 * marchMonth + 2) / 5 + 1;
+    cal->mon = marchMonth < 10 ? marchMonth + 2 : marchMonth - 10;
+    cal->year = yearOfEra + era * 400 + (cal->mon < 2 ? 1 : 0);
+}
 
 /**
- * Return the number of days in the month for the given year.
+ * Return the day of week, 0 is Sunday, for days since 1970-01-01.
  */
-int daysInMonth(int year, int month) {
-    if ((year % 400 == 0) || (year % 4 == 0 && year % 100 != 0)) {
-        return monthDaysLeap[month];
-    } 
-    else {
-        return monthDaysNorm[month];
+int weekdayFromDays(long days) {
+    // 1970-01-01 was a Thursday
+    return (int)(days - floorDiv(days + 4, 7) * 7 + 4);
+}
+
+/**
+ * Integer division rounding toward negative infinity.
+ */
+long floorDiv(long value, long divisor) {
+    long quotient = value / divisor;
+    return (value % divisor != 0 && (value < 0) != (divisor < 0)) ? 
+        quotient - 1 : quotient;
+}
+
+/**
+ * Return the cached UTC offset for the local day, filling the cache entry 
+ * using the C library if needed.  The state of the returned entry will be
+ * OFFSET_CHANGES if the offset is not the same for the entire day.
+ */
+utcOffsetEntry * lookupUtcOffset(long day) {
+    utcOffsetEntry * cached = &offsetCache[day & (OFFSET_CACHE_SIZE - 1)];
+    struct tm dayStart, dayEnd;
+    calTime cal;
+    long startOffset, endOffset;
+
+    if (cached->state != OFFSET_EMPTY && cached->day == day) {
+        return cached;
     }
+
+    civilFromDays(day, &cal);
+    memset(&dayStart, 0, sizeof(struct tm));
+    dayStart.tm_year = cal.year - 1900;
+    dayStart.tm_mon = cal.mon;
+    dayStart.tm_mday = cal.mday;
+    dayStart.tm_isdst = -1;     // Cause mktime to evaluate dst for given time
+    memcpy(&dayEnd, &dayStart, sizeof(struct tm));
+    dayEnd.tm_hour = 23;
+    dayEnd.tm_min = 59;
+
+    startOffset = day * SECS_PER_DAY - mktime(&dayStart);
+    endOffset = day * SECS_PER_DAY + 23 * SECS_PER_HOUR + 59 * SECS_PER_MIN 
+        - mktime(&dayEnd);
+
+    cached->day = day;
+    cached->offset = startOffset;
+    cached->state = startOffset == endOffset ? OFFSET_FIXED : OFFSET_CHANGES;
+    return cached;
 }
 
 /**
- * Returns the next time that the provided entry should be activated.
- * If in the past, TIME_IN_PAST, a negative value wil be returned.
+ * Discard all cached UTC offsets.  Must be invoked if the time zone changes.
  */
-time_t calcNextTimeForTask(scheduleEntry *entry) {
-    struct tm scheduled, *now;
-    time_t currentTime = getCurrentTime();
-    int calComp;
-    // Populate now and default the scheduled to now
-	now = localtime(&currentTime);
-	memcpy(&scheduled, now, sizeof(struct tm));
-    scheduled.tm_isdst = -1;    // Cause mktime to reevaluate dst for given time
-    scheduled.tm_sec = 0;
-
-    // Year check:
-
-	if (entry->year.type != WILDCARD) {
-        calComp = compareCurrentToSchedule(now->tm_year + 1900, &entry->year);
-        if (calComp < 0) {
-	        // No future entries for this task.
-	        return TIME_IN_PAST;
-	    }
-	    else if (calComp > 0) {
-	        // Task is next year, init lower variable and return time.
-    	    scheduled.tm_year += calComp;
-	        initValues(entry, &scheduled, CI_MOY);
-	        return mktime(&scheduled);
-	    }
-	}
-    /* 
-        Month check:
-        Assumption s.year = n.year
-    */
-    if (entry->monOfYear.type != WILDCARD)  {
-        calComp = compareCurrentToSchedule(now->tm_mon, &entry->monOfYear);
-        if (calComp < 0) {
-	    	// task has passed.
-	    	if (rollYear(entry, &scheduled) == ERROR) {
-	    		return TIME_IN_PAST;
-	    	}
-            scheduled.tm_mon = returnFirstValue(entry->monOfYear);
-            return mktime(&scheduled);
-	    }
-	    else if (calComp > 0) {
-    	    scheduled.tm_mon += calComp;
-	    	initValues(entry, &scheduled, CI_DOM);
-	    	return mktime(&scheduled);
-	    }
-        else {
-            scheduled.tm_mon = now->tm_mon;
-        }
-    }
-
-    /*
-        Day check:
-        Assumption s.year = n.year
-        Assumption s.mon = n.mon
-    */
-    if (entry->dayOfWeek.type != WILDCARD) {
-        /*
-            Day of Week check:
-            The result of this will be an updated day of *Month* (dom)
-            Assumption s.year = n.year
-            Assumption s.mon = n.mon
-            Assumption e.dom is wild
-            Assumption e.dow is *not* wild
-        */
-        calComp = compareCurrentToSchedule(now->tm_wday, &entry->dayOfWeek);
-        if (calComp != 0) {
-            int tempMday = scheduled.tm_mday + ((7 + calComp) % 7);
-            if (tempMday > daysInMonth(scheduled.tm_year, scheduled.tm_mon)) {
-            	if (rollMonth(entry, &scheduled) == ERROR) {
-            		// Cannot roll month
-            		return TIME_IN_PAST;
-            	}
-            }
-            else {
-                scheduled.tm_mday = tempMday; 
-            }
-            initValues(entry, &scheduled, CI_HOUR);
-	    	return mktime(&scheduled);
-    	}
+void resetUtcOffsetCache() {
+    memset(offsetCache, 0, sizeof(offsetCache));
+    lastUtcOffset = 0;
+}
+
+/**
+ * Convert the time to local calendar time.  Seconds are discarded.
+ */
+void timeToCalTime(time_t time, calTime *cal) {
+    utcOffsetEntry * cached;
+    struct tm local;
+    long day, secOfDay;
+
+    // Guess the local day using the last offset and confirm the guess is 
+    // consistent with the offset of that day.
+    day = floorDiv(time + lastUtcOffset, SECS_PER_DAY);
+    cached = lookupUtcOffset(day);
+    if (cached->state == OFFSET_FIXED 
+            && floorDiv(time + cached->offset, SECS_PER_DAY) == day) {
+        secOfDay = time + cached->offset - day * SECS_PER_DAY;
+        civilFromDays(day, cal);
+        cal->hour = secOfDay / SECS_PER_HOUR;
+        cal->min = (secOfDay % SECS_PER_HOUR) / SECS_PER_MIN;
+        return;
     }
-    else {
-        /* 
-            Day of Month check:
-            Assumption s.year = n.year
-            Assumption s.mon = n.mon
-            Assumption e.dow is wild
-        */
-    	if (entry->dayOfMonth.type != WILDCARD) {
-            calComp = compareCurrentToSchedule(now->tm_mday, &entry->dayOfMonth);
-    	    if (calComp < 0) {
-    			if (rollMonth(entry, &scheduled) == ERROR) {
-    				// Can't roll, task is in the past
-    				return TIME_IN_PAST;
-    			}
-                scheduled.tm_mday = returnFirstValue(entry->dayOfMonth);
-                return mktime(&scheduled);
-    		}
-            else if (calComp > 0) {
-                scheduled.tm_mday += calComp;
-	            initValues(entry, &scheduled, CI_HOUR);
-		    	return mktime(&scheduled);
-	    	}
-            else {
-                scheduled.tm_mday = now->tm_mday;
-            }
-    	}
+
+    localtime_r(&time, &local);
+    lastUtcOffset = local.tm_gmtoff;
+    cal->year = local.tm_year + 1900;
+    cal->mon = local.tm_mon;
+    cal->mday = local.tm_mday;
+    cal->hour = local.tm_hour;
+    cal->min = local.tm_min;
+}
+
+/**
+ * Convert the local calendar time to time_t.  Fields must be in range.  
+ * On days when the offset from UTC changes, a local time may occur twice or
+ * not at all.  If it occurs twice, the first occurrence later than after is
+ * returned.  If it does not occur, the time following the change is returned.
+ */
+time_t calTimeToTime(calTime *cal, time_t after) {
+    utcOffsetEntry * cached;
+    struct tm local, check;
+    time_t converted, earliest = TIME_IN_PAST, latest = TIME_IN_PAST;
+    long day;
+    int isDst;
+
+    day = daysFromCivil(cal->year, cal->mon, cal->mday);
+    cached = lookupUtcOffset(day);
+    if (cached->state == OFFSET_FIXED) {
+        return day * SECS_PER_DAY + cal->hour * SECS_PER_HOUR 
+            + cal->min * SECS_PER_MIN - cached->offset;
     }
 
-    /*
-        Hour check:
-            Assumption s.year = n.year
-            Assumption s.mon = n.mon
-            Assumption s.dom = n.mon
-    */
-    if (entry->hour.type != WILDCARD) {
-    	// scheduled.tm_hour = entry->hour.value;
-        calComp = compareCurrentToSchedule(now->tm_hour, &entry->hour);
-    	if (calComp < 0) {
-    		if (rollDayOfMonth(entry, &scheduled) == ERROR) {
-    			// Cannot roll, task is in the past
-    			return TIME_IN_PAST;
-    		}
-            scheduled.tm_hour = returnFirstValue(entry->hour);
-    		return mktime(&scheduled);
-    	}
-    	else if (calComp > 0) {
-            scheduled.tm_hour += calComp;
-    		initValues(entry, &scheduled, CI_MIN);
-    		return mktime(&scheduled);
-    	}
-        else {
-            scheduled.tm_hour = now->tm_hour;
-        }
-    }
-    /*
-        Min check:
-            Assumption s.year = n.year
-            Assumption s.mon = n.mon
-            Assumption s.dom = n.mon
-            Assumption s.hour = n.hour
-            Assumption e.min *cannot* be wild, but can be range or list
-    */
-    calComp = compareCurrentToSchedule(now->tm_min, &entry->minute);
-    if (calComp < 0) {
-        scheduled.tm_min = returnFirstValue(entry->minute);
-    	if (rollHour(entry, &scheduled) == ERROR) {
-    		// Cannot roll, task in past
-    		return TIME_IN_PAST;
-	    }
-    } 
-    else if (calComp > 0) {
-        scheduled.tm_min += calComp;
-    }
-    else if (calComp == 0) {
-        scheduled.tm_min = now->tm_min;
-        if (scheduled.tm_sec <= now->tm_sec) {
-            if (rollMinute(entry, &scheduled) == ERROR) {
-                // Cannot roll, task in past
-                return TIME_IN_PAST;
-            }
+    for (isDst = 0; isDst <= 1; isDst++) {
+        memset(&local, 0, sizeof(struct tm));
+        local.tm_year = cal->year - 1900;
+        local.tm_mon = cal->mon;
+        local.tm_mday = cal->mday;
+        local.tm_hour = cal->hour;
+        local.tm_min = cal->min;
+        local.tm_isdst = isDst;
+        converted = mktime(&local);
+
+        latest = converted > latest ? converted : latest;
+        localtime_r(&converted, &check);
+        if (check.tm_hour == cal->hour && check.tm_min == cal->min 
+                && converted > after 
+                && (earliest == TIME_IN_PAST || converted < earliest)) {
+            earliest = converted;
         }
     }
-    // Minute is either =, >, or the coarser grained values have been rolled
-    return mktime(&scheduled);
+    return earliest != TIME_IN_PAST ? earliest : latest;
 }
 
-
 /**
- * Initialize scheduled values from the provided level on down using values 
- * contained within the entry. For example: If the level is DOM, then year and 
- * month will remain intact and all finer grained time values will be initialized
- * to the lowest value if wild or the value from the entry.
+ * Compile the calendar values of the entry into bitsets.  See calendarMask.
  */
-void initValues(scheduleEntry *entry, struct tm *scheduled, enum CalIndex level) {
-    int dow;
-    struct tm tempSchedule;
-
-    switch(level) {
-        case CI_YEAR:
-            if (!entry->year.type == WILDCARD) {
-                scheduled->tm_year = returnFirstValue(entry->year);
-            }
-        case CI_MOY: 
-            scheduled->tm_mon = entry->monOfYear.type == WILDCARD ? 
-                INIT_MON_VAL : returnFirstValue(entry->monOfYear);
-        case CI_DOM: 
-            scheduled->tm_mday = entry->dayOfMonth.type == WILDCARD ? 
-                INIT_DOM_VAL : returnFirstValue(entry->dayOfMonth);
-        case CI_DOW: 
-            if (entry->dayOfWeek.type != WILDCARD) {
-                memcpy(&tempSchedule, scheduled, sizeof(struct tm));
-                mktime(&tempSchedule);
-                dow = returnFirstValue(entry->dayOfWeek);
-                if (dow != tempSchedule.tm_wday ) {
-                    scheduled->tm_mday += 
-                        (7 + entry->dayOfWeek.value - tempSchedule.tm_wday) % 7;
-                }
-            }
-        case CI_HOUR: 
-            scheduled->tm_hour = entry->hour.type == WILDCARD ? 
-                INIT_HOUR_VAL : returnFirstValue(entry->hour);
-        case CI_MIN: 
-            scheduled->tm_min = entry->minute.type == WILDCARD ? 
-                INIT_MIN_VAL : returnFirstValue(entry->minute);
-            break;
-        default:
-    	    fprintf(stderr, "Invalid value passed to initValues\n");
-    }
+void compileScheduleEntry(scheduleEntry *entry) {
+    entry->compiled.monOfYear = compileValueStruct(&entry->monOfYear, 0, 11);
+    entry->compiled.dayOfMonth = compileValueStruct(&entry->dayOfMonth, 1, 31);
+    entry->compiled.dayOfWeek = compileValueStruct(&entry->dayOfWeek, 0, 6);
+    entry->compiled.hour = compileValueStruct(&entry->hour, 0, 23);
+    entry->compiled.minute = compileValueStruct(&entry->minute, 0, 59);
 }
 
 /**
- * Return the first value based on type of entry.
+ * Convert the valueStruct to a bitset with bit n set for each value n 
+ * allowed. Values outside of minVal - maxVal are ignored.
  */
-int returnFirstValue(valueStruct values) {
-    // Assumption.  Values are in ascending order
-    switch(values.type) {
+uint64_t compileValueStruct(valueStruct * value, int minVal, int maxVal) {
+    uint64_t mask = 0;
+    int current, step;
+
+    switch (value->type) {
+        case WILDCARD:
+            for (current = minVal; current <= maxVal; current++) {
+                mask |= 1ULL << current;
+            }
+            break;
         case SINGLE:
-            return values.value;
+            if (value->value >= minVal && value->value <= maxVal) {
+                mask = 1ULL << value->value;
+            }
+            break;
         case RANGE:
-            return values.range[0];
+            step = value->range[2] > 0 ? value->range[2] : 1;
+            for (current = value->range[0]; current <= value->range[1]; 
+                    current += step) {
+                if (current >= minVal && current <= maxVal) {
+                    mask |= 1ULL << current;
+                }
+            }
+            break;
         case LIST:
-            // Assumption: List elements cannot be another list.
-            return returnFirstValue(*(values.listNode.element));
-        default:
-            fprintf(stderr, "Err:  returnFirstValue invoked with invalid value\n");
-            return ERROR;
+            mask = compileValueStruct(value->listNode.element, minVal, maxVal);
+            if (value->listNode.next != NULL) {
+                mask |= compileValueStruct(value->listNode.next, minVal, maxVal);
+            }
+            break;
     }
+    return mask;
 }
 
 /**
  * Return "current" time.  During testing, current time will be overridden
  * to provide fixed value for deterministic results.
  */
-time_t getCurrentTime() {
-    return timeOverride == 0 ? time(NULL) : timeOverride;
+time_t getCurrentTime(scheduleContext * ctx) {
+    return ctx->timeOverride == 0 ? time(NULL) : ctx->timeOverride;
 }
 
 /**
  * Set fixed test time.  Should be used for testing only.
  */
-void setTestTime(time_t time) {
-    timeOverride = time;
+void setTestTime(scheduleContext * ctx, time_t time) {
+    ctx->timeOverride = time;
+    // Previously calculated times are relative to the old time.
+    resetTaskAlarmQueue(ctx);
 }
 
 /**
@@ -1332,9 +2676,9 @@ int compareCurrentToSchedule(int current, valueStruct *values) {
                    of 1 for all values within the range. 
                    Start val +  Number of steps * Step value
                 */
-                nextVal = values->range[0]                                         
-                        + (ceil((1.0 * current - values->range[0]) / values->range[2]) 
-                        * values->range[2]);
+                nextVal = values->range[0] 
+                        + ((current - values->range[0] + values->range[2] - 1)
+                        / values->range[2]) * values->range[2];
                 if (nextVal > values->range[1]) {
                     return values->range[0] - current;
                 }
@@ -1465,6 +2809,71 @@ void freeScheduleNodeList(scheduleNode * current) {
     free(current);
 }
 
+void freeSchedule(scheduleContext * ctx) {
+    scheduleNode * node;
+    actionNode * cmd, * nextCmd;
+
+    resetTaskAlarmQueue(ctx);
+    // List nodes belong to the generations.  Entries may hold rendered 
+    // commands or an action set built outside of the schedule.
+    for (node = ctx->schedHead; node != NULL; node = node->next) {
+        freeActionSet(node->entry->actionSet);
+        freeScheduleEntry(node->entry);
+    }
+    ctx->schedHead = ctx->schedTail = NULL;
+    ctx->scheduleCount = 0;
+
+    for (cmd = ctx->cmdHead; cmd != NULL; cmd = nextCmd) {
+        nextCmd = cmd->next;
+        freeActionDef(cmd->action);
+        if (cmd->arena == NULL) {
+            free(cmd);
+        }
+    }
+    ctx->cmdHead = ctx->cmdTail = NULL;
+    freeActionIndex(&ctx->actions);
+
+    freeScheduleArenas(ctx->arena);
+    ctx->arena = NULL;
+    freeStringPool(ctx->strings);
+    ctx->strings = NULL;
+    freeEntryStore(ctx->store);
+    ctx->store = NULL;
+
+    // Only once no entry refers to their text.
+    freeMappedFiles(ctx->mappedFiles);
+    ctx->mappedFiles = NULL;
+}
+
+scheduleNode * getScheduleEntries(scheduleContext * ctx) {
+    return ctx->schedHead;
+}
+
+void freeActionDef(actionDef * action) {
+    if (action->arena != NULL) {
+        releaseArena(action->arena);
+        return;
+    }
+    freeCommandArgs(action->args);
+    free(action->name);
+    free(action->command);
+    free(action);
+}
+
+void freeActionSet(actionNode * node) {
+    actionNode * next;
+
+    for (; node != NULL; node = next) {
+        next = node->next;
+        if (node->action != NULL && node->action->type == PRIVATE) {
+            freeActionDef(node->action);
+        }
+        if (node->arena == NULL) {
+            free(node);
+        }
+    }
+}
+
 /**
  * Perform deep copy of valueStruct items needed for LIST type
  * Args:
@@ -1476,17 +2885,28 @@ void freeScheduleNodeList(scheduleNode * current) {
  *  pointer.  Otherwise, it will be a newly allocated pointer.
  */ 
 valueStruct * copyValueStruct(valueStruct * dest, valueStruct * source) {
+    return copyArenaValueStruct(NULL, dest, source);
+}
+
+/**
+ * Deep copy as copyValueStruct, allocating from the arena.  Uses the heap if
+ * arena is NULL.
+ */
+valueStruct * copyArenaValueStruct(scheduleArena * arena, valueStruct * dest, 
+        valueStruct * source) {
     if (dest == NULL) {
-        dest = malloc(sizeof(valueStruct));
-        assert(dest != NULL);
+        dest = arenaAlloc(arena, sizeof(valueStruct));
 	    memset(dest, 0, sizeof(valueStruct));
     }
     // Deep copy on list items, but a simple memcpy all on all others.
     if (source->type == LIST) {
         dest->type = LIST;
-        dest->listNode.element = copyValueStruct(NULL, source->listNode.element);
+        dest->listNode.element = copyArenaValueStruct(arena, NULL, 
+                source->listNode.element);
+        dest->listNode.next = NULL;
         if (source->listNode.next != NULL) {
-            dest->listNode.next = copyValueStruct(NULL, source->listNode.next);
+            dest->listNode.next = copyArenaValueStruct(arena, NULL, 
+                    source->listNode.next);
         }
     } 
     else {
@@ -0,0 +1,168 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <assert.h>
+#include "schedule.h"
+#include "scheduleArena.h"
+
+// Alignment of allocations other than strings
+#define ARENA_ALIGN _Alignof(max_align_t)
+// Round up to a multiple of align, a power of 2
+#define ALIGN_UP(size, align) (((size) + (align) - 1) & ~((size_t)(align) - 1))
+// Offset of the memory of a chunk from its header
+#define CHUNK_HEADER ALIGN_UP(sizeof(arenaChunk), ARENA_ALIGN)
+
+/* -----------------------------------------------------------------------------
+ *  Prototypes
+ * ---------------------------------------------------------------------------*/
+void * allocFromArena(scheduleArena * arena, size_t size, size_t align);
+arenaChunk * addArenaChunk(scheduleArena * arena, size_t size);
+
+/* -----------------------------------------------------------------------------
+ *  Function definitions.
+ * ---------------------------------------------------------------------------*/
+
+scheduleArena * createScheduleArena() {
+    scheduleArena * arena;
+
+    arena = malloc(sizeof(scheduleArena));
+    assert(arena != NULL);
+    memset(arena, 0, sizeof(scheduleArena));
+    arena->nextChunkSize = ARENA_MIN_CHUNK;
+    arena->stats.generations = 1;
+    return arena;
+}
+
+void freeScheduleArena(scheduleArena * arena) {
+    arenaChunk * chunk, * next;
+
+    if (arena == NULL) {
+        return;
+    }
+    for (chunk = arena->chunks; chunk != NULL; chunk = next) {
+        next = chunk->next;
+        free(chunk);
+    }
+    free(arena);
+}
+
+void freeScheduleArenas(scheduleArena * arena) {
+    scheduleArena * next;
+
+    for (; arena != NULL; arena = next) {
+        next = arena->next;
+        freeScheduleArena(arena);
+    }
+}
+
+scheduleArena * freeIdleArenas(scheduleArena * arena) {
+    scheduleArena * head = arena, ** link = &head;
+
+    while (*link != NULL) {
+        arena = *link;
+        if (arena->liveCount == 0) {
+            *link = arena->next;
+            freeScheduleArena(arena);
+        }
+        else {
+            link = &arena->next;
+        }
+    }
+    return head;
+}
+
+void * arenaAlloc(scheduleArena * arena, size_t size) {
+    return allocFromArena(arena, size, ARENA_ALIGN);
+}
+
+char * arenaStrndup(scheduleArena * arena, const char * str, size_t maxLen) {
+    char * copy;
+    size_t len = strnlen(str, maxLen);
+
+    // Strings need no alignment, so are packed together.
+    copy = allocFromArena(arena, len + 1, 1);
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+char * arenaStrdup(scheduleArena * arena, const char * str) {
+    return arenaStrndup(arena, str, strlen(str));
+}
+
+void retainArena(scheduleArena * arena) {
+    if (arena != NULL) {
+        arena->liveCount++;
+    }
+}
+
+void releaseArena(scheduleArena * arena) {
+    if (arena != NULL) {
+        assert(arena->liveCount > 0);
+        arena->liveCount--;
+    }
+}
+
+void getArenaStats(scheduleArena * arena, arenaStats * stats) {
+    memset(stats, 0, sizeof(arenaStats));
+    for (; arena != NULL; arena = arena->next) {
+        stats->allocs += arena->stats.allocs;
+        stats->bytesUsed += arena->stats.bytesUsed;
+        stats->bytesReserved += arena->stats.bytesReserved;
+        stats->chunks += arena->stats.chunks;
+        stats->generations += arena->stats.generations;
+    }
+}
+
+/**
+ * Bump allocate from the current chunk, starting a new chunk when it is
+ * full.  The rest of a full chunk is left unused.
+ */
+void * allocFromArena(scheduleArena * arena, size_t size, size_t align) {
+    arenaChunk * chunk;
+    size_t start;
+    void * memory;
+
+    if (arena == NULL) {
+        memory = malloc(size);
+        assert(memory != NULL);
+        return memory;
+    }
+    chunk = arena->chunks;
+    start = chunk != NULL ? ALIGN_UP(chunk->used, align) : 0;
+    if (chunk == NULL || start + size > chunk->size) {
+        chunk = addArenaChunk(arena, size);
+        start = 0;
+    }
+    arena->stats.allocs++;
+    arena->stats.bytesUsed += start + size - chunk->used;
+    chunk->used = start + size;
+    return (char *)chunk + CHUNK_HEADER + start;
+}
+
+/**
+ * Allocate a chunk able to hold at least size bytes.  Chunks double in size
+ * up to ARENA_MAX_CHUNK, so a schedule of any size is loaded using few
+ * chunks.  An allocation larger than that has a chunk of its own.
+ */
+arenaChunk * addArenaChunk(scheduleArena * arena, size_t size) {
+    arenaChunk * chunk;
+    size_t chunkSize = arena->nextChunkSize;
+
+    if (chunkSize < size) {
+        chunkSize = ALIGN_UP(size, ARENA_ALIGN);
+    }
+    chunk = malloc(CHUNK_HEADER + chunkSize);
+    assert(chunk != NULL);
+    chunk->size = chunkSize;
+    chunk->used = 0;
+    chunk->next = arena->chunks;
+    arena->chunks = chunk;
+    if (arena->nextChunkSize < ARENA_MAX_CHUNK) {
+        arena->nextChunkSize *= 2;
+    }
+    arena->stats.chunks++;
+    arena->stats.bytesReserved += CHUNK_HEADER + chunkSize;
+    return chunk;
+}
@@ -0,0 +1,743 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "schedule.h"
+#include "scheduleLoader.h"
+#include "scheduleCache.h"
+
+#define SUCCESS 0
+#define ERROR 1
+// Number of calendar fields of an entry
+#define NUMBER_OF_CAL_FIELDS 6
+// Largest number of values within one calendar field of a cached entry
+#define MAX_FIELD_VALUES 255
+// Alignment of each section of the cache
+#define CACHE_ALIGN 8
+// Initial number of slots of the table interning strings.  Power of 2.
+#define STRING_SLOTS 256
+
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+#ifdef __APPLE__
+#define MTIME_NSEC(st) ((st)->st_mtimespec.tv_nsec)
+#else
+#define MTIME_NSEC(st) ((st)->st_mtim.tv_nsec)
+#endif
+
+/* -----------------------------------------------------------------------------
+ *  Internal Structures
+ * ---------------------------------------------------------------------------*/
+
+/**
+ * Growable array of records of one type, written as a section of the cache.
+ */
+typedef struct _recordBuffer {
+    char * data;
+    uint32_t count;
+    uint32_t capacity;
+    size_t recordSize;
+} recordBuffer;
+
+/**
+ * Strings written to the cache.  slots hash each distinct string to its
+ * offset within text plus 1, 0 if the slot is empty.
+ */
+typedef struct _stringTable {
+    recordBuffer text;
+    uint32_t * slots;
+    uint32_t slotCount;         // Power of 2
+    uint32_t used;
+} stringTable;
+
+/* -----------------------------------------------------------------------------
+ *  Prototypes
+ * ---------------------------------------------------------------------------*/
+int readScheduleCache(scheduleContext * ctx, const char * cacheName,
+        int sourceFd, struct stat * source);
+Bool isCacheValid(const char * addr, size_t length);
+void loadCacheEntries(scheduleContext * ctx, const char * addr);
+valueStruct * buildCacheField(const cacheValue * values, int count,
+        valueStruct * pool);
+void refreshCacheHeader(const char * cacheName, cacheHeader * header,
+        struct stat * source);
+int writeScheduleCache(scheduleContext * ctx, const char * cacheName,
+        struct stat * source, uint64_t hash);
+int addCacheEntry(scheduleContext * ctx, scheduleEntry * entry,
+        recordBuffer * entries, recordBuffer * values, recordBuffer * refs,
+        stringTable * strings);
+int addCacheField(recordBuffer * values, valueStruct * value,
+        uint8_t * count);
+int findActionIndex(scheduleContext * ctx, actionDef * action);
+Bool writeCacheSection(FILE * out, recordBuffer * buffer, uint32_t * offset,
+        uint32_t * position);
+Bool hashScheduleFile(int fd, size_t size, uint64_t * hash);
+uint64_t hashBytes(uint64_t hash, const char * data, size_t length);
+void initRecordBuffer(recordBuffer * buffer, size_t recordSize);
+void * addRecord(recordBuffer * buffer);
+void freeRecordBuffer(recordBuffer * buffer);
+uint32_t internString(stringTable * table, const char * str);
+
+/* -----------------------------------------------------------------------------
+ *  Function definitions.
+ * ---------------------------------------------------------------------------*/
+
+int loadScheduleCached(scheduleContext * ctx, const char * fileName,
+        enum ParserType parser) {
+    char cacheName[PATH_MAX];
+    struct stat source;
+    uint64_t hash;
+    FILE * file;
+    int status;
+
+    if (snprintf(cacheName, sizeof(cacheName), "%s%s", fileName,
+                SCHEDULE_CACHE_SUFFIX) >= (int)sizeof(cacheName)) {
+        return loadScheduleFile(ctx, fileName, parser);
+    }
+	file = fopen(fileName, "r");
+    if (file == NULL) {
+    	perror("Failed to open input file: ");
+    	return ERROR;
+    }
+    if (fstat(fileno(file), &source) != 0) {
+        fclose(file);
+        return loadScheduleFile(ctx, fileName, parser);
+    }
+    if (readScheduleCache(ctx, cacheName, fileno(file), &source) == SUCCESS) {
+        fclose(file);
+        return SUCCESS;
+    }
+
+    // Hashed before parsing, so a change made while parsing is seen as a
+    // change the next time.
+    if (hashScheduleFile(fileno(file), source.st_size, &hash) == False) {
+        hash = 0;
+    }
+    if (parser == PARSER_MAPPED) {
+        status = parseMappedScheduleFile(ctx, file);
+    }
+    else {
+        status = parseScheduleFile(ctx, file);
+    }
+    fclose(file);
+    if (status == 0) {
+        writeScheduleCache(ctx, cacheName, &source, hash);
+    }
+    return SUCCESS;
+}
+
+/**
+ * Load the schedule from the cache if it is valid and was built from the
+ * same schedule file.
+ * Returns:
+ *  SUCCESS if loaded, otherwise ERROR and the schedule is unchanged.
+ */
+int readScheduleCache(scheduleContext * ctx, const char * cacheName,
+        int sourceFd, struct stat * source) {
+    struct stat cacheStat;
+    cacheHeader * header;
+    mappedFile * mapped;
+    uint64_t hash;
+    char * addr;
+    int fd;
+
+    fd = open(cacheName, O_RDONLY);
+    if (fd < 0) {
+        return ERROR;
+    }
+    if (fstat(fd, &cacheStat) != 0
+            || (size_t)cacheStat.st_size < sizeof(cacheHeader)) {
+        close(fd);
+        return ERROR;
+    }
+    addr = mmap(NULL, cacheStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        return ERROR;
+    }
+
+    header = (cacheHeader *)addr;
+    if (isCacheValid(addr, cacheStat.st_size) == False
+            || header->sourceSize != (int64_t)source->st_size) {
+        munmap(addr, cacheStat.st_size);
+        return ERROR;
+    }
+    if (header->sourceMtime != (int64_t)source->st_mtime
+            || header->sourceMtimeNsec != (int64_t)MTIME_NSEC(source)) {
+        // Touched, checked out or saved unchanged.
+        if (hashScheduleFile(sourceFd, source->st_size, &hash) == False
+                || hash != header->sourceHash) {
+            munmap(addr, cacheStat.st_size);
+            return ERROR;
+        }
+        refreshCacheHeader(cacheName, header, source);
+    }
+
+    mapped = (mappedFile*)malloc(sizeof(mappedFile));
+    assert(mapped != NULL);
+    mapped->addr = addr;
+    mapped->length = cacheStat.st_size;
+    mapped->next = ctx->mappedFiles;
+    ctx->mappedFiles = mapped;
+
+    loadCacheEntries(ctx, addr);
+    return SUCCESS;
+}
+
+/**
+ * Check every offset and index within the cache, so loading never reads
+ * outside of it.
+ */
+Bool isCacheValid(const char * addr, size_t length) {
+    const cacheHeader * header = (const cacheHeader *)addr;
+    const cacheAction * actions;
+    const cacheEntry * entries;
+    const cacheValue * values;
+    const cacheRef * refs;
+    uint32_t idx, field, valueIdx;
+
+    if (memcmp(header->magic, SCHEDULE_CACHE_MAGIC, sizeof(header->magic))
+            != 0 || header->version != SCHEDULE_CACHE_VERSION
+            || header->headerSize != sizeof(cacheHeader)
+            || header->actionSize != sizeof(cacheAction)
+            || header->entrySize != sizeof(cacheEntry)
+            || header->valueSize != sizeof(cacheValue)
+            || header->refSize != sizeof(cacheRef)) {
+        return False;
+    }
+    if (header->actionOffset % CACHE_ALIGN || header->entryOffset % CACHE_ALIGN
+            || header->valueOffset % CACHE_ALIGN
+            || header->refOffset % CACHE_ALIGN
+            || header->actionOffset + (uint64_t)header->actionCount
+                * sizeof(cacheAction) > length
+            || header->entryOffset + (uint64_t)header->entryCount
+                * sizeof(cacheEntry) > length
+            || header->valueOffset + (uint64_t)header->valueCount
+                * sizeof(cacheValue) > length
+            || header->refOffset + (uint64_t)header->refCount
+                * sizeof(cacheRef) > length
+            || header->stringSize == 0
+            || header->stringOffset + (uint64_t)header->stringSize > length
+            || addr[header->stringOffset + header->stringSize - 1] != '\0') {
+        return False;
+    }
+
+    actions = (const cacheAction *)(addr + header->actionOffset);
+    for (idx = 0; idx < header->actionCount; idx++) {
+        if (actions[idx].name >= header->stringSize
+                || actions[idx].command >= header->stringSize
+                || actions[idx].type < ON_DEMAND
+                || actions[idx].type >= PRIVATE) {
+            return False;
+        }
+    }
+    values = (const cacheValue *)(addr + header->valueOffset);
+    for (idx = 0; idx < header->valueCount; idx++) {
+        if (values[idx].type != WILDCARD && values[idx].type != SINGLE
+                && values[idx].type != RANGE) {
+            return False;
+        }
+    }
+    refs = (const cacheRef *)(addr + header->refOffset);
+    for (idx = 0; idx < header->refCount; idx++) {
+        if (refs[idx].action >= (int32_t)header->actionCount
+                || (refs[idx].action < 0
+                    && refs[idx].command >= header->stringSize)) {
+            return False;
+        }
+    }
+    entries = (const cacheEntry *)(addr + header->entryOffset);
+    for (idx = 0; idx < header->entryCount; idx++) {
+        if (entries[idx].task >= header->stringSize
+                || entries[idx].reminder >= header->stringSize
+                || entries[idx].firstRef > header->refCount
+                || entries[idx].refCount
+                    > header->refCount - entries[idx].firstRef) {
+            return False;
+        }
+        valueIdx = entries[idx].firstValue;
+        for (field = 0; field < NUMBER_OF_CAL_FIELDS; field++) {
+            if (entries[idx].valueCount[field] == 0) {
+                return False;
+            }
+            valueIdx += entries[idx].valueCount[field];
+        }
+        if (entries[idx].firstValue > header->valueCount
+                || valueIdx > header->valueCount) {
+            return False;
+        }
+    }
+    return True;
+}
+
+/**
+ * Add the actions and entries of a valid cache to the schedule.  Text of
+ * entries is used within the mapping.
+ */
+void loadCacheEntries(scheduleContext * ctx, const char * addr) {
+    const cacheHeader * header = (const cacheHeader *)addr;
+    const cacheAction * actions;
+    const cacheEntry * entries, * entry;
+    const cacheValue * values;
+    const cacheRef * refs, * ref;
+    valueStruct * fields[NUMBER_OF_CAL_FIELDS], * pool, * next;
+    actionDef ** defined, * action;
+    actionNode * actionSet;
+    calendarMask compiled;
+    char * strings;
+    uint32_t idx, field, valueIdx, refIdx;
+
+    actions = (const cacheAction *)(addr + header->actionOffset);
+    entries = (const cacheEntry *)(addr + header->entryOffset);
+    values = (const cacheValue *)(addr + header->valueOffset);
+    refs = (const cacheRef *)(addr + header->refOffset);
+    strings = (char *)addr + header->stringOffset;
+
+    // Entries refer to defined actions by index.
+    defined = malloc(sizeof(actionDef *) * (header->actionCount + 1));
+    assert(defined != NULL);
+    for (idx = 0; idx < header->actionCount; idx++) {
+        addActionCommand(ctx, strings + actions[idx].name,
+                strings + actions[idx].command, actions[idx].type);
+        defined[idx] = ctx->cmdTail->action;
+    }
+
+    // Values of an entry are built in pool, then copied by the entry.
+    pool = malloc(sizeof(valueStruct) * 2 * NUMBER_OF_CAL_FIELDS
+            * MAX_FIELD_VALUES);
+    assert(pool != NULL);
+    for (idx = 0; idx < header->entryCount; idx++) {
+        entry = &entries[idx];
+        next = pool;
+        valueIdx = entry->firstValue;
+        for (field = 0; field < NUMBER_OF_CAL_FIELDS; field++) {
+            fields[field] = buildCacheField(&values[valueIdx],
+                    entry->valueCount[field], next);
+            next += 2 * entry->valueCount[field];
+            valueIdx += entry->valueCount[field];
+        }
+
+        actionSet = NULL;
+        for (refIdx = 0; refIdx < entry->refCount; refIdx++) {
+            ref = &refs[entry->firstRef + refIdx];
+            if (ref->action >= 0) {
+                action = defined[ref->action];
+            }
+            else {
+                action = createPrivateAction(ctx, strings + ref->command);
+            }
+            if (actionSet == NULL) {
+                actionSet = createScheduleActionSet(ctx, action);
+            }
+            else {
+                addScheduleActionToSet(ctx, actionSet, action);
+            }
+        }
+
+        compiled.minute = entry->minute;
+        compiled.hour = entry->hour;
+        compiled.dayOfMonth = entry->dayOfMonth;
+        compiled.monOfYear = entry->monOfYear;
+        compiled.dayOfWeek = entry->dayOfWeek;
+        addCompiledScheduleEntry(ctx, fields[0], fields[1], fields[2],
+                fields[3], fields[4], fields[5], &compiled, entry->duration,
+                strings + entry->task, strings + entry->reminder, actionSet);
+    }
+    free(pool);
+    free(defined);
+}
+
+/**
+ * Build a calendar field from count cached values using at most 2 * count
+ * values of pool.  More than one value is built into a list as
+ * createListValue and addListValue do.
+ */
+valueStruct * buildCacheField(const cacheValue * values, int count,
+        valueStruct * pool) {
+    valueStruct * element, * node, * list = NULL, * tail = NULL;
+    int idx;
+
+    for (idx = 0; idx < count; idx++) {
+        element = pool++;
+        memset(element, 0, sizeof(valueStruct));
+        element->type = values[idx].type;
+        memcpy(element->range, values[idx].range, sizeof(element->range));
+        if (count == 1) {
+            return element;
+        }
+        node = pool++;
+        memset(node, 0, sizeof(valueStruct));
+        node->type = LIST;
+        node->listNode.element = element;
+        if (list == NULL) {
+            list = node;
+        }
+        else {
+            tail->listNode.next = node;
+        }
+        tail = node;
+    }
+    return list;
+}
+
+/**
+ * Record the new modification time of an unchanged schedule file, so it is
+ * not hashed again.  Failure only costs a hash on the next load.
+ */
+void refreshCacheHeader(const char * cacheName, cacheHeader * header,
+        struct stat * source) {
+    cacheHeader updated;
+    int fd;
+
+    fd = open(cacheName, O_WRONLY);
+    if (fd < 0) {
+        return;
+    }
+    updated = *header;
+    updated.sourceMtime = source->st_mtime;
+    updated.sourceMtimeNsec = MTIME_NSEC(source);
+    if (pwrite(fd, &updated, sizeof(cacheHeader), 0)
+            != sizeof(cacheHeader)) {
+        perror("Failed to update schedule cache: ");
+    }
+    close(fd);
+}
+
+/**
+ * Write the schedule to the cache.  The cache is written to a temporary
+ * file and renamed, so readers see the old or the new cache.
+ * Returns:
+ *  SUCCESS if written, ERROR if the schedule could not be cached.
+ */
+int writeScheduleCache(scheduleContext * ctx, const char * cacheName,
+        struct stat * source, uint64_t hash) {
+    recordBuffer actions, entries, values, refs;
+    stringTable strings;
+    cacheHeader header;
+    cacheAction * cached;
+    scheduleNode * node;
+    actionNode * cmd;
+    char tempName[PATH_MAX];
+    uint32_t position;
+    Bool written;
+    FILE * out;
+    int status = SUCCESS;
+
+    if (snprintf(tempName, sizeof(tempName), "%s.%d", cacheName,
+                (int)getpid()) >= (int)sizeof(tempName)) {
+        return ERROR;
+    }
+    initRecordBuffer(&actions, sizeof(cacheAction));
+    initRecordBuffer(&entries, sizeof(cacheEntry));
+    initRecordBuffer(&values, sizeof(cacheValue));
+    initRecordBuffer(&refs, sizeof(cacheRef));
+    initRecordBuffer(&strings.text, 1);
+    strings.slotCount = STRING_SLOTS;
+    strings.used = 0;
+    strings.slots = calloc(strings.slotCount, sizeof(uint32_t));
+    assert(strings.slots != NULL);
+
+    for (cmd = ctx->cmdHead; cmd != NULL; cmd = cmd->next) {
+        cached = addRecord(&actions);
+        cached->name = internString(&strings, cmd->action->name);
+        cached->command = internString(&strings, cmd->action->command);
+        cached->type = cmd->action->type;
+    }
+    for (node = ctx->schedHead; node != NULL && status == SUCCESS;
+            node = node->next) {
+        status = addCacheEntry(ctx, node->entry, &entries, &values, &refs,
+                &strings);
+    }
+    // The table always holds the empty string, so is never empty.
+    internString(&strings, "");
+
+    if (status == SUCCESS) {
+        memset(&header, 0, sizeof(cacheHeader));
+        memcpy(header.magic, SCHEDULE_CACHE_MAGIC, sizeof(header.magic));
+        header.version = SCHEDULE_CACHE_VERSION;
+        header.headerSize = sizeof(cacheHeader);
+        header.actionSize = sizeof(cacheAction);
+        header.entrySize = sizeof(cacheEntry);
+        header.valueSize = sizeof(cacheValue);
+        header.refSize = sizeof(cacheRef);
+        header.sourceMtime = source->st_mtime;
+        header.sourceMtimeNsec = MTIME_NSEC(source);
+        header.sourceSize = source->st_size;
+        header.sourceHash = hash;
+        header.actionCount = actions.count;
+        header.entryCount = entries.count;
+        header.valueCount = values.count;
+        header.refCount = refs.count;
+        header.stringSize = strings.text.count;
+
+        out = fopen(tempName, "wb");
+        if (out == NULL) {
+            status = ERROR;
+        }
+        else {
+            // Offsets are set as each section is written, then the header
+            // is written again.
+            position = sizeof(cacheHeader);
+            written = fwrite(&header, sizeof(cacheHeader), 1, out) == 1
+                && writeCacheSection(out, &actions, &header.actionOffset,
+                        &position)
+                && writeCacheSection(out, &entries, &header.entryOffset,
+                        &position)
+                && writeCacheSection(out, &values, &header.valueOffset,
+                        &position)
+                && writeCacheSection(out, &refs, &header.refOffset,
+                        &position)
+                && writeCacheSection(out, &strings.text,
+                        &header.stringOffset, &position)
+                && fseek(out, 0, SEEK_SET) == 0
+                && fwrite(&header, sizeof(cacheHeader), 1, out) == 1;
+            if (fclose(out) != 0 || written == False
+                    || rename(tempName, cacheName) != 0) {
+                perror("Failed to write schedule cache: ");
+                unlink(tempName);
+                status = ERROR;
+            }
+        }
+    }
+
+    freeRecordBuffer(&actions);
+    freeRecordBuffer(&entries);
+    freeRecordBuffer(&values);
+    freeRecordBuffer(&refs);
+    freeRecordBuffer(&strings.text);
+    free(strings.slots);
+    return status;
+}
+
+/**
+ * Add the entry, its calendar values and its actions to the cache records.
+ * Returns:
+ *  SUCCESS if added, ERROR if the entry cannot be cached.
+ */
+int addCacheEntry(scheduleContext * ctx, scheduleEntry * entry,
+        recordBuffer * entries, recordBuffer * values, recordBuffer * refs,
+        stringTable * strings) {
+    valueStruct * fields[NUMBER_OF_CAL_FIELDS];
+    cacheEntry * cached;
+    cacheRef * ref;
+    actionNode * node;
+    int field;
+
+    cached = addRecord(entries);
+    memset(cached, 0, sizeof(cacheEntry));
+    cached->minute = entry->compiled.minute;
+    cached->hour = entry->compiled.hour;
+    cached->dayOfMonth = entry->compiled.dayOfMonth;
+    cached->monOfYear = entry->compiled.monOfYear;
+    cached->dayOfWeek = entry->compiled.dayOfWeek;
+    cached->duration = entry->durationInMin;
+    cached->task = internString(strings, entry->task);
+    cached->reminder = internString(strings, entry->reminderMessage);
+
+    fields[0] = &entry->year;
+    fields[1] = &entry->monOfYear;
+    fields[2] = &entry->dayOfMonth;
+    fields[3] = &entry->dayOfWeek;
+    fields[4] = &entry->hour;
+    fields[5] = &entry->minute;
+    cached->firstValue = values->count;
+    for (field = 0; field < NUMBER_OF_CAL_FIELDS; field++) {
+        if (addCacheField(values, fields[field], &cached->valueCount[field])
+                == ERROR) {
+            return ERROR;
+        }
+    }
+
+    cached->firstRef = refs->count;
+    for (node = entry->actionSet; node != NULL; node = node->next) {
+        if (node->action == NULL) {
+            continue;
+        }
+        ref = addRecord(refs);
+        if (node->action->type == PRIVATE) {
+            ref->action = -1;
+            ref->command = internString(strings, node->action->command);
+        }
+        else if ((ref->action = findActionIndex(ctx, node->action)) < 0) {
+            return ERROR;
+        }
+        else {
+            ref->command = 0;
+        }
+        cached->refCount++;
+    }
+    return SUCCESS;
+}
+
+/**
+ * Add the values of a calendar field, setting count to the number added.
+ */
+int addCacheField(recordBuffer * values, valueStruct * value,
+        uint8_t * count) {
+    valueStruct * element;
+    cacheValue * cached;
+    int added = 0;
+
+    do {
+        element = value->type == LIST ? value->listNode.element : value;
+        if (added == MAX_FIELD_VALUES || element->type == LIST) {
+            return ERROR;
+        }
+        cached = addRecord(values);
+        cached->type = element->type;
+        memcpy(cached->range, element->range, sizeof(cached->range));
+        added++;
+        value = value->type == LIST ? value->listNode.next : NULL;
+    } while (value != NULL);
+    *count = added;
+    return SUCCESS;
+}
+
+/**
+ * Return the position of the action within the defined actions, -1 if it
+ * is not defined.
+ */
+int findActionIndex(scheduleContext * ctx, actionDef * action) {
+    actionNode * cmd;
+    int idx = 0;
+
+    for (cmd = ctx->cmdHead; cmd != NULL; cmd = cmd->next, idx++) {
+        if (cmd->action == action) {
+            return idx;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Pad to the section alignment and write the records of buffer, setting
+ * offset to where they start.
+ */
+Bool writeCacheSection(FILE * out, recordBuffer * buffer, uint32_t * offset,
+        uint32_t * position) {
+    static const char padding[CACHE_ALIGN];
+    size_t size, padLength;
+
+    padLength = (CACHE_ALIGN - *position % CACHE_ALIGN) % CACHE_ALIGN;
+    size = buffer->count * buffer->recordSize;
+    if ((uint64_t)*position + padLength + size > UINT32_MAX
+            || fwrite(padding, 1, padLength, out) != padLength
+            || fwrite(buffer->data, 1, size, out) != size) {
+        return False;
+    }
+    *offset = *position + padLength;
+    *position = *offset + size;
+    return True;
+}
+
+Bool hashScheduleFile(int fd, size_t size, uint64_t * hash) {
+    char * addr;
+
+    *hash = FNV_OFFSET_BASIS;
+    if (size == 0) {
+        return True;
+    }
+    addr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+        return False;
+    }
+    *hash = hashBytes(*hash, addr, size);
+    munmap(addr, size);
+    return True;
+}
+
+/**
+ * FNV-1a hash of the data continuing from hash.
+ */
+uint64_t hashBytes(uint64_t hash, const char * data, size_t length) {
+    size_t idx;
+
+    for (idx = 0; idx < length; idx++) {
+        hash ^= (unsigned char)data[idx];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+void initRecordBuffer(recordBuffer * buffer, size_t recordSize) {
+    buffer->data = NULL;
+    buffer->count = 0;
+    buffer->capacity = 0;
+    buffer->recordSize = recordSize;
+}
+
+/**
+ * Return a new record at the end of the buffer.  Records previously
+ * returned may move.
+ */
+void * addRecord(recordBuffer * buffer) {
+    if (buffer->count == buffer->capacity) {
+        buffer->capacity = buffer->capacity == 0 ? 64 : buffer->capacity * 2;
+        buffer->data = realloc(buffer->data,
+                buffer->capacity * buffer->recordSize);
+        assert(buffer->data != NULL);
+    }
+    return buffer->data + buffer->recordSize * buffer->count++;
+}
+
+void freeRecordBuffer(recordBuffer * buffer) {
+    free(buffer->data);
+    initRecordBuffer(buffer, buffer->recordSize);
+}
+
+/**
+ * Return the offset of the string within the table, adding it if it is not
+ * already held.
+ */
+uint32_t internString(stringTable * table, const char * str) {
+    uint32_t * oldSlots, oldCount, slot, idx, offset;
+    size_t length;
+    char * copy;
+
+    if (table->used * 2 >= table->slotCount) {
+        // Grow and rehash, keeping at most half of the slots in use.
+        oldSlots = table->slots;
+        oldCount = table->slotCount;
+        table->slotCount *= 2;
+        table->slots = calloc(table->slotCount, sizeof(uint32_t));
+        assert(table->slots != NULL);
+        for (idx = 0; idx < oldCount; idx++) {
+            if (oldSlots[idx] == 0) {
+                continue;
+            }
+            slot = hashBytes(FNV_OFFSET_BASIS,
+                    table->text.data + oldSlots[idx] - 1,
+                    strlen(table->text.data + oldSlots[idx] - 1))
+                & (table->slotCount - 1);
+            while (table->slots[slot] != 0) {
+                slot = (slot + 1) & (table->slotCount - 1);
+            }
+            table->slots[slot] = oldSlots[idx];
+        }
+        free(oldSlots);
+    }
+
+    length = strlen(str);
+    slot = hashBytes(FNV_OFFSET_BASIS, str, length) & (table->slotCount - 1);
+    while (table->slots[slot] != 0) {
+        if (strcmp(table->text.data + table->slots[slot] - 1, str) == 0) {
+            return table->slots[slot] - 1;
+        }
+        slot = (slot + 1) & (table->slotCount - 1);
+    }
+
+    offset = table->text.count;
+    for (idx = 0; idx <= length; idx++) {
+        copy = addRecord(&table->text);
+        *copy = str[idx];
+    }
+    table->slots[slot] = offset + 1;
+    table->used++;
+    return offset;
+}
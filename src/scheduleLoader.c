@@ -0,0 +1,471 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include <assert.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "schedule.h"
+#include "scheduleLoader.h"
+
+#define SUCCESS 0
+#define ERROR 1
+// Calendar values, including list nodes, allowed within a single entry
+#define MAX_LINE_VALUES 512
+// Longest action name including the # and null term
+#define MAX_ACTION_NAME 128
+// Number of calendar fields of an entry
+#define NUMBER_OF_CAL_FIELDS 6
+
+/* -----------------------------------------------------------------------------
+ *  Internal Structures
+ * ---------------------------------------------------------------------------*/
+
+/**
+ * Position of the scanner within the mapped file.  Calendar values of the
+ * current line are built in values, as the entry copies them when created.
+ */
+typedef struct _mapScanner {
+    char * pos;                 // Next character of the current line
+    char * lineEnd;             // End of the line less trailing white space
+    int lineNo;
+    valueStruct values[MAX_LINE_VALUES];
+    int valueCount;
+} mapScanner;
+
+/* -----------------------------------------------------------------------------
+ *  Prototypes
+ * ---------------------------------------------------------------------------*/
+int parseMappedLine(scheduleContext * ctx, mapScanner * scan);
+int parseMappedAction(scheduleContext * ctx, mapScanner * scan);
+int parseMappedTask(scheduleContext * ctx, mapScanner * scan);
+int scanTaskAction(scheduleContext * ctx, mapScanner * scan,
+        actionNode ** actionSet);
+int scanCalEntry(mapScanner * scan, valueStruct ** entry);
+int scanCalValue(mapScanner * scan, valueStruct ** value);
+valueStruct * nextLineValue(mapScanner * scan);
+Bool scanNumber(mapScanner * scan, int * number);
+Bool scanSeparator(mapScanner * scan);
+Bool scanActionName(mapScanner * scan, char * name);
+char * scanQuotedText(mapScanner * scan);
+void mappedError(mapScanner * scan, const char * msg);
+
+/* -----------------------------------------------------------------------------
+ *  Function definitions.
+ * ---------------------------------------------------------------------------*/
+
+int loadScheduleFile(scheduleContext * ctx, const char * fileName,
+        enum ParserType parser) {
+    FILE * file;
+
+	file = fopen(fileName, "r");
+    if (file == NULL) {
+    	perror("Failed to open input file: ");
+    	return ERROR;
+    }
+    if (parser == PARSER_MAPPED) {
+        parseMappedScheduleFile(ctx, file);
+    }
+    else {
+        parseScheduleFile(ctx, file);
+    }
+    fclose(file);
+    return SUCCESS;
+}
+
+int parseMappedScheduleFile(scheduleContext * ctx, FILE * file) {
+    struct stat fileStat;
+    mappedFile * mapped;
+    mapScanner scan;
+    char * addr, * end, * next;
+    int status = SUCCESS;
+
+    if (fstat(fileno(file), &fileStat) != 0) {
+        perror("Failed to read schedule file: ");
+        return ERROR;
+    }
+    if (fileStat.st_size == 0) {
+        return SUCCESS;
+    }
+    // Writes stay within the private mapping, so the file is not changed.
+    addr = mmap(NULL, fileStat.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+            fileno(file), 0);
+    if (addr == MAP_FAILED) {
+        perror("Failed to map schedule file: ");
+        return ERROR;
+    }
+    madvise(addr, fileStat.st_size, MADV_SEQUENTIAL);
+
+    mapped = (mappedFile*)malloc(sizeof(mappedFile));
+    assert(mapped != NULL);
+    mapped->addr = addr;
+    mapped->length = fileStat.st_size;
+    mapped->next = ctx->mappedFiles;
+    ctx->mappedFiles = mapped;
+
+    end = addr + fileStat.st_size;
+    scan.lineNo = 0;
+    for (scan.pos = addr; status == SUCCESS && scan.pos < end;
+            scan.pos = next) {
+        scan.lineEnd = memchr(scan.pos, '\n', end - scan.pos);
+        if (scan.lineEnd == NULL) {
+            scan.lineEnd = end;
+        }
+        next = scan.lineEnd + 1;
+        while (scan.lineEnd > scan.pos
+                && isspace((unsigned char)scan.lineEnd[-1])) {
+            scan.lineEnd--;
+        }
+        scan.lineNo++;
+        scan.valueCount = 0;
+        status = parseMappedLine(ctx, &scan);
+    }
+    return status;
+}
+
+void freeMappedFiles(mappedFile * file) {
+    mappedFile * next;
+
+    for (; file != NULL; file = next) {
+        next = file->next;
+        munmap(file->addr, file->length);
+        free(file);
+    }
+}
+
+/**
+ * Parse a single line: a comment, an action definition or a task entry.
+ * Blank lines are skipped.
+ */
+int parseMappedLine(scheduleContext * ctx, mapScanner * scan) {
+    char first;
+
+    if (scan->pos == scan->lineEnd) {
+        return SUCCESS;
+    }
+    first = scan->pos[0];
+    if (first == '/' && scan->lineEnd - scan->pos > 1 && scan->pos[1] == '/') {
+        return SUCCESS;
+    }
+    if (first == '#') {
+        return parseMappedAction(ctx, scan);
+    }
+    if (first == '*' || isdigit((unsigned char)first)) {
+        return parseMappedTask(ctx, scan);
+    }
+    mappedError(scan, "Invalid start of schedule entry");
+    return ERROR;
+}
+
+/**
+ * Parse an action definition: #name "command" A|D|O
+ */
+int parseMappedAction(scheduleContext * ctx, mapScanner * scan) {
+    char name[MAX_ACTION_NAME];
+    char * command;
+    enum ActionType type;
+
+    if (scanActionName(scan, name) == False || scanSeparator(scan) == False
+            || (command = scanQuotedText(scan)) == NULL
+            || scanSeparator(scan) == False
+            || scan->lineEnd - scan->pos != 1) {
+        mappedError(scan, "Invalid action definition");
+        return ERROR;
+    }
+    switch (scan->pos[0]) {
+        case 'A':
+            type = ALWAYS;
+            break;
+        case 'D':
+            type = DEFAULT;
+            break;
+        case 'O':
+            type = ON_DEMAND;
+            break;
+        default:
+            mappedError(scan, "Invalid Action Type: Must be A|D|O");
+            return ERROR;
+    }
+    addActionCommand(ctx, name, command, type);
+    return SUCCESS;
+}
+
+/**
+ * Parse a task entry: six calendar values, the duration, task and reminder
+ * text, then an optional set of actions.
+ */
+int parseMappedTask(scheduleContext * ctx, mapScanner * scan) {
+    valueStruct * fields[NUMBER_OF_CAL_FIELDS];
+    actionNode * actionSet = NULL;
+    char * task, * reminder;
+    int idx, duration;
+
+    for (idx = 0; idx < NUMBER_OF_CAL_FIELDS; idx++) {
+        if ((idx > 0 && scanSeparator(scan) == False)
+                || scanCalEntry(scan, &fields[idx]) == ERROR) {
+            mappedError(scan, "Invalid value for calendar task entry");
+            return ERROR;
+        }
+    }
+    if (scanSeparator(scan) == False || scanNumber(scan, &duration) == False
+            || scanSeparator(scan) == False
+            || (task = scanQuotedText(scan)) == NULL
+            || scanSeparator(scan) == False
+            || (reminder = scanQuotedText(scan)) == NULL) {
+        mappedError(scan, "Invalid task entry");
+        return ERROR;
+    }
+    while (scanSeparator(scan) == True) {
+        if (scanTaskAction(ctx, scan, &actionSet) == ERROR) {
+            freeActionSet(actionSet);
+            return ERROR;
+        }
+    }
+    if (scan->pos != scan->lineEnd) {
+        mappedError(scan, "Invalid task entry");
+        freeActionSet(actionSet);
+        return ERROR;
+    }
+    return addScheduleEntryShared(ctx, fields[0], fields[1], fields[2],
+            fields[3], fields[4], fields[5], duration, task, reminder,
+            actionSet);
+}
+
+/**
+ * Add the next action of a task to the action set: either the name of a
+ * defined action or quoted text for a private action.  Names that are not
+ * defined are an error, as the entry would otherwise run the defaults.
+ */
+int scanTaskAction(scheduleContext * ctx, mapScanner * scan,
+        actionNode ** actionSet) {
+    char name[MAX_ACTION_NAME];
+    char * command;
+    actionDef * action;
+
+    if (scan->pos[0] == '#') {
+        if (scanActionName(scan, name) == False) {
+            mappedError(scan, "Invalid action name");
+            return ERROR;
+        }
+        action = findActionCommand(ctx, name);
+        if (action == NULL) {
+            mappedError(scan,
+                    "Action not found.  Must be defined prior to use.");
+            return ERROR;
+        }
+    }
+    else if ((command = scanQuotedText(scan)) != NULL) {
+        action = createPrivateAction(ctx, command);
+    }
+    else {
+        mappedError(scan, "Invalid task action");
+        return ERROR;
+    }
+
+    if (*actionSet == NULL) {
+        *actionSet = createScheduleActionSet(ctx, action);
+    }
+    else {
+        addScheduleActionToSet(ctx, *actionSet, action);
+    }
+    return SUCCESS;
+}
+
+/**
+ * Scan a calendar value or a comma separated list of calendar values.
+ */
+int scanCalEntry(mapScanner * scan, valueStruct ** entry) {
+    valueStruct * value, * list, * tail, * node;
+
+    if (scanCalValue(scan, &value) == ERROR) {
+        return ERROR;
+    }
+    if (scan->pos == scan->lineEnd || scan->pos[0] != ',') {
+        *entry = value;
+        return SUCCESS;
+    }
+
+    // Same shape as createListValue and addListValue: each node holds an
+    // element and the next node.
+    for (list = tail = NULL; ; tail = node) {
+        if ((node = nextLineValue(scan)) == NULL) {
+            return ERROR;
+        }
+        node->type = LIST;
+        node->listNode.element = value;
+        if (list == NULL) {
+            list = node;
+        }
+        else {
+            tail->listNode.next = node;
+        }
+        if (scan->pos == scan->lineEnd || scan->pos[0] != ',') {
+            break;
+        }
+        scan->pos++;
+        if (scanCalValue(scan, &value) == ERROR) {
+            return ERROR;
+        }
+    }
+    *entry = list;
+    return SUCCESS;
+}
+
+/**
+ * Scan a single value, range with optional interval or wildcard.
+ */
+int scanCalValue(mapScanner * scan, valueStruct ** value) {
+    int begin, end, step = 1;
+
+    if ((*value = nextLineValue(scan)) == NULL) {
+        return ERROR;
+    }
+    if (scan->pos < scan->lineEnd && scan->pos[0] == '*') {
+        scan->pos++;
+        (*value)->type = WILDCARD;
+        (*value)->value = -1;
+        return SUCCESS;
+    }
+    if (scanNumber(scan, &begin) == False) {
+        return ERROR;
+    }
+    if (scan->pos == scan->lineEnd || scan->pos[0] != '-') {
+        (*value)->type = SINGLE;
+        (*value)->value = begin;
+        return SUCCESS;
+    }
+    scan->pos++;
+    if (scanNumber(scan, &end) == False) {
+        return ERROR;
+    }
+    if (scan->pos < scan->lineEnd && scan->pos[0] == '/') {
+        scan->pos++;
+        if (scanNumber(scan, &step) == False) {
+            return ERROR;
+        }
+    }
+    (*value)->type = RANGE;
+    (*value)->range[0] = begin;
+    (*value)->range[1] = end;
+    (*value)->range[2] = step;
+    return SUCCESS;
+}
+
+/**
+ * Return the next unused value of the line, cleared.  NULL if all used.
+ */
+valueStruct * nextLineValue(mapScanner * scan) {
+    valueStruct * value;
+
+    if (scan->valueCount == MAX_LINE_VALUES) {
+        return NULL;
+    }
+    value = &scan->values[scan->valueCount++];
+    memset(value, 0, sizeof(valueStruct));
+    return value;
+}
+
+Bool scanNumber(mapScanner * scan, int * number) {
+    char * start = scan->pos;
+
+    *number = 0;
+    while (scan->pos < scan->lineEnd
+            && isdigit((unsigned char)scan->pos[0])) {
+        if (*number > (INT_MAX - 9) / 10) {
+            return False;
+        }
+        *number = *number * 10 + (scan->pos[0] - '0');
+        scan->pos++;
+    }
+    return scan->pos > start ? True : False;
+}
+
+/**
+ * Skip one or more spaces or tabs.
+ */
+Bool scanSeparator(mapScanner * scan) {
+    char * start = scan->pos;
+
+    while (scan->pos < scan->lineEnd
+            && (scan->pos[0] == ' ' || scan->pos[0] == '\t')) {
+        scan->pos++;
+    }
+    return scan->pos > start ? True : False;
+}
+
+/**
+ * Copy the action name at the current position, including the #, to name.
+ * Names are short and only used for lookup, so they are copied rather than
+ * terminated in place.
+ */
+Bool scanActionName(mapScanner * scan, char * name) {
+    char * start = scan->pos;
+    int length;
+
+    if (scan->pos == scan->lineEnd || scan->pos[0] != '#') {
+        return False;
+    }
+    scan->pos++;
+    if (scan->pos == scan->lineEnd
+            || !isalnum((unsigned char)scan->pos[0])) {
+        return False;
+    }
+    while (scan->pos < scan->lineEnd && (isalnum((unsigned char)scan->pos[0])
+                || scan->pos[0] == '_' || scan->pos[0] == '-')) {
+        scan->pos++;
+    }
+    length = scan->pos - start;
+    if (length >= MAX_ACTION_NAME) {
+        return False;
+    }
+    memcpy(name, start, length);
+    name[length] = '\0';
+    return True;
+}
+
+/**
+ * Terminate the quoted text at the current position in place and return it
+ * without its quotes.  A quote preceded by a backslash is part of the text
+ * and, only if one is found, the text is rewritten without the backslashes.
+ * Returns:
+ *  The text within the mapping, NULL if not quoted text or not terminated on
+ *  the same line.
+ */
+char * scanQuotedText(mapScanner * scan) {
+    char * text, * quote, * from, * to;
+    Bool escaped = False;
+
+    if (scan->pos == scan->lineEnd || scan->pos[0] != '"') {
+        return NULL;
+    }
+    text = scan->pos + 1;
+    for (quote = text; quote < scan->lineEnd; quote++) {
+        if (quote[0] == '"') {
+            if (quote[-1] != '\\') {
+                break;
+            }
+            escaped = True;
+        }
+    }
+    if (quote == scan->lineEnd) {
+        return NULL;
+    }
+    *quote = '\0';
+    scan->pos = quote + 1;
+
+    if (escaped == True) {
+        for (from = to = text; *from != '\0'; from++, to++) {
+            if (from[0] == '\\' && from[1] == '"') {
+                from++;
+            }
+            *to = *from;
+        }
+        *to = '\0';
+    }
+    return text;
+}
+
+void mappedError(mapScanner * scan, const char * msg) {
+    printf("line: %d: %s\n", scan->lineNo, msg);
+}
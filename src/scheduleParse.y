@@ -19,11 +19,20 @@ taskAction = NULL | #actionName | "action"
 #include <string.h>
 #include "schedule.h"
 
-valueStruct * listVal;
-actionNode * actionSetRoot;
+void scanError(void * scanner, char *s);
 
 %}
+%code requires {
+#include "schedule.h"
+}
+%code {
+int yylex(YYSTYPE * lvalp, void * scanner);
+void yyerror(scheduleContext * ctx, void * scanner, char *s);
+}
 %debug
+%define api.pure full
+%parse-param {scheduleContext * ctx} {void * scanner}
+%lex-param {void * scanner}
 
 %union {
     int   intVal;
@@ -62,7 +71,7 @@ comment : COMMENT {printf("Comment: %s\n", $1);fflush(stdout);}
 
 defined_action : ACTION ' ' QTEXT ' ' ACT_EXEC_TYPE 
     {
-        addActionCommand($1, $3, $5); 
+        addActionCommand(ctx, $1, $3, $5); 
         free($1);
         free($3);
     }
@@ -70,7 +79,8 @@ defined_action : ACTION ' ' QTEXT ' ' ACT_EXEC_TYPE
 
 task :   calEntry ' ' calEntry ' ' calEntry ' ' calEntry ' ' calEntry ' ' calEntry ' ' NUM ' ' QTEXT ' ' QTEXT
      { 
-        addScheduleEntryNormalize($1, $3, $5, $7, $9, $11, $13, $15, $17, NULL); 
+        addScheduleEntryNormalize(ctx, $1, $3, $5, $7, $9, $11, $13, $15, $17, 
+                NULL); 
         freeValueStruct($1); 
         freeValueStruct($3); 
         freeValueStruct($5); 
@@ -82,7 +92,8 @@ task :   calEntry ' ' calEntry ' ' calEntry ' ' calEntry ' ' calEntry ' ' calEnt
      }
      |   calEntry ' ' calEntry ' ' calEntry ' ' calEntry ' ' calEntry ' ' calEntry ' ' NUM ' ' QTEXT ' ' QTEXT ' ' actionSet
      { 
-        addScheduleEntryNormalize($1, $3, $5, $7, $9, $11, $13, $15, $17, $19); 
+        addScheduleEntryNormalize(ctx, $1, $3, $5, $7, $9, $11, $13, $15, $17, 
+                $19); 
         freeValueStruct($1); 
         freeValueStruct($3); 
         freeValueStruct($5); 
@@ -115,46 +126,52 @@ wildcard : ANY  { $$ = createWildcardValue(); }
          ;
 
 list : calValue ',' calValue { 
-        listVal = createListValue($1); 
-        addListValue(listVal, $3);
-        $$ = listVal
+        $$ = createListValue($1); 
+        addListValue($$, $3);
      } 
-     | list ',' calValue { addListValue(listVal, $3); } 
+     | list ',' calValue { addListValue($1, $3); $$ = $1; } 
      ;
 
 taskAction : ACTION 
            {    
-                $$ = findActionCommand($1);
+                $$ = findActionCommand(ctx, $1);
+                free($1);
                 if ($$ == NULL) {
-                    yyerror("Action not found.  Must be defined prior to use.");
+                    yyerror(ctx, scanner, 
+                        "Action not found.  Must be defined prior to use.");
+                    YYERROR;
                 }
-                free($1);
            }
            | QTEXT 
            {
-                $$ = createActionCommand("private", $1, PRIVATE); 
+                $$ = createPrivateAction(ctx, $1); 
                 free($1);
            }
            ;
 
 actionSet : taskAction 
           {
-            actionSetRoot = createActionSet($1); 
-            $$ = actionSetRoot;
+            $$ = createScheduleActionSet(ctx, $1); 
           }
           | actionSet ' ' taskAction
           {
-            addActionToActionSet($1, $3)
+            addScheduleActionToSet(ctx, $1, $3);
           }
           ; 
 
 %% 
+void yyerror(scheduleContext * ctx, void * scanner, char *s) {
+    (void)ctx;
+    scanError(scanner, s);
+}
+
 #ifdef STANDALONE
 int main() {
+scheduleContext * ctx = createScheduleContext();
 puts("Hello");
 yydebug=1;
-yyparse();
-
+parseScheduleFile(ctx, stdin);
+freeScheduleContext(ctx);
 }
 
 
@@ -0,0 +1,656 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+#include "schedule.h"
+#include "executor.h"
+#include "scheduleLoader.h"
+#include "scheduleReload.h"
+#include "scheduleArena.h"
+#include "entryStore.h"
+#include "stringPool.h"
+
+#define SUCCESS 0
+#define ERROR 1
+// Fewest slots of the table matching entries.  Power of 2.
+#define MIN_RELOAD_SLOTS 16
+// Most strings per entry the pool may hold before a reload rebuilds it.
+#define MAX_POOL_STRINGS_PER_ENTRY 4
+
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+/* -----------------------------------------------------------------------------
+ *  Internal Structures
+ * ---------------------------------------------------------------------------*/
+
+/**
+ * Slot of the table of entries held by the schedule before a reload.  Open
+ * addressing on contentHash.  Matched entries stay in the table, so probing
+ * continues past them.
+ */
+typedef struct _reloadSlot {
+    scheduleEntry * entry;      // NULL if the slot is empty
+    Bool matched;
+} reloadSlot;
+
+/**
+ * Action defined by the fresh schedule and the action kept for it: the
+ * matching action of the schedule, or if none, the fresh action itself.
+ */
+typedef struct _actionMatch {
+    actionDef * fresh;
+    actionDef * kept;
+} actionMatch;
+
+/* -----------------------------------------------------------------------------
+ *  Prototypes
+ * ---------------------------------------------------------------------------*/
+uint64_t hashContent(uint64_t hash, const void * data, size_t length);
+uint64_t hashString(uint64_t hash, const char * str);
+uint64_t hashValueStruct(uint64_t hash, valueStruct * value);
+Bool sameString(const char * str1, const char * str2);
+Bool sameValueStruct(valueStruct * value1, valueStruct * value2);
+Bool sameAction(actionDef * action1, actionDef * action2);
+Bool sameScheduleEntry(scheduleEntry * entry1, scheduleEntry * entry2);
+reloadSlot * buildReloadTable(scheduleContext * ctx, uint32_t * slotCount);
+scheduleEntry * takeMatchingEntry(reloadSlot * slots, uint32_t slotCount,
+        scheduleEntry * entry);
+actionMatch * matchActions(scheduleContext * ctx, scheduleContext * fresh,
+        int * matchCount);
+Bool isKeptAction(actionMatch * matches, int matchCount, actionDef * action);
+actionDef * keptAction(actionMatch * matches, int matchCount,
+        actionDef * action);
+void remapActionSet(actionNode * actionSet, actionMatch * matches,
+        int matchCount);
+void dropStaleRendered(scheduleEntry * entry, actionMatch * matches,
+        int matchCount);
+void compactStringPool(scheduleContext * ctx);
+void adoptGenerations(scheduleContext * ctx, scheduleContext * fresh);
+
+/* -----------------------------------------------------------------------------
+ *  Function definitions.
+ * ---------------------------------------------------------------------------*/
+
+uint64_t hashScheduleEntry(scheduleEntry * entry) {
+    uint64_t hash = FNV_OFFSET_BASIS;
+    actionNode * node;
+
+    if (entry->contentHash != 0) {
+        return entry->contentHash;
+    }
+    hash = hashValueStruct(hash, &entry->year);
+    hash = hashValueStruct(hash, &entry->monOfYear);
+    hash = hashValueStruct(hash, &entry->dayOfMonth);
+    hash = hashValueStruct(hash, &entry->dayOfWeek);
+    hash = hashValueStruct(hash, &entry->hour);
+    hash = hashValueStruct(hash, &entry->minute);
+    hash = hashContent(hash, &entry->durationInMin,
+            sizeof(entry->durationInMin));
+    hash = hashString(hash, entry->task);
+    hash = hashString(hash, entry->reminderMessage);
+    for (node = entry->actionSet; node != NULL; node = node->next) {
+        if (node->action == NULL) {
+            continue;
+        }
+        hash = hashContent(hash, &node->action->type,
+                sizeof(node->action->type));
+        if (node->action->type != PRIVATE) {
+            hash = hashString(hash, node->action->name);
+        }
+        hash = hashString(hash, node->action->command);
+    }
+    // 0 is reserved for a hash that has not been calculated.
+    entry->contentHash = hash != 0 ? hash : 1;
+    return entry->contentHash;
+}
+
+void applyScheduleReload(scheduleContext * ctx, scheduleContext * fresh,
+        reloadStats * stats) {
+    reloadStats counts;
+    reloadSlot * slots;
+    actionMatch * matches;
+    actionNode * oldActions, * cmd, * nextCmd;
+    scheduleNode * node;
+    scheduleEntry * kept;
+    uint32_t slotCount, idx;
+    int matchCount, match;
+    Bool actionsChanged = False;
+
+    memset(&counts, 0, sizeof(counts));
+
+    // The fresh action list becomes the action list of the schedule,
+    // holding the kept action for each.
+    matches = matchActions(ctx, fresh, &matchCount);
+    oldActions = ctx->cmdHead;
+    ctx->cmdHead = fresh->cmdHead;
+    ctx->cmdTail = fresh->cmdTail;
+    fresh->cmdHead = fresh->cmdTail = NULL;
+    for (cmd = ctx->cmdHead, match = 0; cmd != NULL;
+            cmd = cmd->next, match++) {
+        cmd->action = matches[match].kept;
+    }
+    rebuildActionIndex(ctx);
+    for (cmd = oldActions; cmd != NULL; cmd = cmd->next) {
+        if (isKeptAction(matches, matchCount, cmd->action) == False) {
+            actionsChanged = True;
+        }
+    }
+
+    // Keep the schedule copy of each unchanged entry.  Only added entries
+    // are placed in the alarm queue or wheel.
+    slots = buildReloadTable(ctx, &slotCount);
+    for (node = fresh->schedHead; node != NULL; node = node->next) {
+        kept = takeMatchingEntry(slots, slotCount, node->entry);
+        if (kept != NULL) {
+            freeActionSet(node->entry->actionSet);
+            freeScheduleEntry(node->entry);
+            node->entry = kept;
+            counts.unchanged++;
+        }
+        else {
+            remapActionSet(node->entry->actionSet, matches, matchCount);
+            // The pool and mapping of fresh are freed after the reload.
+            internEntryText(ctx, node->entry, node->entry->task,
+                    node->entry->reminderMessage, False);
+            addEntryAlarm(ctx, node->entry);
+            counts.added++;
+        }
+    }
+    for (idx = 0; idx < slotCount; idx++) {
+        if (slots[idx].entry != NULL && slots[idx].matched == False) {
+            removeEntryAlarm(ctx, slots[idx].entry);
+            removeStoreEntry(ctx->store, slots[idx].entry);
+            freeActionSet(slots[idx].entry->actionSet);
+            freeScheduleEntry(slots[idx].entry);
+            counts.removed++;
+        }
+    }
+    free(slots);
+
+    // The old list nodes are left to their generation.
+    ctx->schedHead = fresh->schedHead;
+    ctx->schedTail = fresh->schedTail;
+    ctx->scheduleCount = fresh->scheduleCount;
+    fresh->schedHead = fresh->schedTail = NULL;
+    fresh->scheduleCount = 0;
+    // Added entries take the IDs of removed entries.  Kept entries keep
+    // their IDs but take their position within the fresh list.
+    for (node = ctx->schedHead, idx = 0; node != NULL; 
+            node = node->next, idx++) {
+        node->entry->listPos = idx;
+        storeScheduleEntry(ctx, node->entry);
+    }
+    compactStringPool(ctx);
+
+    // Kept entries may refer to, or have rendered, an action about to be
+    // freed.  Only happens when action definitions change.
+    if (actionsChanged == True) {
+        for (node = ctx->schedHead; node != NULL; node = node->next) {
+            remapActionSet(node->entry->actionSet, matches, matchCount);
+            dropStaleRendered(node->entry, matches, matchCount);
+        }
+    }
+    for (cmd = oldActions; cmd != NULL; cmd = nextCmd) {
+        nextCmd = cmd->next;
+        if (isKeptAction(matches, matchCount, cmd->action) == False) {
+            freeActionDef(cmd->action);
+        }
+        if (cmd->arena == NULL) {
+            free(cmd);
+        }
+    }
+    for (match = 0; match < matchCount; match++) {
+        if (matches[match].fresh != matches[match].kept) {
+            freeActionDef(matches[match].fresh);
+        }
+    }
+    free(matches);
+    adoptGenerations(ctx, fresh);
+
+    if (stats != NULL) {
+        *stats = counts;
+    }
+}
+
+int reloadScheduleFile(scheduleContext * ctx, const char * fileName,
+        enum ParserType parser, reloadStats * stats) {
+    scheduleContext * fresh;
+    FILE * file;
+    int status;
+
+	file = fopen(fileName, "r");
+    if (file == NULL) {
+    	perror("Failed to open input file: ");
+    	return ERROR;
+    }
+    fresh = createScheduleContext();
+    if (parser == PARSER_MAPPED) {
+        status = parseMappedScheduleFile(fresh, file);
+    }
+    else {
+        status = parseScheduleFile(fresh, file);
+    }
+    fclose(file);
+    // Entries after the error would be removed, so keep the schedule.
+    if (status != 0) {
+        fprintf(stderr, "Errors in %s.  Schedule not reloaded.\n", fileName);
+        freeScheduleContext(fresh);
+        return ERROR;
+    }
+
+    drainExecutors();
+    applyScheduleReload(ctx, fresh, stats);
+    freeScheduleContext(fresh);
+    return SUCCESS;
+}
+
+int watchScheduleFile(scheduleContext * ctx, const char * fileName,
+        enum ParserType parser) {
+#ifdef __linux__
+    scheduleWatch * watch;
+    const char * slash;
+    char * dirName;
+
+    watch = malloc(sizeof(scheduleWatch));
+    assert(watch != NULL);
+    memset(watch, 0, sizeof(scheduleWatch));
+    watch->parser = parser;
+    watch->fileName = strdup(fileName);
+    assert(watch->fileName != NULL);
+
+    slash = strrchr(fileName, '/');
+    if (slash == NULL) {
+        dirName = strdup(".");
+        watch->baseName = strdup(fileName);
+    }
+    else {
+        dirName = strndup(fileName, slash == fileName ? 1 : slash - fileName);
+        watch->baseName = strdup(slash + 1);
+    }
+    assert(dirName != NULL && watch->baseName != NULL);
+
+    watch->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watch->fd < 0) {
+        perror("inotify_init1 failed");
+        free(dirName);
+        freeScheduleWatch(watch);
+        return ERROR;
+    }
+    // Editors commonly write a new file and rename it over the old one.
+    watch->watch = inotify_add_watch(watch->fd, dirName,
+            IN_CLOSE_WRITE | IN_MOVED_TO);
+    free(dirName);
+    if (watch->watch < 0) {
+        perror("inotify_add_watch failed");
+        freeScheduleWatch(watch);
+        return ERROR;
+    }
+
+    freeScheduleWatch(ctx->watch);
+    ctx->watch = watch;
+    return SUCCESS;
+#else
+    fprintf(stderr, "Watching the schedule file is not supported\n");
+    return ERROR;
+#endif // __linux__
+}
+
+Bool readScheduleWatch(scheduleWatch * watch) {
+    Bool changed = False;
+#ifdef __linux__
+    char buffer[4096]
+        __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    struct inotify_event * event;
+    ssize_t length;
+    char * pos;
+
+    while ((length = read(watch->fd, buffer, sizeof(buffer))) > 0) {
+        for (pos = buffer; pos < buffer + length;
+                pos += sizeof(struct inotify_event) + event->len) {
+            event = (struct inotify_event *)pos;
+            if (event->len > 0 && strcmp(event->name, watch->baseName) == 0) {
+                changed = True;
+            }
+        }
+    }
+#endif // __linux__
+    return changed;
+}
+
+void freeScheduleWatch(scheduleWatch * watch) {
+    if (watch == NULL) {
+        return;
+    }
+    // Closing the instance removes its watch.
+    if (watch->fd >= 0) {
+        close(watch->fd);
+    }
+    free(watch->fileName);
+    free(watch->baseName);
+    free(watch);
+}
+
+/**
+ * FNV-1a hash of the data continuing from hash.
+ */
+uint64_t hashContent(uint64_t hash, const void * data, size_t length) {
+    const unsigned char * bytes = data;
+    size_t idx;
+
+    for (idx = 0; idx < length; idx++) {
+        hash ^= bytes[idx];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+/**
+ * Hash the string including its null term, so adjacent strings cannot run
+ * together.  NULL hashes as an empty string.
+ */
+uint64_t hashString(uint64_t hash, const char * str) {
+    if (str == NULL) {
+        str = "";
+    }
+    return hashContent(hash, str, strlen(str) + 1);
+}
+
+/**
+ * Hash the type and the values used by that type.  Lists are hashed by each
+ * element in order.
+ */
+uint64_t hashValueStruct(uint64_t hash, valueStruct * value) {
+    hash = hashContent(hash, &value->type, sizeof(value->type));
+    switch (value->type) {
+        case SINGLE:
+            return hashContent(hash, &value->value, sizeof(value->value));
+        case RANGE:
+            return hashContent(hash, value->range, sizeof(value->range));
+        case LIST:
+            for (; value != NULL; value = value->listNode.next) {
+                hash = hashValueStruct(hash, value->listNode.element);
+            }
+            return hash;
+        default:
+            return hash;
+    }
+}
+
+Bool sameString(const char * str1, const char * str2) {
+    return strcmp(str1 != NULL ? str1 : "", str2 != NULL ? str2 : "") == 0
+        ? True : False;
+}
+
+Bool sameValueStruct(valueStruct * value1, valueStruct * value2) {
+    if (value1->type != value2->type) {
+        return False;
+    }
+    switch (value1->type) {
+        case SINGLE:
+            return value1->value == value2->value ? True : False;
+        case RANGE:
+            return memcmp(value1->range, value2->range,
+                    sizeof(value1->range)) == 0 ? True : False;
+        case LIST:
+            for (; value1 != NULL && value2 != NULL;
+                    value1 = value1->listNode.next,
+                    value2 = value2->listNode.next) {
+                if (sameValueStruct(value1->listNode.element,
+                            value2->listNode.element) == False) {
+                    return False;
+                }
+            }
+            return value1 == value2 ? True : False;
+        default:
+            return True;
+    }
+}
+
+/**
+ * Actions are the same if they would run the same command for any entry.
+ * Private actions have no name of their own.
+ */
+Bool sameAction(actionDef * action1, actionDef * action2) {
+    if (action1 == action2) {
+        return True;
+    }
+    if (action1 == NULL || action2 == NULL || action1->type != action2->type
+            || sameString(action1->command, action2->command) == False) {
+        return False;
+    }
+    return action1->type == PRIVATE
+        || sameString(action1->name, action2->name) ? True : False;
+}
+
+/**
+ * Compare everything included in the content hash of the entries.
+ */
+Bool sameScheduleEntry(scheduleEntry * entry1, scheduleEntry * entry2) {
+    actionNode * node1, * node2;
+
+    if (entry1->durationInMin != entry2->durationInMin
+            || sameValueStruct(&entry1->year, &entry2->year) == False
+            || sameValueStruct(&entry1->monOfYear, &entry2->monOfYear) == False
+            || sameValueStruct(&entry1->dayOfMonth, &entry2->dayOfMonth) == False
+            || sameValueStruct(&entry1->dayOfWeek, &entry2->dayOfWeek) == False
+            || sameValueStruct(&entry1->hour, &entry2->hour) == False
+            || sameValueStruct(&entry1->minute, &entry2->minute) == False
+            || sameString(entry1->task, entry2->task) == False
+            || sameString(entry1->reminderMessage,
+                entry2->reminderMessage) == False) {
+        return False;
+    }
+    for (node1 = entry1->actionSet, node2 = entry2->actionSet;
+            node1 != NULL && node2 != NULL;
+            node1 = node1->next, node2 = node2->next) {
+        if (sameAction(node1->action, node2->action) == False) {
+            return False;
+        }
+    }
+    return node1 == node2 ? True : False;
+}
+
+/**
+ * Build the table of the entries of the schedule, keyed by content hash.
+ * At most half of the slots are used.  Must be freed by caller.
+ */
+reloadSlot * buildReloadTable(scheduleContext * ctx, uint32_t * slotCount) {
+    reloadSlot * slots;
+    scheduleNode * node;
+    uint32_t slot;
+
+    *slotCount = MIN_RELOAD_SLOTS;
+    while (*slotCount < (uint32_t)ctx->scheduleCount * 2) {
+        *slotCount *= 2;
+    }
+    slots = calloc(*slotCount, sizeof(reloadSlot));
+    assert(slots != NULL);
+    for (node = ctx->schedHead; node != NULL; node = node->next) {
+        slot = hashScheduleEntry(node->entry) & (*slotCount - 1);
+        while (slots[slot].entry != NULL) {
+            slot = (slot + 1) & (*slotCount - 1);
+        }
+        slots[slot].entry = node->entry;
+    }
+    return slots;
+}
+
+/**
+ * Find an entry of the table with the same content as the entry that has
+ * not already been matched and mark it as matched.  Identical entries are
+ * each matched once.
+ * Returns:
+ *  The matching entry or NULL if none.
+ */
+scheduleEntry * takeMatchingEntry(reloadSlot * slots, uint32_t slotCount,
+        scheduleEntry * entry) {
+    uint64_t hash = hashScheduleEntry(entry);
+    uint32_t slot = hash & (slotCount - 1);
+
+    for (; slots[slot].entry != NULL; slot = (slot + 1) & (slotCount - 1)) {
+        if (slots[slot].matched == False
+                && slots[slot].entry->contentHash == hash
+                && sameScheduleEntry(slots[slot].entry, entry) == True) {
+            slots[slot].matched = True;
+            return slots[slot].entry;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Pair each action defined by fresh with an unpaired action of the
+ * schedule that is the same, if any.  Schedules define few actions, so
+ * they are searched in order.
+ * Returns:
+ *  Array with one match for each fresh action in order.  Must be freed by
+ *  caller.
+ */
+actionMatch * matchActions(scheduleContext * ctx, scheduleContext * fresh,
+        int * matchCount) {
+    actionMatch * matches;
+    actionNode * cmd, * old;
+    int count = 0, match;
+
+    for (cmd = fresh->cmdHead; cmd != NULL; cmd = cmd->next) {
+        count++;
+    }
+    matches = malloc(sizeof(actionMatch) * (count > 0 ? count : 1));
+    assert(matches != NULL);
+
+    for (cmd = fresh->cmdHead, match = 0; cmd != NULL;
+            cmd = cmd->next, match++) {
+        matches[match].fresh = cmd->action;
+        matches[match].kept = cmd->action;
+        for (old = ctx->cmdHead; old != NULL; old = old->next) {
+            if (sameAction(old->action, cmd->action) == True
+                    && isKeptAction(matches, match, old->action) == False) {
+                matches[match].kept = old->action;
+                break;
+            }
+        }
+    }
+    *matchCount = count;
+    return matches;
+}
+
+Bool isKeptAction(actionMatch * matches, int matchCount, actionDef * action) {
+    int match;
+
+    for (match = 0; match < matchCount; match++) {
+        if (matches[match].kept == action) {
+            return True;
+        }
+    }
+    return False;
+}
+
+/**
+ * Return the kept action for a fresh action, or for an action of the
+ * schedule that was not kept, the kept action that is the same.
+ */
+actionDef * keptAction(actionMatch * matches, int matchCount,
+        actionDef * action) {
+    int match;
+
+    for (match = 0; match < matchCount; match++) {
+        if (matches[match].fresh == action) {
+            return matches[match].kept;
+        }
+    }
+    for (match = 0; match < matchCount; match++) {
+        if (sameAction(matches[match].kept, action) == True) {
+            return matches[match].kept;
+        }
+    }
+    return action;
+}
+
+/**
+ * Point the defined actions of the set at the kept actions.  Private actions
+ * belong to the entry and are left as is.
+ */
+void remapActionSet(actionNode * actionSet, actionMatch * matches,
+        int matchCount) {
+    for (; actionSet != NULL; actionSet = actionSet->next) {
+        if (actionSet->action != NULL && actionSet->action->type != PRIVATE) {
+            actionSet->action = keptAction(matches, matchCount,
+                    actionSet->action);
+        }
+    }
+}
+
+/**
+ * Free the commands of the entry rendered for actions that were not kept.
+ * Private actions are never replaced.
+ */
+void dropStaleRendered(scheduleEntry * entry, actionMatch * matches,
+        int matchCount) {
+    renderedCommand ** link = &entry->rendered, * stale;
+
+    while (*link != NULL) {
+        if ((*link)->action->type != PRIVATE
+                && isKeptAction(matches, matchCount, (*link)->action) == False) {
+            stale = *link;
+            *link = stale->next;
+            free(stale->argv);
+            free(stale);
+        }
+        else {
+            link = &(*link)->next;
+        }
+    }
+}
+
+/**
+ * Intern the text of every entry of the schedule within a new string pool
+ * and free the old pool, once the pool holds more than
+ * MAX_POOL_STRINGS_PER_ENTRY strings per entry or the schedule still refers
+ * to a mapped file.  Otherwise kept entries keep their IDs and only added
+ * text was interned, so a reload costs as much as its changes, and the text
+ * of removed entries is dropped once it outgrows that of the schedule.
+ * Mapped files are not kept, as truncating the file, as editors may do
+ * with the schedule being reloaded, discards the text within the mapping.
+ */
+void compactStringPool(scheduleContext * ctx) {
+    stringPool * oldStrings = ctx->strings;
+    scheduleNode * node;
+
+    if (ctx->mappedFiles == NULL && (oldStrings == NULL 
+                || getStringPoolCount(oldStrings) <= MAX_POOL_STRINGS_PER_ENTRY 
+                * (uint32_t)ctx->scheduleCount)) {
+        return;
+    }
+    ctx->strings = NULL;
+    for (node = ctx->schedHead; node != NULL; node = node->next) {
+        internEntryText(ctx, node->entry, node->entry->task, 
+                node->entry->reminderMessage, False);
+    }
+    freeStringPool(oldStrings);
+    freeMappedFiles(ctx->mappedFiles);
+    ctx->mappedFiles = NULL;
+}
+
+/**
+ * Make the generations of fresh, which hold the list and the added entries,
+ * the current generations of the schedule.  Older generations are kept
+ * while they hold a kept entry or action and dropped whole once they do
+ * not.  The list nodes of the current generation are not counted, so it is
+ * always kept.
+ */
+void adoptGenerations(scheduleContext * ctx, scheduleContext * fresh) {
+    scheduleArena * last;
+
+    if (fresh->arena == NULL) {
+        return;
+    }
+    for (last = fresh->arena; last->next != NULL; last = last->next);
+    last->next = freeIdleArenas(ctx->arena);
+    ctx->arena = fresh->arena;
+    fresh->arena = NULL;
+}
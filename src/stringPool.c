@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "schedule.h"
+#include "scheduleArena.h"
+#include "stringPool.h"
+
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+/* -----------------------------------------------------------------------------
+ *  Prototypes
+ * ---------------------------------------------------------------------------*/
+uint32_t hashPoolString(const char * str);
+stringId addPoolString(stringPool * pool, const char * str, Bool shared);
+void growPoolSlots(stringPool * pool);
+
+/* -----------------------------------------------------------------------------
+ *  Function definitions.
+ * ---------------------------------------------------------------------------*/
+
+stringPool * createStringPool() {
+    stringPool * pool;
+
+    pool = malloc(sizeof(stringPool));
+    assert(pool != NULL);
+    memset(pool, 0, sizeof(stringPool));
+    pool->text = createScheduleArena();
+    // ID 0 is STRING_NONE.
+    pool->count = 1;
+    return pool;
+}
+
+void freeStringPool(stringPool * pool) {
+    if (pool != NULL) {
+        free(pool->strings);
+        free(pool->slots);
+        freeScheduleArena(pool->text);
+        free(pool);
+    }
+}
+
+stringId internPoolString(stringPool * pool, const char * str) {
+    return addPoolString(pool, str, False);
+}
+
+stringId internSharedPoolString(stringPool * pool, const char * str) {
+    return addPoolString(pool, str, True);
+}
+
+const char * poolString(stringPool * pool, stringId id) {
+    return id != STRING_NONE && id < pool->count ? pool->strings[id] : NULL;
+}
+
+uint32_t getStringPoolCount(stringPool * pool) {
+    return pool->count - 1;
+}
+
+/**
+ * FNV-1a hash of the string.
+ */
+uint32_t hashPoolString(const char * str) {
+    uint64_t hash = FNV_OFFSET_BASIS;
+
+    for (; *str != '\0'; str++) {
+        hash ^= (unsigned char)*str;
+        hash *= FNV_PRIME;
+    }
+    return (uint32_t)(hash ^ (hash >> 32));
+}
+
+/**
+ * Find the string, adding it with the next ID if not found.  A shared
+ * string is referred to rather than copied.
+ */
+stringId addPoolString(stringPool * pool, const char * str, Bool shared) {
+    uint32_t hash = hashPoolString(str), slot;
+    poolSlot * found;
+    stringId id;
+
+    if ((pool->count + 1) * 2 > pool->slotCount) {
+        growPoolSlots(pool);
+    }
+    slot = hash & (pool->slotCount - 1);
+    for (; (found = &pool->slots[slot])->id != STRING_NONE;
+            slot = (slot + 1) & (pool->slotCount - 1)) {
+        if (found->hash == hash && strcmp(pool->strings[found->id], str) == 0) {
+            return found->id;
+        }
+    }
+
+    if (pool->count >= pool->capacity) {
+        pool->capacity = pool->capacity > 0 ? pool->capacity * 2 :
+            MIN_POOL_SLOTS / 2;
+        pool->strings = realloc(pool->strings,
+                sizeof(const char *) * pool->capacity);
+        assert(pool->strings != NULL);
+        pool->strings[STRING_NONE] = NULL;
+    }
+    id = pool->count++;
+    pool->strings[id] = shared ? str : arenaStrdup(pool->text, str);
+    found->hash = hash;
+    found->id = id;
+    pool->bytes += strlen(str) + 1;
+    return id;
+}
+
+/**
+ * Double the table, placing each used slot again using its kept hash.
+ */
+void growPoolSlots(stringPool * pool) {
+    poolSlot * oldSlots = pool->slots;
+    uint32_t oldCount = pool->slotCount, idx, slot;
+
+    pool->slotCount = oldCount > 0 ? oldCount * 2 : MIN_POOL_SLOTS;
+    pool->slots = calloc(pool->slotCount, sizeof(poolSlot));
+    assert(pool->slots != NULL);
+    for (idx = 0; idx < oldCount; idx++) {
+        if (oldSlots[idx].id == STRING_NONE) {
+            continue;
+        }
+        slot = oldSlots[idx].hash & (pool->slotCount - 1);
+        while (pool->slots[slot].id != STRING_NONE) {
+            slot = (slot + 1) & (pool->slotCount - 1);
+        }
+        pool->slots[slot] = oldSlots[idx];
+    }
+    free(oldSlots);
+}
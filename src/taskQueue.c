@@ -0,0 +1,206 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "schedule.h"
+#include "taskQueue.h"
+
+#define PARENT(idx) (((idx) - 1) / 2)
+#define LEFT(idx)   (2 * (idx) + 1)
+
+/* -----------------------------------------------------------------------------
+ *  Prototypes
+ * ---------------------------------------------------------------------------*/
+void siftUpTaskQueue(taskQueue * queue, int idx);
+void siftDownTaskQueue(taskQueue * queue, int idx);
+scheduleNode * collectTaskQueueTies(taskQueue * queue, int idx, 
+        time_t nextTime, scheduleNode * list, int * tieCount);
+int compareListPos(const void * node1, const void * node2);
+void placeTaskQueueNode(taskQueue * queue, int idx, taskQueueNode * node);
+
+/* -----------------------------------------------------------------------------
+ *  Function definitions.
+ * ---------------------------------------------------------------------------*/
+
+taskQueue * createTaskQueue(int capacity) {
+    taskQueue * queue;
+
+    queue = malloc(sizeof(taskQueue));
+    assert(queue != NULL);
+    memset(queue, 0, sizeof(taskQueue));
+
+    queue->capacity = capacity > 0 ? capacity : 16;
+    queue->nodes = malloc(sizeof(taskQueueNode) * queue->capacity);
+    assert(queue->nodes != NULL);
+
+    return queue;
+}
+
+void freeTaskQueue(taskQueue * queue) {
+    if (queue != NULL) {
+        free(queue->nodes);
+        free(queue);
+    }
+}
+
+void pushTaskQueue(taskQueue * queue, time_t nextTime, scheduleEntry * entry) {
+    if (queue->count == queue->capacity) {
+        queue->capacity *= 2;
+        queue->nodes = realloc(queue->nodes, 
+                sizeof(taskQueueNode) * queue->capacity);
+        assert(queue->nodes != NULL);
+    }
+    queue->nodes[queue->count].nextTime = nextTime;
+    queue->nodes[queue->count].entry = entry;
+    entry->alarmSlot = queue->count;
+    siftUpTaskQueue(queue, queue->count);
+    queue->count++;
+}
+
+taskQueueNode * peekTaskQueue(taskQueue * queue) {
+    return queue->count > 0 ? &queue->nodes[0] : NULL;
+}
+
+Bool popTaskQueue(taskQueue * queue, taskQueueNode * node) {
+    if (queue->count == 0) {
+        return False;
+    }
+    memcpy(node, &queue->nodes[0], sizeof(taskQueueNode));
+    node->entry->alarmSlot = -1;
+    queue->count--;
+    if (queue->count > 0) {
+        queue->nodes[0] = queue->nodes[queue->count];
+        siftDownTaskQueue(queue, 0);
+    }
+    return True;
+}
+
+Bool removeTaskQueueEntry(taskQueue * queue, scheduleEntry * entry) {
+    int idx = entry->alarmSlot;
+
+    if (idx < 0 || idx >= queue->count || queue->nodes[idx].entry != entry) {
+        return False;
+    }
+    entry->alarmSlot = -1;
+    queue->count--;
+    if (idx < queue->count) {
+        // The last node may belong above or below the removed one.
+        placeTaskQueueNode(queue, idx, &queue->nodes[queue->count]);
+        siftUpTaskQueue(queue, idx);
+        siftDownTaskQueue(queue, queue->nodes[idx].entry->alarmSlot);
+    }
+    return True;
+}
+
+scheduleNode * peekTaskQueueTies(taskQueue * queue) {
+    scheduleNode * list;
+    int tieCount = 0;
+
+    if (queue->count == 0) {
+        return NULL;
+    }
+    list = collectTaskQueueTies(queue, 0, queue->nodes[0].nextTime, NULL,
+            &tieCount);
+    return sortTaskQueueTies(list, tieCount);
+}
+
+/**
+ * Add all entries at or below idx with the provided time to the front of the 
+ * list, counting them in tieCount.  As children are never earlier than their
+ * parent, only the branches that begin with the provided time need to be 
+ * visited.  Entries are added in heap order.
+ */
+scheduleNode * collectTaskQueueTies(taskQueue * queue, int idx, 
+        time_t nextTime, scheduleNode * list, int * tieCount) {
+    scheduleNode * newNode;
+
+    if (idx >= queue->count || queue->nodes[idx].nextTime != nextTime) {
+        return list;
+    }
+    newNode = createScheduleNode();
+    newNode->entry = queue->nodes[idx].entry;
+    newNode->next = list;
+    (*tieCount)++;
+
+    list = collectTaskQueueTies(queue, LEFT(idx), nextTime, newNode, 
+            tieCount);
+    return collectTaskQueueTies(queue, LEFT(idx) + 1, nextTime, list, 
+            tieCount);
+}
+
+scheduleNode * sortTaskQueueTies(scheduleNode * list, int tieCount) {
+    scheduleNode ** nodes, * current;
+    int idx;
+
+    if (tieCount < 2) {
+        return list;
+    }
+    nodes = malloc(sizeof(scheduleNode *) * tieCount);
+    assert(nodes != NULL);
+    for (current = list, idx = 0; current != NULL; 
+            current = current->next, idx++) {
+        nodes[idx] = current;
+    }
+    qsort(nodes, tieCount, sizeof(scheduleNode *), compareListPos);
+    for (idx = 0; idx < tieCount - 1; idx++) {
+        nodes[idx]->next = nodes[idx + 1];
+    }
+    nodes[tieCount - 1]->next = NULL;
+    list = nodes[0];
+    free(nodes);
+    return list;
+}
+
+/**
+ * qsort comparator ordering schedule nodes by the list position of their
+ * entries.
+ */
+int compareListPos(const void * node1, const void * node2) {
+    int pos1 = (*(scheduleNode * const *)node1)->entry->listPos;
+    int pos2 = (*(scheduleNode * const *)node2)->entry->listPos;
+
+    return (pos1 > pos2) - (pos1 < pos2);
+}
+
+/**
+ * Move the node at idx up the heap until its parent is not later than it.
+ */
+void siftUpTaskQueue(taskQueue * queue, int idx) {
+    taskQueueNode node = queue->nodes[idx];
+
+    while (idx > 0 && queue->nodes[PARENT(idx)].nextTime > node.nextTime) {
+        placeTaskQueueNode(queue, idx, &queue->nodes[PARENT(idx)]);
+        idx = PARENT(idx);
+    }
+    placeTaskQueueNode(queue, idx, &node);
+}
+
+/**
+ * Move the node at idx down the heap until neither child is earlier than it.
+ */
+void siftDownTaskQueue(taskQueue * queue, int idx) {
+    taskQueueNode node = queue->nodes[idx];
+    int child;
+
+    while ((child = LEFT(idx)) < queue->count) {
+        if (child + 1 < queue->count 
+                && queue->nodes[child + 1].nextTime < queue->nodes[child].nextTime) {
+            child++;
+        }
+        if (queue->nodes[child].nextTime >= node.nextTime) {
+            break;
+        }
+        placeTaskQueueNode(queue, idx, &queue->nodes[child]);
+        idx = child;
+    }
+    placeTaskQueueNode(queue, idx, &node);
+}
+
+/**
+ * Store the node at idx, recording the position with its entry so the entry
+ * can be removed without a search.
+ */
+void placeTaskQueueNode(taskQueue * queue, int idx, taskQueueNode * node) {
+    queue->nodes[idx] = *node;
+    node->entry->alarmSlot = idx;
+}
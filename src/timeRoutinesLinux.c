@@ -1,11 +1,251 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
 #include "schedule.h"
 #include "timeRoutines.h"
+#include "launcher.h"
+#include "scheduleReload.h"
+
+// Prototypes
+int armTimer(int timerFd, scheduledExec *task);
+scheduledExec * reloadWatchedSchedule(scheduleContext * ctx, 
+        scheduledExec *task);
+int addToEpoll(int epollFd, int fd);
+int createChildFd();
+void drainChildFd(int childFd);
+void freeScheduledExec(scheduledExec *task);
+
+/**
+ * Arm the timer to expire at the absolute time of the task.  The timer is
+ * cancelled if the system clock is set, so the schedule can be recalculated.
+ * A NULL task disarms the timer.
+ */
+int armTimer(int timerFd, scheduledExec *task)
+{
+    struct itimerspec timerSpec;
+
+    memset(&timerSpec, 0, sizeof(timerSpec));
+    if (task != NULL) {
+        timerSpec.it_value.tv_sec = task->absTime;
+        #ifdef DEBUG
+        printf("In Timer Install: %ld\n", (long)task->absTime);
+        #endif // DEBUG
+    }
+
+    if (timerfd_settime(timerFd, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET,
+                &timerSpec, NULL) < 0) {
+        perror("timerfd_settime failed");
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * Wait for input on the file descriptor within the epoll instance.
+ */
+int addToEpoll(int epollFd, int fd)
+{
+    struct epoll_event event;
+
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) < 0) {
+        perror("epoll_ctl failed");
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * Block SIGCHLD and return a signalfd that becomes readable when a launched
+ * command exits, so children are reaped by the event loop rather than a 
+ * signal handler.
+ */
+int createChildFd()
+{
+    sigset_t signals;
+    int childFd;
+
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGCHLD);
+    if (sigprocmask(SIG_BLOCK, &signals, NULL) < 0) {
+        perror("sigprocmask failed");
+        return -1;
+    }
+    childFd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (childFd < 0) {
+        perror("signalfd failed");
+    }
+    return childFd;
+}
 
 /**
- * Main entry point for setting up the timer.  
+ * Consume the pending SIGCHLD notifications and reap all exited children.
+ * Notifications may be merged, so the number read is not the number of
+ * children.
  */
-int waitForTask(scheduledExec *task)
+void drainChildFd(int childFd)
 {
-    return (0);
+    struct signalfd_siginfo info;
+
+    while (read(childFd, &info, sizeof(info)) == sizeof(info));
+    reapChildren();
+}
+
+/**
+ * Free a task that will not be executed.
+ */
+void freeScheduledExec(scheduledExec *task)
+{
+    if (task != NULL) {
+        freeScheduleNodeList(task->taskHead);
+        free(task);
+    }
+}
+
+/**
+ * Reload the watched schedule file if it has changed.  Only the entries 
+ * that changed are updated, but the pending task may refer to a removed 
+ * entry or follow an added one, so it is discarded and calculated again.
+ * Returns:
+ *  The task to wait for.
+ */
+scheduledExec * reloadWatchedSchedule(scheduleContext * ctx, 
+        scheduledExec *task)
+{
+    reloadStats stats;
+
+    if (readScheduleWatch(ctx->watch) == False
+            || reloadScheduleFile(ctx, ctx->watch->fileName, 
+                ctx->watch->parser, &stats) != 0) {
+        return task;
+    }
+    printf("Reloaded %s: %d added, %d removed, %d unchanged\n",
+            ctx->watch->fileName, stats.added, stats.removed, 
+            stats.unchanged);
+    fflush(stdout);
+    freeScheduledExec(task);
+    return calcNextTaskAlarm(ctx);
 }
 
+/**
+ * Main entry point for setting up the timer.  Waits on a CLOCK_REALTIME
+ * timerfd using epoll, executes the task when the timer expires and re-arms
+ * the timer for the next task.  If the system clock is set, the pending task
+ * is discarded and the next task is recalculated from the new time.  Commands
+ * launched by the tasks are reaped when SIGCHLD is received on a signalfd or
+ * when the launcher reports that they have exited.  If the schedule file
+ * is watched, the schedule is reloaded when the file changes.
+ * Returns only on error or when no future tasks remain and the schedule
+ * file is not watched.
+ */
+int waitForTask(scheduleContext * ctx, scheduledExec *task)
+{
+    int timerFd, epollFd, childFd, launcherFd, watchFd, status = 0;
+    struct epoll_event event;
+    uint64_t expirations;
+    ssize_t readLen;
+
+    timerFd = timerfd_create(CLOCK_REALTIME, TFD_CLOEXEC);
+    if (timerFd < 0) {
+        perror("timerfd_create failed");
+        return 1;
+    }
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd < 0) {
+        perror("epoll_create1 failed");
+        close(timerFd);
+        return 1;
+    }
+    childFd = createChildFd();
+    launcherFd = getLauncherFd();
+    watchFd = ctx->watch != NULL ? ctx->watch->fd : -1;
+    if (childFd < 0 || addToEpoll(epollFd, timerFd) != 0 
+            || addToEpoll(epollFd, childFd) != 0
+            || (launcherFd >= 0 && addToEpoll(epollFd, launcherFd) != 0)
+            || (watchFd >= 0 && addToEpoll(epollFd, watchFd) != 0)) {
+        if (childFd >= 0) {
+            close(childFd);
+        }
+        close(epollFd);
+        close(timerFd);
+        return 1;
+    }
+    // Children exited before SIGCHLD was blocked have no notification.
+    reapChildren();
+
+    if (task != NULL && armTimer(timerFd, task) != 0) {
+        status = 1;
+    }
+    while ((task != NULL || watchFd >= 0) && status == 0) {
+        if (epoll_wait(epollFd, &event, 1, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("epoll_wait failed");
+            status = 1;
+            break;
+        }
+        if (event.data.fd == childFd) {
+            drainChildFd(childFd);
+            continue;
+        }
+        if (event.data.fd == launcherFd) {
+            reapChildren();
+            continue;
+        }
+        if (event.data.fd == watchFd) {
+            task = reloadWatchedSchedule(ctx, task);
+            if (armTimer(timerFd, task) != 0) {
+                status = 1;
+            }
+            continue;
+        }
+
+        readLen = read(timerFd, &expirations, sizeof(expirations));
+        if (readLen == sizeof(expirations)) {
+            #ifdef DEBUG
+            printf("In Timer Call Back: %ld\n", (long)time(NULL));
+            #endif // DEBUG
+            if (task != NULL) {
+                executeScheduledEntry(ctx, task);
+                free(task);
+            }
+            task = calcNextTaskAlarm(ctx);
+            if (task != NULL && armTimer(timerFd, task) != 0) {
+                status = 1;
+            }
+        }
+        else if (readLen < 0 && errno == ECANCELED) {
+            // Clock was set.  Times calculated before the change are invalid.
+            #ifdef DEBUG
+            printf("Clock changed: %ld\n", (long)time(NULL));
+            #endif // DEBUG
+            freeScheduledExec(task);
+            resetTaskAlarmQueue(ctx);
+            task = calcNextTaskAlarm(ctx);
+            if (task != NULL && armTimer(timerFd, task) != 0) {
+                status = 1;
+            }
+        }
+        else if (readLen < 0 && errno != EAGAIN && errno != EINTR) {
+            perror("timerfd read failed");
+            status = 1;
+            break;
+        }
+    }
+
+    freeScheduledExec(task);
+    close(childFd);
+    close(epollFd);
+    close(timerFd);
+    return (status);
+}
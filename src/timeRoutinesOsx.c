@@ -13,6 +13,7 @@
 
 io_connect_t  root_port; // a reference to the Root Power Domain IOService
 CFRunLoopTimerRef timerRef;
+static scheduleContext * timerContext; // Schedule being run by waitForTask
 
 // Prototypes
 void installTimer(scheduledExec *task); 
@@ -27,10 +28,12 @@ static void timerCallBack(CFRunLoopTimerRef timer, void *info)
     #ifdef DEBUG
     printf("In Timer Call Back: %f\n", startTime);
     #endif DEBUG
-    executeScheduledEntry(currentTask);
+    executeScheduledEntry(timerContext, currentTask);
+    // Collect commands launched by earlier tasks that have since exited.
+    reapChildren();
     CFRunLoopTimerContext context;
 
-    scheduledExec *task = calcNextTaskAlarm();
+    scheduledExec *task = calcNextTaskAlarm(timerContext);
 
     // Set up the timer. Convert from unix time to CoreFoundation time.
     fireTime = task->absTime - kCFAbsoluteTimeIntervalSince1970;
@@ -93,7 +96,7 @@ powerCallBack( void * refCon, io_service_t service, natural_t messageType, void
             // Cancel old timer and create new one with next scheduled task.  
             CFRunLoopRemoveTimer(CFRunLoopGetCurrent(), timerRef, 
                     kCFRunLoopCommonModes);
-            scheduledExec *task = calcNextTaskAlarm();
+            scheduledExec *task = calcNextTaskAlarm(timerContext);
             installTimer(task);
         break;
 
@@ -107,7 +110,7 @@ powerCallBack( void * refCon, io_service_t service, natural_t messageType, void
 /**
  * Main entry point for setting up the timer.  
  */
-int waitForTask(scheduledExec *task)
+int waitForTask(scheduleContext * ctx, scheduledExec *task)
 {
     // notification port allocated by IORegisterForSystemPower
     IONotificationPortRef notifyPortRef; 
@@ -132,6 +135,7 @@ int waitForTask(scheduledExec *task)
              kCFRunLoopCommonModes ); 
 
     // Set up the timer. 
+    timerContext = ctx;
     installTimer(task);
 
     // Start the run loop to receive sleep notifications. 
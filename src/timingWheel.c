@@ -0,0 +1,370 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "schedule.h"
+#include "timingWheel.h"
+
+#define MINS_PER_HOUR 60
+#define MINS_PER_DAY 1440
+
+/* -----------------------------------------------------------------------------
+ *  Prototypes
+ * ---------------------------------------------------------------------------*/
+long minuteOfTime(time_t time);
+int nextWheelSlot(uint64_t bits, int from);
+wheelTimer ** wheelSlot(timingWheel * wheel, enum WheelLevel level, int slot);
+void placeWheelTimer(timingWheel * wheel, wheelTimer * timer);
+void unlinkWheelTimer(timingWheel * wheel, wheelTimer * timer);
+void cascadeWheelSlot(timingWheel * wheel, enum WheelLevel level, int slot);
+wheelTimer * takeWheelLevel(timingWheel * wheel, enum WheelLevel level,
+        int slotCount, wheelTimer * list);
+void releaseWheelTimer(wheelTimer * timer);
+
+/* -----------------------------------------------------------------------------
+ *  Function definitions.
+ * ---------------------------------------------------------------------------*/
+
+timingWheel * createTimingWheel(time_t startTime) {
+    timingWheel * wheel;
+
+    wheel = malloc(sizeof(timingWheel));
+    assert(wheel != NULL);
+    memset(wheel, 0, sizeof(timingWheel));
+    wheel->base = minuteOfTime(startTime);
+    return wheel;
+}
+
+void freeTimingWheel(timingWheel * wheel) {
+    int slot;
+
+    if (wheel == NULL) {
+        return;
+    }
+    for (slot = 0; slot < WHEEL_MINUTE_SLOTS; slot++) {
+        freeWheelTimers(wheel->minutes[slot]);
+    }
+    for (slot = 0; slot < WHEEL_HOUR_SLOTS; slot++) {
+        freeWheelTimers(wheel->hours[slot]);
+    }
+    for (slot = 0; slot < WHEEL_DAY_SLOTS; slot++) {
+        freeWheelTimers(wheel->days[slot]);
+    }
+    freeWheelTimers(wheel->overflow);
+    free(wheel);
+}
+
+wheelTimer * insertWheelTimer(timingWheel * wheel, time_t expires,
+        scheduleEntry * entry) {
+    wheelTimer * timer;
+
+    timer = malloc(sizeof(wheelTimer));
+    assert(timer != NULL);
+    memset(timer, 0, sizeof(wheelTimer));
+    timer->entry = entry;
+    timer->level = WL_DETACHED;
+    if (entry != NULL) {
+        entry->alarmTimer = timer;
+    }
+
+    rescheduleWheelTimer(wheel, timer, expires);
+    return timer;
+}
+
+void rescheduleWheelTimer(timingWheel * wheel, wheelTimer * timer,
+        time_t expires) {
+    assert(timer->level == WL_DETACHED);
+    timer->expires = expires;
+    placeWheelTimer(wheel, timer);
+    wheel->count++;
+}
+
+void cancelWheelTimer(timingWheel * wheel, wheelTimer * timer) {
+    if (timer->level != WL_DETACHED) {
+        unlinkWheelTimer(wheel, timer);
+        wheel->count--;
+    }
+    releaseWheelTimer(timer);
+}
+
+void rewindTimingWheel(timingWheel * wheel, time_t startTime) {
+    wheelTimer * timers = NULL, * next;
+    long minute = minuteOfTime(startTime);
+
+    if (minute >= wheel->base) {
+        return;
+    }
+    // Each level holds slots relative to the hour or day of base, so only
+    // the levels finer than the unit that changed are placed again.  
+    // Overflow timers remain beyond the day wheel.
+    if (minute / MINS_PER_HOUR != wheel->base / MINS_PER_HOUR) {
+        timers = takeWheelLevel(wheel, WL_MINUTE, WHEEL_MINUTE_SLOTS, timers);
+    }
+    if (minute / MINS_PER_DAY != wheel->base / MINS_PER_DAY) {
+        timers = takeWheelLevel(wheel, WL_HOUR, WHEEL_HOUR_SLOTS, timers);
+        timers = takeWheelLevel(wheel, WL_DAY, WHEEL_DAY_SLOTS, timers);
+    }
+    wheel->base = minute;
+    for (; timers != NULL; timers = next) {
+        next = timers->next;
+        placeWheelTimer(wheel, timers);
+    }
+}
+
+/**
+ * Find the earliest minute holding timers.  If the minute wheel has no timers
+ * at or after base, the next non-empty slot of the hour wheel, day wheel or
+ * the overflow list is cascaded to the finer levels and the search repeats.
+ * base only moves forward to the start of the cascaded slot as all finer
+ * levels are empty.
+ */
+wheelTimer * expireNextWheelBucket(timingWheel * wheel, time_t * bucketTime) {
+    wheelTimer * bucket, * timer;
+    long day, startOfSlot;
+    int slot, startSlot;
+
+    for (;;) {
+        // Minute within the current hour
+        slot = nextWheelSlot(wheel->minuteBits, wheel->base % MINS_PER_HOUR);
+        if (slot >= 0) {
+            bucket = wheel->minutes[slot];
+            wheel->minutes[slot] = NULL;
+            wheel->minuteBits &= ~(1ULL << slot);
+            wheel->base += slot - wheel->base % MINS_PER_HOUR + 1;
+
+            *bucketTime = bucket->expires;
+            for (timer = bucket; timer != NULL; timer = timer->next) {
+                timer->level = WL_DETACHED;
+                timer->prev = NULL;
+                *bucketTime = timer->expires < *bucketTime ?
+                    timer->expires : *bucketTime;
+                wheel->count--;
+            }
+            return bucket;
+        }
+
+        // Hour within the current day
+        slot = nextWheelSlot(wheel->hourBits,
+                (wheel->base / MINS_PER_HOUR) % WHEEL_HOUR_SLOTS);
+        if (slot >= 0) {
+            startOfSlot = wheel->base - wheel->base % MINS_PER_DAY
+                + slot * MINS_PER_HOUR;
+            wheel->base = startOfSlot > wheel->base ? startOfSlot : wheel->base;
+            cascadeWheelSlot(wheel, WL_HOUR, slot);
+            continue;
+        }
+
+        // Day within the day wheel.  Slots wrap, so search from the current
+        // day to the end and then from the beginning.
+        day = wheel->base / MINS_PER_DAY;
+        startSlot = day % WHEEL_DAY_SLOTS;
+        slot = nextWheelSlot(wheel->dayBits, startSlot);
+        if (slot < 0) {
+            slot = nextWheelSlot(wheel->dayBits, 0);
+        }
+        if (slot >= 0) {
+            day += (slot - startSlot + WHEEL_DAY_SLOTS) % WHEEL_DAY_SLOTS;
+            startOfSlot = day * MINS_PER_DAY;
+            wheel->base = startOfSlot > wheel->base ? startOfSlot : wheel->base;
+            cascadeWheelSlot(wheel, WL_DAY, slot);
+            continue;
+        }
+
+        // Overflow.  Move to the day of the earliest timer and place all
+        // timers again.  Those still beyond the day wheel remain in overflow.
+        if (wheel->overflow != NULL) {
+            startOfSlot = minuteOfTime(wheel->overflow->expires);
+            for (timer = wheel->overflow; timer != NULL; timer = timer->next) {
+                if (minuteOfTime(timer->expires) < startOfSlot) {
+                    startOfSlot = minuteOfTime(timer->expires);
+                }
+            }
+            startOfSlot -= startOfSlot % MINS_PER_DAY;
+            wheel->base = startOfSlot > wheel->base ? startOfSlot : wheel->base;
+            cascadeWheelSlot(wheel, WL_OVERFLOW, 0);
+            continue;
+        }
+
+        return NULL;
+    }
+}
+
+void freeWheelTimers(wheelTimer * timers) {
+    wheelTimer * next;
+
+    for (; timers != NULL; timers = next) {
+        next = timers->next;
+        releaseWheelTimer(timers);
+    }
+}
+
+/**
+ * Free the timer, clearing the alarmTimer of its entry.
+ */
+void releaseWheelTimer(wheelTimer * timer) {
+    if (timer->entry != NULL && timer->entry->alarmTimer == timer) {
+        timer->entry->alarmTimer = NULL;
+    }
+    free(timer);
+}
+
+/**
+ * Empty every slot of the level, adding its timers to the front of list.
+ */
+wheelTimer * takeWheelLevel(timingWheel * wheel, enum WheelLevel level,
+        int slotCount, wheelTimer * list) {
+    wheelTimer ** head, * timer, * next;
+    int slot;
+
+    for (slot = 0; slot < slotCount; slot++) {
+        head = wheelSlot(wheel, level, slot);
+        for (timer = *head; timer != NULL; timer = next) {
+            next = timer->next;
+            timer->next = list;
+            list = timer;
+        }
+        *head = NULL;
+    }
+    switch (level) {
+        case WL_MINUTE:
+            wheel->minuteBits = 0;
+            break;
+        case WL_HOUR:
+            wheel->hourBits = 0;
+            break;
+        default:
+            wheel->dayBits = 0;
+            break;
+    }
+    return list;
+}
+
+/**
+ * Return the number of minutes since the epoch for the time.
+ */
+long minuteOfTime(time_t time) {
+    return time >= 0 ? time / 60 : (time - 59) / 60;
+}
+
+/**
+ * Return the first slot at or after from whose bit is set or -1 if none.
+ */
+int nextWheelSlot(uint64_t bits, int from) {
+    bits &= ~0ULL << from;
+    return bits == 0 ? -1 : __builtin_ctzll(bits);
+}
+
+/**
+ * Return the head of the list for the level and slot.
+ */
+wheelTimer ** wheelSlot(timingWheel * wheel, enum WheelLevel level, int slot) {
+    switch (level) {
+        case WL_MINUTE:
+            return &wheel->minutes[slot];
+        case WL_HOUR:
+            return &wheel->hours[slot];
+        case WL_DAY:
+            return &wheel->days[slot];
+        default:
+            return &wheel->overflow;
+    }
+}
+
+/**
+ * Link the timer into the finest level that holds its minute relative to
+ * base.  Times before base are placed at base.
+ */
+void placeWheelTimer(timingWheel * wheel, wheelTimer * timer) {
+    wheelTimer ** head;
+    long minute = minuteOfTime(timer->expires);
+
+    minute = minute < wheel->base ? wheel->base : minute;
+    if (minute / MINS_PER_HOUR == wheel->base / MINS_PER_HOUR) {
+        timer->level = WL_MINUTE;
+        timer->slot = minute % MINS_PER_HOUR;
+        wheel->minuteBits |= 1ULL << timer->slot;
+    }
+    else if (minute / MINS_PER_DAY == wheel->base / MINS_PER_DAY) {
+        timer->level = WL_HOUR;
+        timer->slot = (minute / MINS_PER_HOUR) % WHEEL_HOUR_SLOTS;
+        wheel->hourBits |= 1U << timer->slot;
+    }
+    else if (minute / MINS_PER_DAY - wheel->base / MINS_PER_DAY
+            < WHEEL_DAY_SLOTS) {
+        timer->level = WL_DAY;
+        timer->slot = (minute / MINS_PER_DAY) % WHEEL_DAY_SLOTS;
+        wheel->dayBits |= 1ULL << timer->slot;
+    }
+    else {
+        timer->level = WL_OVERFLOW;
+        timer->slot = 0;
+    }
+
+    head = wheelSlot(wheel, timer->level, timer->slot);
+    timer->prev = NULL;
+    timer->next = *head;
+    if (*head != NULL) {
+        (*head)->prev = timer;
+    }
+    *head = timer;
+}
+
+/**
+ * Remove the timer from its slot, clearing the slot bit if it is now empty.
+ */
+void unlinkWheelTimer(timingWheel * wheel, wheelTimer * timer) {
+    wheelTimer ** head = wheelSlot(wheel, timer->level, timer->slot);
+
+    if (timer->prev != NULL) {
+        timer->prev->next = timer->next;
+    }
+    else {
+        *head = timer->next;
+    }
+    if (timer->next != NULL) {
+        timer->next->prev = timer->prev;
+    }
+
+    if (*head == NULL) {
+        switch (timer->level) {
+            case WL_MINUTE:
+                wheel->minuteBits &= ~(1ULL << timer->slot);
+                break;
+            case WL_HOUR:
+                wheel->hourBits &= ~(1U << timer->slot);
+                break;
+            case WL_DAY:
+                wheel->dayBits &= ~(1ULL << timer->slot);
+                break;
+            default:
+                break;
+        }
+    }
+    timer->level = WL_DETACHED;
+    timer->prev = timer->next = NULL;
+}
+
+/**
+ * Empty the slot and place each of its timers again relative to base.
+ */
+void cascadeWheelSlot(timingWheel * wheel, enum WheelLevel level, int slot) {
+    wheelTimer ** head = wheelSlot(wheel, level, slot);
+    wheelTimer * timer, * next;
+
+    timer = *head;
+    *head = NULL;
+    switch (level) {
+        case WL_HOUR:
+            wheel->hourBits &= ~(1U << slot);
+            break;
+        case WL_DAY:
+            wheel->dayBits &= ~(1ULL << slot);
+            break;
+        default:
+            break;
+    }
+    for (; timer != NULL; timer = next) {
+        next = timer->next;
+        placeWheelTimer(wheel, timer);
+    }
+}
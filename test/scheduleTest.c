@@ -2,12 +2,27 @@
 #include <string.h>
 #include <stdio.h>
 #include <assert.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/time.h>
 #include "CuTest.h"
 #include "schedule.h"
+#include "timingWheel.h"
+#include "launcher.h"
+#include "executor.h"
+#include "scheduleLoader.h"
+#include "scheduleCache.h"
+#include "scheduleReload.h"
+#include "scheduleArena.h"
+#include "stringPool.h"
+#include "entryStore.h"
+#include "timeRoutines.h"
 #include "schedule.tab.h"
 
 struct tm testTime;
 time_t testTimeSeconds;
+// Schedule shared by the tests.  Entries parsed by TestFileParse remain.
+scheduleContext *testContext;
 // Year as specified in tm struct
 #define TEST_YEAR (2010 - 1900) 
 // Mon is 0 - 11
@@ -83,7 +98,7 @@ void InitTestEnv() {
         testTime.tm_sec = TEST_SEC;
         testTime.tm_isdst = -1;  // Cause mktime to determine
         testTimeSeconds = mktime(&testTime);
-        setTestTime(testTimeSeconds);
+        setTestTime(testContext, testTimeSeconds);
     }
 }
 
@@ -281,7 +296,7 @@ void runTestEntry(CuTest *tc, testArgs *test) {
     currentTime.tm_sec = test->current.sec;
     currentTime.tm_isdst = -1;  // Cause mktime to determine
     currentTimeSeconds = mktime(&currentTime);
-    setTestTime(currentTimeSeconds);
+    setTestTime(testContext, currentTimeSeconds);
 
     testTimeSeconds = 0;// Will cause init to reset to base time if invoked
 
@@ -293,7 +308,7 @@ void runTestEntry(CuTest *tc, testArgs *test) {
     CuAssertPtrNotNull(tc, testEntry);
 
     // Calculate the next time for this task 
-    taskTime = calcNextTimeForTask(testEntry);
+    taskTime = calcNextTimeForTask(testContext, testEntry);
 
     taskTimeStructure = localtime(&taskTime);
 
@@ -443,23 +458,2033 @@ void TestValueParse(CuTest *tc) {
     freeValueStruct(base);
 
 }
+/**
+ * Test compilation of calendar values into bitsets
+ */
+void TestCompileScheduleEntry(CuTest *tc) {
+    valueStruct *year, *mon, *dom, *dow, *hour, *min;
+    scheduleEntry *entry;
+    char listVal[12] = "1,10-20/5";
+
+    year = parseValue("*", False);
+    mon = parseValue("1-12/4", True);
+    dom = parseValue("31", False);
+    dow = parseValue("*", True);
+    hour = parseValue(listVal, False);
+    min = parseValue("*", False);
+    entry = createScheduleEntryAdv(year, mon, dom, dow, hour, min, 0, 
+            "task", "reminder");
+    CuAssertPtrNotNull(tc, entry);
+
+    CuAssertTrue(tc, entry->compiled.monOfYear == 0x111);
+    CuAssertTrue(tc, entry->compiled.dayOfMonth == 1U << 31);
+    CuAssertTrue(tc, entry->compiled.dayOfWeek == 0x7f);
+    CuAssertTrue(tc, entry->compiled.hour == ((1 << 1) | (1 << 10) 
+                | (1 << 15) | (1 << 20)));
+    CuAssertTrue(tc, entry->compiled.minute == (1ULL << 60) - 1);
+
+    freeScheduleEntry(entry);
+    freeValueStruct(year);
+    freeValueStruct(mon);
+    freeValueStruct(dom);
+    freeValueStruct(dow);
+    freeValueStruct(hour);
+    freeValueStruct(min);
+}
+
+/**
+ * Test that the batch calculation matches the calculation for each entry and
+ * does not depend on the current time.
+ */
+void TestCalcNextTimesForTasksFrom(CuTest *tc) {
+    char *schedules[] = {"* * * * * 30,31,32", "* * * 1 13 45", 
+        "2010 10-11 4,5,6 * 13,14,15,17 45,50-55", "2009 * * * * 0"};
+    scheduleEntry *entries[4];
+    struct testSchedule testSched;
+    struct tm current;
+    time_t currentTime, nextTimes[4];
+    char buffer[64];
+    int entryIdx;
+
+    memset(&current, 0, sizeof(struct tm));
+    current.tm_year = TEST_YEAR;
+    current.tm_mon = TEST_MON;
+    current.tm_mday = TEST_DAY_OF_MON;
+    current.tm_hour = TEST_HOUR;
+    current.tm_min = TEST_MIN;
+    current.tm_sec = TEST_SEC;
+    current.tm_isdst = -1;
+    currentTime = mktime(&current);
+    // Current time must not be used.
+    setTestTime(testContext, currentTime + 86400);
+
+    for (entryIdx = 0; entryIdx < 4; entryIdx++) {
+        strcpy(buffer, schedules[entryIdx]);
+        strcat(buffer, " 0");
+        parseSchedule(buffer, &testSched);
+        entries[entryIdx] = createScheduleEntryAdv(testSched.year, 
+                testSched.mon, testSched.dom, testSched.dow, testSched.hour,
+                testSched.min, 0, "task", "reminder");
+        cleanupTestSchedule(&testSched);
+    }
+
+    calcNextTimesForTasksFrom(entries, 4, currentTime, nextTimes);
+    CuAssertTrue(tc, nextTimes[0] == currentTime - TEST_SEC + 15 * 60);
+    CuAssertTrue(tc, nextTimes[3] == -1);
+    for (entryIdx = 0; entryIdx < 4; entryIdx++) {
+        CuAssertTrue(tc, nextTimes[entryIdx] == 
+                calcNextTimeForTaskFrom(entries[entryIdx], currentTime));
+        freeScheduleEntry(entries[entryIdx]);
+    }
+}
+
+/**
+ * Test that the iterator returns every occurrence within the window.
+ */
+void TestOccurrenceIter(CuTest *tc) {
+    char buffer[64] = "* * * * * 1-59/3 0";
+    struct testSchedule testSched;
+    scheduleEntry *entry;
+    occurrenceIter iter;
+    struct tm current, *occurTime;
+    time_t startTime, occurrence, lastOccurrence = 0;
+    int count = 0;
+
+    parseSchedule(buffer, &testSched);
+    entry = createScheduleEntryAdv(testSched.year, testSched.mon, 
+            testSched.dom, testSched.dow, testSched.hour, testSched.min, 
+            0, "task", "reminder");
+    cleanupTestSchedule(&testSched);
+
+    memset(&current, 0, sizeof(struct tm));
+    current.tm_year = TEST_YEAR;
+    current.tm_mon = TEST_MON;
+    current.tm_mday = TEST_DAY_OF_MON;
+    current.tm_hour = TEST_HOUR;
+    current.tm_isdst = -1;
+    startTime = mktime(&current);
+
+    // Every third minute for one hour
+    initOccurrenceIter(&iter, entry, startTime, startTime + 3599);
+    while (nextOccurrence(&iter, &occurrence)) {
+        CuAssertTrue(tc, occurrence > lastOccurrence);
+        occurTime = localtime(&occurrence);
+        CuAssertIntEquals(tc, TEST_HOUR, occurTime->tm_hour);
+        CuAssertIntEquals(tc, 1, occurTime->tm_min % 3);
+        lastOccurrence = occurrence;
+        count++;
+    }
+    closeOccurrenceIter(&iter);
+    CuAssertIntEquals(tc, 20, count);
+
+    // Window crossing midnight starting on an occurrence
+    count = 0;
+    initOccurrenceIter(&iter, entry, startTime + 60, startTime + 86400 + 60);
+    while (nextOccurrence(&iter, &occurrence)) {
+        count++;
+    }
+    closeOccurrenceIter(&iter);
+    CuAssertIntEquals(tc, 24 * 20 + 1, count);
+    CuAssertTrue(tc, nextOccurrence(&iter, &occurrence) == False);
+
+    freeScheduleEntry(entry);
+}
+
 /**
  * Test File Parsing
  */
 void TestFileParse(CuTest *tc) {
-    extern FILE *yyin;
-	yyin = fopen("testSched.dat", "r");
-    CuAssertPtrNotNullMsg(tc, "Failed to open input file: testSched.dat", yyin);
+    FILE *file;
+	file = fopen("testSched.dat", "r");
+    CuAssertPtrNotNullMsg(tc, "Failed to open input file: testSched.dat", file);
+
+    CuAssertIntEquals(tc, 0, parseScheduleFile(testContext, file));
+
+    fclose(file);
+}
+
+#define PARSE_THREADS 4
+
+/**
+ * Thread body for TestParallelParse.  Parses testSched.dat into the context
+ * passed as arg and returns the parse status.
+ */
+void * parseTestFile(void * arg) {
+    FILE *file;
+    intptr_t status = -1;
+
+    file = fopen("testSched.dat", "r");
+    if (file != NULL) {
+        status = parseScheduleFile((scheduleContext *)arg, file);
+        fclose(file);
+    }
+    return (void *)status;
+}
+
+/**
+ * Test that several files may be parsed at once, each into its own schedule.
+ * Runs after TestFileParse, so the test schedule holds only the file entries.
+ */
+void TestParallelParse(CuTest *tc) {
+    pthread_t threads[PARSE_THREADS];
+    scheduleContext *contexts[PARSE_THREADS];
+    void *status;
+    int idx;
+
+    for (idx = 0; idx < PARSE_THREADS; idx++) {
+        contexts[idx] = createScheduleContext();
+        CuAssertIntEquals(tc, 0, pthread_create(&threads[idx], NULL, 
+                    parseTestFile, contexts[idx]));
+    }
+    for (idx = 0; idx < PARSE_THREADS; idx++) {
+        pthread_join(threads[idx], &status);
+        CuAssertIntEquals(tc, 0, (int)(intptr_t)status);
+        CuAssertIntEquals(tc, testContext->scheduleCount, 
+                contexts[idx]->scheduleCount);
+        freeScheduleContext(contexts[idx]);
+    }
+}
+
+/**
+ * Assert that both schedules hold the same entries and actions in the same
+ * order.
+ */
+void assertSameSchedule(CuTest *tc, scheduleContext *expectedCtx, 
+        scheduleContext *actualCtx) {
+    scheduleNode *node, *expected;
+    actionNode *action, *expectedAction;
+
+    CuAssertIntEquals(tc, expectedCtx->scheduleCount, 
+            actualCtx->scheduleCount);
+    expected = getScheduleEntries(expectedCtx);
+    for (node = getScheduleEntries(actualCtx); node != NULL; 
+            node = node->next) {
+        CuAssertPtrNotNull(tc, expected);
+        CuAssertStrEquals(tc, expected->entry->task, node->entry->task);
+        CuAssertStrEquals(tc, expected->entry->reminderMessage, 
+                node->entry->reminderMessage);
+        CuAssertIntEquals(tc, expected->entry->durationInMin, 
+                node->entry->durationInMin);
+        CuAssertIntEquals(tc, expected->entry->year.type, 
+                node->entry->year.type);
+        CuAssertTrue(tc, expected->entry->compiled.minute 
+                == node->entry->compiled.minute);
+        CuAssertTrue(tc, expected->entry->compiled.hour 
+                == node->entry->compiled.hour);
+        CuAssertTrue(tc, expected->entry->compiled.dayOfMonth 
+                == node->entry->compiled.dayOfMonth);
+        CuAssertTrue(tc, expected->entry->compiled.monOfYear 
+                == node->entry->compiled.monOfYear);
+        CuAssertTrue(tc, expected->entry->compiled.dayOfWeek 
+                == node->entry->compiled.dayOfWeek);
+        expectedAction = expected->entry->actionSet;
+        for (action = node->entry->actionSet; action != NULL; 
+                action = action->next) {
+            CuAssertPtrNotNull(tc, expectedAction);
+            CuAssertStrEquals(tc, expectedAction->action->name, 
+                    action->action->name);
+            CuAssertStrEquals(tc, expectedAction->action->command, 
+                    action->action->command);
+            expectedAction = expectedAction->next;
+        }
+        CuAssertPtrEquals(tc, NULL, expectedAction);
+        expected = expected->next;
+    }
+    CuAssertPtrEquals(tc, NULL, expected);
+
+    expectedAction = expectedCtx->cmdHead;
+    for (action = actualCtx->cmdHead; action != NULL; action = action->next) {
+        CuAssertPtrNotNull(tc, expectedAction);
+        CuAssertStrEquals(tc, expectedAction->action->name, 
+                action->action->name);
+        CuAssertIntEquals(tc, expectedAction->action->type, 
+                action->action->type);
+        expectedAction = expectedAction->next;
+    }
+    CuAssertPtrEquals(tc, NULL, expectedAction);
+}
+
+/**
+ * Test that the mapped parser builds the same schedule as the bison parser.
+ * Runs after TestFileParse, so the test schedule holds only the file entries.
+ */
+void TestMappedParse(CuTest *tc) {
+    scheduleContext *mapped;
+    FILE *file;
+
+    mapped = createScheduleContext();
+    file = fopen("testSched.dat", "r");
+    CuAssertPtrNotNullMsg(tc, "Failed to open input file: testSched.dat", file);
+    CuAssertIntEquals(tc, 0, parseMappedScheduleFile(mapped, file));
+    fclose(file);
+
+    assertSameSchedule(tc, testContext, mapped);
+    CuAssertTrue(tc, getScheduleEntries(mapped)->entry->sharedText == True);
+    CuAssertPtrNotNull(tc, findActionCommand(mapped, "#growl"));
+    freeScheduleContext(mapped);
+
+    // Entries before a syntax error are kept.
+    mapped = createScheduleContext();
+    file = tmpfile();
+    CuAssertPtrNotNull(tc, file);
+    fputs("* * * * 8 13 30 \"Kept\" \"Quote \\\"me\\\"\"\n"
+            "* * * * 8 x 30 \"Bad\" \"Bad\"\n", file);
+    fflush(file);
+    CuAssertTrue(tc, parseMappedScheduleFile(mapped, file) != 0);
+    fclose(file);
+    CuAssertIntEquals(tc, 1, mapped->scheduleCount);
+    CuAssertStrEquals(tc, "Quote \"me\"", 
+            getScheduleEntries(mapped)->entry->reminderMessage);
+    freeScheduleContext(mapped);
+
+    // Both parsers reject an entry using an undefined action.
+    file = tmpfile();
+    CuAssertPtrNotNull(tc, file);
+    fputs("* * * * 8 13 30 \"Bad\" \"Bad\" #missing\n", file);
+    fflush(file);
+    mapped = createScheduleContext();
+    CuAssertTrue(tc, parseMappedScheduleFile(mapped, file) != 0);
+    CuAssertIntEquals(tc, 0, mapped->scheduleCount);
+    freeScheduleContext(mapped);
+    rewind(file);
+    mapped = createScheduleContext();
+    CuAssertTrue(tc, parseScheduleFile(mapped, file) != 0);
+    CuAssertIntEquals(tc, 0, mapped->scheduleCount);
+    freeScheduleContext(mapped);
+    fclose(file);
+}
+
+/**
+ * Copy testSched.dat to the file, appending extra if not NULL.
+ */
+void copyTestSchedule(CuTest *tc, const char *fileName, const char *extra) {
+    FILE *in, *out;
+    char buffer[512];
+    size_t length;
+
+    in = fopen("testSched.dat", "r");
+    CuAssertPtrNotNull(tc, in);
+    out = fopen(fileName, "w");
+    CuAssertPtrNotNull(tc, out);
+    while ((length = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+        fwrite(buffer, 1, length, out);
+    }
+    if (extra != NULL) {
+        fputs(extra, out);
+    }
+    fclose(in);
+    fclose(out);
+}
+
+/**
+ * Test that the cache is built on first use, loaded when the schedule file
+ * is unchanged, even if touched, and rebuilt when the file changes.  Entries 
+ * loaded from the cache share the text of the mapped cache, so sharedText 
+ * shows where the schedule came from.
+ * Runs after TestFileParse, so the test schedule holds only the file entries.
+ */
+void TestScheduleCache(CuTest *tc) {
+    char fileName[] = "/tmp/scheduleCacheXXXXXX";
+    char cacheName[sizeof(fileName) + sizeof(SCHEDULE_CACHE_SUFFIX)];
+    struct timeval times[2] = {{1000000, 0}, {1000000, 0}};
+    scheduleContext *cached;
+    int fd;
+
+    fd = mkstemp(fileName);
+    CuAssertTrue(tc, fd >= 0);
+    close(fd);
+    snprintf(cacheName, sizeof(cacheName), "%s%s", fileName, 
+            SCHEDULE_CACHE_SUFFIX);
+    copyTestSchedule(tc, fileName, NULL);
+
+    // Built while parsing.
+    cached = createScheduleContext();
+    CuAssertIntEquals(tc, SUCCESS, 
+            loadScheduleCached(cached, fileName, PARSER_BISON));
+    CuAssertIntEquals(tc, 0, access(cacheName, R_OK));
+    CuAssertTrue(tc, getScheduleEntries(cached)->entry->sharedText == False);
+    freeScheduleContext(cached);
+
+    // Loaded from the cache.
+    cached = createScheduleContext();
+    CuAssertIntEquals(tc, SUCCESS, 
+            loadScheduleCached(cached, fileName, PARSER_BISON));
+    CuAssertTrue(tc, getScheduleEntries(cached)->entry->sharedText == True);
+    assertSameSchedule(tc, testContext, cached);
+    freeScheduleContext(cached);
+
+    // Touched, but unchanged.
+    CuAssertIntEquals(tc, 0, utimes(fileName, times));
+    cached = createScheduleContext();
+    loadScheduleCached(cached, fileName, PARSER_BISON);
+    CuAssertTrue(tc, getScheduleEntries(cached)->entry->sharedText == True);
+    assertSameSchedule(tc, testContext, cached);
+    freeScheduleContext(cached);
+
+    // Changed, keeping the same modification time.
+    copyTestSchedule(tc, fileName, 
+            "* * * * * 30 5 \"Added\" \"Added to the file\"\n");
+    CuAssertIntEquals(tc, 0, utimes(fileName, times));
+    cached = createScheduleContext();
+    loadScheduleCached(cached, fileName, PARSER_MAPPED);
+    CuAssertIntEquals(tc, testContext->scheduleCount + 1, 
+            cached->scheduleCount);
+    freeScheduleContext(cached);
+    cached = createScheduleContext();
+    loadScheduleCached(cached, fileName, PARSER_BISON);
+    CuAssertIntEquals(tc, testContext->scheduleCount + 1, 
+            cached->scheduleCount);
+    CuAssertStrEquals(tc, "Added", cached->schedTail->entry->task);
+    CuAssertTrue(tc, cached->schedTail->entry->sharedText == True);
+    freeScheduleContext(cached);
+
+    unlink(cacheName);
+    unlink(fileName);
+}
+
+/**
+ * Add an entry at the minute of TEST_HOUR each day using the echo action.
+ */
+void addReloadEntry(scheduleContext *ctx, int minute, const char *task,
+        const char *reminder) {
+    valueStruct *wild, *hour, *min;
+
+    wild = createWildcardValue();
+    hour = createSingleValue(TEST_HOUR);
+    min = createSingleValue(minute);
+    addScheduleEntryNormalize(ctx, wild, wild, wild, wild, hour, min, 0, 
+            task, reminder, createActionSet(findActionCommand(ctx, "echo")));
+    freeValueStruct(wild);
+    freeValueStruct(hour);
+    freeValueStruct(min);
+}
+
+/**
+ * Test that a reload keeps unchanged entries and their actions, removes 
+ * changed and removed entries from the alarm queue or wheel and schedules 
+ * added and changed entries.  The entry added is earlier than the alarm 
+ * already returned, so it is returned first.  Kept entries keep their text
+ * and only added text is interned, until removed text outgrows the pool.
+ */
+void TestScheduleReload(CuTest *tc) {
+    enum DispatchMode modes[] = {DISPATCH_QUEUE, DISPATCH_WHEEL};
+    const char *expected[] = {"Added", "Kept", "Changed"};
+    scheduleContext *ctx, *fresh;
+    scheduleEntry *kept;
+    actionDef *echo;
+    scheduledExec *nextExec;
+    reloadStats stats;
+    struct tm current;
+    char reminder[20];
+    uint32_t keptId;
+    int mode, idx;
+
+    memset(&current, 0, sizeof(struct tm));
+    current.tm_year = TEST_YEAR;
+    current.tm_mon = TEST_MON;
+    current.tm_mday = TEST_DAY_OF_MON;
+    current.tm_hour = TEST_HOUR;
+    current.tm_min = TEST_MIN;
+    current.tm_isdst = -1;
+    for (mode = 0; mode < 2; mode++) {
+        ctx = createScheduleContext();
+        setDispatchMode(ctx, modes[mode]);
+        setTestTime(ctx, mktime(&current));
+        addActionCommand(ctx, "echo", "echo %s", ON_DEMAND);
+        echo = findActionCommand(ctx, "echo");
+        addReloadEntry(ctx, TEST_MIN + 2, "Kept", "Unchanged");
+        addReloadEntry(ctx, TEST_MIN + 3, "Changed", "Before");
+        addReloadEntry(ctx, TEST_MIN + 4, "Removed", "Removed");
+        kept = getScheduleEntries(ctx)->entry;
+        keptId = kept->taskId;
+        nextExec = calcNextTaskAlarm(ctx);
+        CuAssertStrEquals(tc, "Kept", nextExec->taskHead->entry->task);
+        freeScheduleNodeList(nextExec->taskHead);
+        free(nextExec);
+
+        fresh = createScheduleContext();
+        addActionCommand(fresh, "echo", "echo %s", ON_DEMAND);
+        addReloadEntry(fresh, TEST_MIN + 1, "Added", "Added");
+        addReloadEntry(fresh, TEST_MIN + 2, "Kept", "Unchanged");
+        addReloadEntry(fresh, TEST_MIN + 3, "Changed", "After");
+        applyScheduleReload(ctx, fresh, &stats);
+        CuAssertPtrEquals(tc, NULL, getScheduleEntries(fresh));
+        freeScheduleContext(fresh);
+
+        CuAssertIntEquals(tc, 2, stats.added);
+        CuAssertIntEquals(tc, 2, stats.removed);
+        CuAssertIntEquals(tc, 1, stats.unchanged);
+        CuAssertIntEquals(tc, 3, ctx->scheduleCount);
+        CuAssertPtrEquals(tc, kept, getScheduleEntries(ctx)->next->entry);
+        // Before and Removed remain until the pool is rebuilt.
+        CuAssertIntEquals(tc, 7, getStringPoolCount(ctx->strings));
+        CuAssertIntEquals(tc, keptId, kept->taskId);
+        CuAssertStrEquals(tc, "Unchanged", kept->reminderMessage);
+        CuAssertPtrEquals(tc, echo, findActionCommand(ctx, "echo"));
+        CuAssertPtrEquals(tc, echo, 
+                getScheduleEntries(ctx)->entry->actionSet->action);
+
+        for (idx = 0; idx < 3; idx++) {
+            nextExec = calcNextTaskAlarm(ctx);
+            CuAssertPtrNotNull(tc, nextExec);
+            CuAssertStrEquals(tc, expected[idx], 
+                    nextExec->taskHead->entry->task);
+            CuAssertPtrEquals(tc, NULL, nextExec->taskHead->next);
+            setTestTime(ctx, nextExec->absTime);
+            freeScheduleNodeList(nextExec->taskHead);
+            free(nextExec);
+        }
+
+        // Each reload adds a string until the pool holds more than 4 per
+        // entry, when it is rebuilt from the 5 strings of the entries.
+        for (idx = 0; idx < 6; idx++) {
+            fresh = createScheduleContext();
+            addActionCommand(fresh, "echo", "echo %s", ON_DEMAND);
+            addReloadEntry(fresh, TEST_MIN + 1, "Added", "Added");
+            addReloadEntry(fresh, TEST_MIN + 2, "Kept", "Unchanged");
+            sprintf(reminder, "After %d", idx);
+            addReloadEntry(fresh, TEST_MIN + 3, "Changed", reminder);
+            applyScheduleReload(ctx, fresh, &stats);
+            freeScheduleContext(fresh);
+            CuAssertIntEquals(tc, idx < 5 ? 8 + idx : 5, 
+                    getStringPoolCount(ctx->strings));
+        }
+        CuAssertStrEquals(tc, "After 5", ctx->schedTail->entry->reminderMessage);
+        CuAssertStrEquals(tc, "Unchanged", kept->reminderMessage);
+        CuAssertPtrEquals(tc, kept->task, 
+                (char *)poolString(ctx->strings, kept->taskId));
+        freeScheduleContext(ctx);
+    }
+}
 
-    CuAssertIntEquals(tc, 0, yyparse());
+/**
+ * Test that the watch reports the schedule file being written and that
+ * reloading the file only changes what changed in the file.  A file with 
+ * errors leaves the schedule as is.
+ * Runs after TestFileParse, so the test schedule holds only the file entries.
+ */
+void TestReloadScheduleFile(CuTest *tc) {
+    char fileName[] = "/tmp/scheduleReloadXXXXXX";
+    scheduleContext *ctx;
+    reloadStats stats;
+    int fd;
+
+    fd = mkstemp(fileName);
+    CuAssertTrue(tc, fd >= 0);
+    close(fd);
+    ctx = createScheduleContext();
+    CuAssertIntEquals(tc, SUCCESS, 
+            watchScheduleFile(ctx, fileName, PARSER_BISON));
+    CuAssertTrue(tc, readScheduleWatch(ctx->watch) == False);
+    copyTestSchedule(tc, fileName, NULL);
+    CuAssertTrue(tc, readScheduleWatch(ctx->watch) == True);
+    CuAssertTrue(tc, readScheduleWatch(ctx->watch) == False);
+
+    CuAssertIntEquals(tc, SUCCESS, 
+            reloadScheduleFile(ctx, fileName, PARSER_BISON, &stats));
+    CuAssertIntEquals(tc, testContext->scheduleCount, stats.added);
+    assertSameSchedule(tc, testContext, ctx);
+
+    copyTestSchedule(tc, fileName, 
+            "* * * * * 30 5 \"Added\" \"Added to the file\"\n");
+    CuAssertIntEquals(tc, SUCCESS, 
+            reloadScheduleFile(ctx, fileName, PARSER_MAPPED, &stats));
+    CuAssertIntEquals(tc, 1, stats.added);
+    CuAssertIntEquals(tc, 0, stats.removed);
+    CuAssertIntEquals(tc, testContext->scheduleCount, stats.unchanged);
+    CuAssertStrEquals(tc, "Added", ctx->schedTail->entry->task);
+    CuAssertTrue(tc, ctx->schedTail->entry->sharedText == False);
+
+    copyTestSchedule(tc, fileName, "* * * * * 30 \"Missing duration\"\n");
+    CuAssertIntEquals(tc, ERROR, 
+            reloadScheduleFile(ctx, fileName, PARSER_BISON, &stats));
+    CuAssertIntEquals(tc, testContext->scheduleCount + 1, ctx->scheduleCount);
+    freeScheduleContext(ctx);
+
+    // Kept entries stop referring to the mapped file, so rewriting it 
+    // leaves their text as is.
+    copyTestSchedule(tc, fileName, NULL);
+    ctx = createScheduleContext();
+    CuAssertIntEquals(tc, SUCCESS, 
+            loadScheduleFile(ctx, fileName, PARSER_MAPPED));
+    CuAssertIntEquals(tc, SUCCESS, 
+            reloadScheduleFile(ctx, fileName, PARSER_MAPPED, &stats));
+    CuAssertIntEquals(tc, testContext->scheduleCount, stats.unchanged);
+    CuAssertPtrEquals(tc, NULL, ctx->mappedFiles);
+    CuAssertTrue(tc, ctx->schedHead->entry->sharedText == False);
+    copyTestSchedule(tc, fileName, 
+            "* * * * * 30 5 \"Added\" \"Added to the file\"\n");
+    assertSameSchedule(tc, testContext, ctx);
+
+    freeScheduleContext(ctx);
+    unlink(fileName);
+}
+
+/**
+ * Test that a schedule is allocated from its generation in few chunks and 
+ * that a reload keeps an older generation only while it holds kept entries
+ * or actions.
+ */
+void TestScheduleArena(CuTest *tc) {
+    scheduleContext *ctx, *fresh;
+    arenaStats stats;
+    int idx;
+
+    ctx = createScheduleContext();
+    addActionCommand(ctx, "echo", "echo %s", ON_DEMAND);
+    for (idx = 0; idx < 50; idx++) {
+        addReloadEntry(ctx, idx, "Kept", "Unchanged");
+    }
+    getArenaStats(ctx->arena, &stats);
+    CuAssertIntEquals(tc, 1, stats.generations);
+    CuAssertIntEquals(tc, 1, stats.chunks);
+    CuAssertTrue(tc, stats.allocs > 50 * 2);
+    CuAssertTrue(tc, stats.bytesUsed <= stats.bytesReserved);
+    CuAssertIntEquals(tc, 51, ctx->arena->liveCount);
+
+    // The first generation holds the kept entries and action.
+    fresh = createScheduleContext();
+    addActionCommand(fresh, "echo", "echo %s", ON_DEMAND);
+    addReloadEntry(fresh, 0, "Kept", "Unchanged");
+    addReloadEntry(fresh, 1, "Added", "Added");
+    applyScheduleReload(ctx, fresh, NULL);
+    freeScheduleContext(fresh);
+    getArenaStats(ctx->arena, &stats);
+    CuAssertIntEquals(tc, 2, stats.generations);
+    CuAssertIntEquals(tc, 2, ctx->arena->next->liveCount);
+
+    // Nothing is kept once the action changes, so both are dropped.
+    fresh = createScheduleContext();
+    addActionCommand(fresh, "echo", "echo %{task}", ON_DEMAND);
+    addReloadEntry(fresh, 0, "Kept", "Unchanged");
+    applyScheduleReload(ctx, fresh, NULL);
+    freeScheduleContext(fresh);
+    getArenaStats(ctx->arena, &stats);
+    CuAssertIntEquals(tc, 1, stats.generations);
+    CuAssertIntEquals(tc, 1, ctx->scheduleCount);
+
+    freeSchedule(ctx);
+    CuAssertPtrEquals(tc, NULL, ctx->arena);
+    freeScheduleContext(ctx);
+}
+
+/**
+ * Test that entries with the same text share one interned copy and that 
+ * events refer to the text of the entry rather than copying it.
+ */
+void TestStringPool(CuTest *tc) {
+    scheduleContext *ctx;
+    scheduleEntry *first, *second;
+    eventEntry **events;
+    struct tm current;
+    int numEvents;
+
+    memset(&current, 0, sizeof(struct tm));
+    current.tm_year = TEST_YEAR;
+    current.tm_mon = TEST_MON;
+    current.tm_mday = TEST_DAY_OF_MON;
+    current.tm_hour = TEST_HOUR;
+    current.tm_min = TEST_MIN;
+    current.tm_isdst = -1;
+    ctx = createScheduleContext();
+    setTestTime(ctx, mktime(&current));
+    addActionCommand(ctx, "echo", "echo %s", ON_DEMAND);
+    addReloadEntry(ctx, TEST_MIN + 1, "Lunch", "Stand up");
+    addReloadEntry(ctx, TEST_MIN + 2, "Walk", "Stand up");
+    first = getScheduleEntries(ctx)->entry;
+    second = getScheduleEntries(ctx)->next->entry;
+    CuAssertPtrEquals(tc, first->reminderMessage, second->reminderMessage);
+    CuAssertIntEquals(tc, first->reminderId, second->reminderId);
+    CuAssertTrue(tc, first->taskId != second->taskId);
+    CuAssertStrEquals(tc, "Walk", poolString(ctx->strings, second->taskId));
+    CuAssertIntEquals(tc, 3, getStringPoolCount(ctx->strings));
+
+    events = getScheduledEvents(ctx, mktime(&current), 
+            mktime(&current) + 3600, &numEvents);
+    CuAssertIntEquals(tc, 2, numEvents);
+    CuAssertPtrEquals(tc, first->task, events[0]->task);
+    CuAssertIntEquals(tc, second->taskId, events[1]->taskId);
+    CuAssertPtrEquals(tc, second->reminderMessage, events[1]->reminderMessage);
+    freeEventSchedule(events, numEvents);
+    freeScheduleContext(ctx);
+}
+
+/**
+ * Test that entries are stored by ID in the order added, that scheduled 
+ * events are found from the store as the time moves forward and back, and
+ * that a reload keeps the IDs of kept entries and gives added entries the
+ * IDs of removed entries.
+ */
+void TestEntryStore(CuTest *tc) {
+    scheduleContext *ctx, *fresh;
+    scheduleEntry *kept;
+    entryStore *store;
+    eventEntry **events;
+    struct tm current;
+    time_t now;
+    int numEvents;
+
+    memset(&current, 0, sizeof(struct tm));
+    current.tm_year = TEST_YEAR;
+    current.tm_mon = TEST_MON;
+    current.tm_mday = TEST_DAY_OF_MON;
+    current.tm_hour = TEST_HOUR;
+    current.tm_min = TEST_MIN;
+    current.tm_isdst = -1;
+    now = mktime(&current);
+    ctx = createScheduleContext();
+    setTestTime(ctx, now);
+    addActionCommand(ctx, "echo", "echo %s", ON_DEMAND);
+    addReloadEntry(ctx, TEST_MIN + 1, "Removed", "Removed");
+    addReloadEntry(ctx, TEST_MIN + 2, "Kept", "Unchanged");
+    store = ctx->store;
+    kept = getScheduleEntries(ctx)->next->entry;
+    CuAssertIntEquals(tc, 1, kept->storeId);
+    CuAssertIntEquals(tc, 2, getStoreEntryCount(store));
+    CuAssertTrue(tc, store->flags[1] & ENTRY_ANY_YEAR);
+
+    events = getScheduledEvents(ctx, now, now + 3600, &numEvents);
+    CuAssertIntEquals(tc, 2, numEvents);
+    CuAssertStrEquals(tc, "Removed", events[0]->task);
+    freeEventSchedule(events, numEvents);
+    // The first entry is reached, so only it moves to the next day.
+    setTestTime(ctx, now + 60);
+    events = getScheduledEvents(ctx, now, now + 3600, &numEvents);
+    CuAssertIntEquals(tc, 1, numEvents);
+    CuAssertStrEquals(tc, "Kept", events[0]->task);
+    freeEventSchedule(events, numEvents);
+    setTestTime(ctx, now);
+    events = getScheduledEvents(ctx, now, now + 3600, &numEvents);
+    CuAssertIntEquals(tc, 2, numEvents);
+    freeEventSchedule(events, numEvents);
+
+    fresh = createScheduleContext();
+    addActionCommand(fresh, "echo", "echo %s", ON_DEMAND);
+    addReloadEntry(fresh, TEST_MIN + 2, "Kept", "Unchanged");
+    addReloadEntry(fresh, TEST_MIN + 3, "Added", "Added");
+    applyScheduleReload(ctx, fresh, NULL);
+    freeScheduleContext(fresh);
+    CuAssertPtrEquals(tc, store, ctx->store);
+    CuAssertIntEquals(tc, 1, kept->storeId);
+    CuAssertIntEquals(tc, 0, getScheduleEntries(ctx)->next->entry->storeId);
+    CuAssertIntEquals(tc, 2, store->count);
+    CuAssertIntEquals(tc, 2, getStoreEntryCount(store));
+    events = getScheduledEvents(ctx, now, now + 3600, &numEvents);
+    CuAssertIntEquals(tc, 2, numEvents);
+    CuAssertStrEquals(tc, "Kept", events[0]->task);
+    CuAssertStrEquals(tc, "Added", events[1]->task);
+    freeEventSchedule(events, numEvents);
+    freeScheduleContext(ctx);
+}
+
+/**
+ * Test that each kernel matches the entries whose next time from the 
+ * previous minute is the minute matched, over enough entries for full 
+ * blocks and a partial one, and that match dispatch returns the same alarms
+ * as the queue.
+ */
+void TestMatchEntriesAt(CuTest *tc) {
+    enum MatchKernel kernels[] = {MATCH_SCALAR, MATCH_SSE4, MATCH_AVX2};
+    enum DispatchMode modes[] = {DISPATCH_QUEUE, DISPATCH_MATCH};
+    scheduleContext *ctx;
+    scheduleNode *node;
+    scheduleEntry *matches[100];
+    valueStruct *year, *dom, *dow, *hour, *min, *wild;
+    scheduledExec *nextExec;
+    struct tm current;
+    time_t now, minuteTime, alarmTimes[2];
+    int idx, kernel, expected, numMatches, mode, alarmCounts[2];
+
+    memset(&current, 0, sizeof(struct tm));
+    current.tm_year = TEST_YEAR;
+    current.tm_mon = TEST_MON;
+    current.tm_mday = TEST_DAY_OF_MON;
+    current.tm_hour = TEST_HOUR;
+    current.tm_min = TEST_MIN;
+    current.tm_isdst = -1;
+    now = mktime(&current);
+    ctx = createScheduleContext();
+    setTestTime(ctx, now);
+    wild = createWildcardValue();
+    for (idx = 0; idx < 100; idx++) {
+        year = idx == 50 ? createSingleValue(TEST_YEAR + 1900) 
+            : idx == 51 ? createSingleValue(TEST_YEAR + 1901) : wild;
+        dom = idx % 7 == 0 ? createSingleValue(TEST_DAY_OF_MON + idx % 2) 
+            : wild;
+        dow = idx % 5 == 0 ? createSingleValue(1 + idx % 7) : wild;
+        hour = idx % 4 == 0 ? wild 
+            : createRangeValue(TEST_HOUR, TEST_HOUR + idx % 3, 1);
+        min = idx % 3 == 0 ? createRangeValue(idx % 60, 59, 1 + idx % 5)
+            : idx % 3 == 1 ? createSingleValue(idx % 60) : wild;
+        addScheduleEntryNormalize(ctx, year, wild, dom, dow, hour, min, 0,
+                "Match", "Match", NULL);
+        if (year != wild) freeValueStruct(year);
+        if (dom != wild) freeValueStruct(dom);
+        if (dow != wild) freeValueStruct(dow);
+        if (hour != wild) freeValueStruct(hour);
+        if (min != wild) freeValueStruct(min);
+    }
+    freeValueStruct(wild);
+
+    for (minuteTime = now + 60; minuteTime < now + 4 * 3600; 
+            minuteTime += 60) {
+        expected = 0;
+        for (node = getScheduleEntries(ctx); node != NULL; node = node->next) {
+            if (calcNextTimeForTaskFrom(node->entry, minuteTime - 60) 
+                    == minuteTime) {
+                matches[expected++] = node->entry;
+            }
+        }
+        for (kernel = 0; kernel < 3; kernel++) {
+            setMatchKernel(kernels[kernel]);
+            numMatches = matchEntriesAt(ctx, minuteTime, matches, 100);
+            CuAssertIntEquals(tc, expected, numMatches);
+        }
+    }
+    setMatchKernel(MATCH_AUTO);
+    // The buffer bounds the entries returned.
+    CuAssertIntEquals(tc, 2, matchEntriesAt(ctx, now + 60, matches, 2));
+
+    for (idx = 0; idx < 5; idx++) {
+        for (mode = 0; mode < 2; mode++) {
+            setDispatchMode(ctx, modes[mode]);
+            nextExec = calcNextTaskAlarm(ctx);
+            CuAssertPtrNotNull(tc, nextExec);
+            alarmTimes[mode] = nextExec->absTime;
+            alarmCounts[mode] = 0;
+            for (node = nextExec->taskHead; node != NULL; node = node->next) {
+                alarmCounts[mode]++;
+            }
+            freeScheduleNodeList(nextExec->taskHead);
+            free(nextExec);
+        }
+        CuAssertTrue(tc, alarmTimes[0] == alarmTimes[1]);
+        CuAssertIntEquals(tc, alarmCounts[0], alarmCounts[1]);
+        setTestTime(ctx, alarmTimes[0] + 600);
+    }
+    freeScheduleContext(ctx);
+
+    // An alarm later than the minutes searched is found from next times.
+    ctx = createScheduleContext();
+    setTestTime(ctx, now);
+    setDispatchMode(ctx, DISPATCH_MATCH);
+    addReloadEntry(ctx, TEST_MIN - 1, "Tomorrow", "Tomorrow");
+    nextExec = calcNextTaskAlarm(ctx);
+    CuAssertPtrNotNull(tc, nextExec);
+    CuAssertTrue(tc, nextExec->absTime == now + 86400 - 60);
+    CuAssertStrEquals(tc, "Tomorrow", nextExec->taskHead->entry->task);
+    freeScheduleNodeList(nextExec->taskHead);
+    free(nextExec);
+    freeScheduleContext(ctx);
+}
+
+/**
+ * Set the time zone for the test, returning the previous TZ to be passed to
+ * restoreTimeZone.  Cached offsets are discarded by resetTaskAlarmQueue.
+ */
+char * useTimeZone(scheduleContext *ctx, const char *zone) {
+    char *previous = getenv("TZ");
+
+    previous = previous != NULL ? strdup(previous) : NULL;
+    setenv("TZ", zone, 1);
+    resetTaskAlarmQueue(ctx);
+    return previous;
+}
+
+void restoreTimeZone(scheduleContext *ctx, char *previous) {
+    if (previous != NULL) {
+        setenv("TZ", previous, 1);
+        free(previous);
+    }
+    else {
+        unsetenv("TZ");
+    }
+    resetTaskAlarmQueue(ctx);
+}
+
+// Events recorded by recordAgendaEvent
+typedef struct _agendaRecord {
+    time_t times[128];
+    const char *tasks[128];
+    int count;
+} agendaRecord;
+
+/**
+ * Agenda callback recording each event in the agendaRecord userData.
+ */
+Bool recordAgendaEvent(eventEntry * event, void * userData) {
+    agendaRecord *record = userData;
+
+    if (record->count == 128) {
+        return False;
+    }
+    record->times[record->count] = event->nextTime;
+    record->tasks[record->count] = event->task;
+    record->count++;
+    return True;
+}
+
+/**
+ * Test that the agenda and the schedule for today on the days DST starts 
+ * and ends list the same events as the alarms returned by 
+ * calcNextTaskAlarm.  The minutes of an entry within the skipped hour 
+ * collapse into one occurrence after it.
+ */
+void TestAgendaDst(CuTest *tc) {
+    // 2010-03-14 and 2010-11-07 in America/Los_Angeles
+    int dstDays[][2] = {{2, 14}, {10, 7}};
+    // Occurrences of the entry every minute of 2:00 - 2:59 on each day
+    int gapCounts[] = {1, 60};
+    scheduleContext *ctx;
+    valueStruct *wild, *hour, *min;
+    scheduledExec *nextExec;
+    scheduleNode *node;
+    agendaRecord record;
+    struct tm current;
+    FILE *out;
+    char line[256], *previousZone;
+    time_t startTime, stopTime;
+    int day, idx, gapCount;
+
+    ctx = createScheduleContext();
+    previousZone = useTimeZone(ctx, "America/Los_Angeles");
+    wild = createWildcardValue();
+    hour = createSingleValue(2);
+    addScheduleEntryNormalize(ctx, wild, wild, wild, wild, hour, wild, 0,
+            "Gap", "Gap", NULL);
+    min = createSingleValue(30);
+    addScheduleEntryNormalize(ctx, wild, wild, wild, wild, hour, min, 0,
+            "Skipped", "Skipped", NULL);
+    freeValueStruct(hour);
+    hour = createSingleValue(1);
+    addScheduleEntryNormalize(ctx, wild, wild, wild, wild, hour, min, 0,
+            "Repeated", "Repeated", NULL);
+    freeValueStruct(hour);
+    freeValueStruct(min);
+    min = createSingleValue(45);
+    addScheduleEntryNormalize(ctx, wild, wild, wild, wild, wild, min, 0,
+            "Hourly", "Hourly", NULL);
+    freeValueStruct(min);
+    freeValueStruct(wild);
+
+    for (day = 0; day < 2; day++) {
+        memset(&current, 0, sizeof(struct tm));
+        current.tm_year = 2010 - 1900;
+        current.tm_mon = dstDays[day][0];
+        current.tm_mday = dstDays[day][1];
+        current.tm_isdst = -1;
+        startTime = mktime(&current);
+        current.tm_hour = 23;
+        current.tm_min = 59;
+        current.tm_isdst = -1;
+        stopTime = mktime(&current);
+
+        record.count = 0;
+        generateAgenda(ctx, startTime, stopTime, recordAgendaEvent, &record);
+        setDispatchMode(ctx, DISPATCH_QUEUE);
+        setTestTime(ctx, startTime - 1);
+        idx = gapCount = 0;
+        while ((nextExec = calcNextTaskAlarm(ctx)) != NULL 
+                && nextExec->absTime <= stopTime) {
+            for (node = nextExec->taskHead; node != NULL; node = node->next) {
+                CuAssertTrue(tc, idx < record.count);
+                CuAssertTrue(tc, nextExec->absTime == record.times[idx]);
+                CuAssertStrEquals(tc, node->entry->task, record.tasks[idx]);
+                gapCount += strcmp(record.tasks[idx], "Gap") == 0;
+                idx++;
+            }
+            // As executeScheduledEntry does, so the queue is kept.
+            ctx->lastExecTime = nextExec->absTime;
+            freeScheduleNodeList(nextExec->taskHead);
+            free(nextExec);
+        }
+        if (nextExec != NULL) {
+            freeScheduleNodeList(nextExec->taskHead);
+            free(nextExec);
+        }
+        CuAssertIntEquals(tc, record.count, idx);
+        CuAssertIntEquals(tc, gapCounts[day], gapCount);
+
+        // The schedule for today lists the same events.
+        setTestTime(ctx, startTime);
+        out = tmpfile();
+        CuAssertPtrNotNull(tc, out);
+        displayTodaysSchedule(ctx, out);
+        rewind(out);
+        idx = gapCount = 0;
+        while (fgets(line, sizeof(line), out) != NULL) {
+            gapCount += strstr(line, "- Gap :") != NULL;
+            idx++;
+        }
+        fclose(out);
+        CuAssertIntEquals(tc, record.count, idx);
+        CuAssertIntEquals(tc, gapCounts[day], gapCount);
+    }
+    restoreTimeZone(ctx, previousZone);
+    freeScheduleContext(ctx);
+}
+
+/**
+ * Test that next times cached by the entry store are discarded when the
+ * time zone changes, so the next alarm is the entry's time in the new zone.
+ */
+void TestStoreTimesReset(CuTest *tc) {
+    scheduleContext *ctx;
+    valueStruct *wild, *hour, *min;
+    scheduledExec *nextExec;
+    char *previousZone;
+    time_t now, zoneTimes[2];
+    int zone;
+
+    ctx = createScheduleContext();
+    previousZone = useTimeZone(ctx, "America/Los_Angeles");
+    wild = createWildcardValue();
+    hour = createSingleValue(TEST_HOUR);
+    min = createSingleValue(TEST_MIN);
+    addScheduleEntryAdv(ctx, wild, wild, wild, wild, hour, min, 0, 
+            "Zone", "Zone");
+    freeValueStruct(wild);
+    freeValueStruct(hour);
+    freeValueStruct(min);
+    // 2010-05-28 00:00 UTC
+    now = 1275004800;
+    setTestTime(ctx, now);
+    for (zone = 0; zone < 2; zone++) {
+        if (zone == 1) {
+            useTimeZone(ctx, "UTC");
+        }
+        zoneTimes[zone] = calcNextTimeForTaskFrom(
+                getScheduleEntries(ctx)->entry, now);
+        nextExec = calcNextTaskAlarm(ctx);
+        CuAssertPtrNotNull(tc, nextExec);
+        CuAssertTrue(tc, nextExec->absTime == zoneTimes[zone]);
+        freeScheduleNodeList(nextExec->taskHead);
+        free(nextExec);
+    }
+    CuAssertTrue(tc, zoneTimes[1] == zoneTimes[0] - 7 * 3600);
+    restoreTimeZone(ctx, previousZone);
+    freeScheduleContext(ctx);
+}
+
+/**
+ * Test the civil calendar arithmetic against known dates: leap days, century
+ * years that are and are not leap years and dates before 1970.
+ */
+void TestCivilCalendar(CuTest *tc) {
+    calTime cal;
+    long days;
+
+    CuAssertIntEquals(tc, 0, daysFromCivil(1970, 0, 1));
+    CuAssertIntEquals(tc, -1, daysFromCivil(1969, 11, 31));
+    CuAssertIntEquals(tc, -25567, daysFromCivil(1900, 0, 1));
+    CuAssertIntEquals(tc, -135080, daysFromCivil(1600, 2, 1));
+    CuAssertIntEquals(tc, 11016, daysFromCivil(2000, 1, 29));
+    CuAssertIntEquals(tc, 47541, daysFromCivil(2100, 2, 1));
+    // 2000 is a leap year, 1900 and 2100 are not.
+    CuAssertIntEquals(tc, 1, daysFromCivil(2000, 2, 1) 
+            - daysFromCivil(2000, 1, 28) - 1);
+    CuAssertIntEquals(tc, 0, daysFromCivil(1900, 2, 1) 
+            - daysFromCivil(1900, 1, 28) - 1);
+    CuAssertIntEquals(tc, 0, daysFromCivil(2100, 2, 1) 
+            - daysFromCivil(2100, 1, 28) - 1);
+
+    civilFromDays(11016, &cal);
+    CuAssertIntEquals(tc, 2000, cal.year);
+    CuAssertIntEquals(tc, 1, cal.mon);
+    CuAssertIntEquals(tc, 29, cal.mday);
+    civilFromDays(-1, &cal);
+    CuAssertIntEquals(tc, 1969, cal.year);
+    CuAssertIntEquals(tc, 11, cal.mon);
+    CuAssertIntEquals(tc, 31, cal.mday);
+    civilFromDays(daysFromCivil(1900, 1, 28) + 1, &cal);
+    CuAssertIntEquals(tc, 1900, cal.year);
+    CuAssertIntEquals(tc, 2, cal.mon);
+    CuAssertIntEquals(tc, 1, cal.mday);
+    // Each day converts back to itself, before and after 1970.
+    for (days = -800000; days <= 800000; days += 997) {
+        civilFromDays(days, &cal);
+        CuAssertIntEquals(tc, days, 
+                daysFromCivil(cal.year, cal.mon, cal.mday));
+    }
+
+    // 1970-01-01 was a Thursday and 1900-01-01 a Monday.
+    CuAssertIntEquals(tc, 4, weekdayFromDays(0));
+    CuAssertIntEquals(tc, 3, weekdayFromDays(-1));
+    CuAssertIntEquals(tc, 1, weekdayFromDays(-25567));
+    CuAssertIntEquals(tc, 2, weekdayFromDays(11016));
+    CuAssertIntEquals(tc, 6, weekdayFromDays(-135080 - 4));
+
+    CuAssertIntEquals(tc, 0, floorDiv(59, 60));
+    CuAssertIntEquals(tc, 1, floorDiv(60, 60));
+    CuAssertIntEquals(tc, -1, floorDiv(-1, 60));
+    CuAssertIntEquals(tc, -1, floorDiv(-60, 60));
+    CuAssertIntEquals(tc, -2, floorDiv(-61, 60));
+    CuAssertIntEquals(tc, -4, floorDiv(7, -2));
+}
 
-    fclose(yyin);
+/**
+ * Test conversion between time_t and local calendar time under a fixed time
+ * zone on the days DST starts and ends.  The skipped local time converts to
+ * the time following the change and the repeated one to each occurrence in
+ * turn.  Every quarter hour of each day converts as localtime does.
+ */
+void TestCalTimeDst(CuTest *tc) {
+    scheduleContext *ctx;
+    calTime cal, back;
+    struct tm local;
+    char *previousZone;
+    time_t time, first, stopTime;
+    int day;
+
+    ctx = createScheduleContext();
+    previousZone = useTimeZone(ctx, "America/Los_Angeles");
+
+    // 2:30 is skipped on 2010-03-14.  Read as PST, it is 3:30 PDT.
+    cal.year = 2010;
+    cal.mon = 2;
+    cal.mday = 14;
+    cal.hour = 2;
+    cal.min = 30;
+    time = calTimeToTime(&cal, 0);
+    CuAssertTrue(tc, time == 1268562600);
+    timeToCalTime(time, &back);
+    CuAssertIntEquals(tc, 3, back.hour);
+    CuAssertIntEquals(tc, 30, back.min);
+
+    // 1:30 occurs in PDT then PST on 2010-11-07.
+    cal.mon = 10;
+    cal.mday = 7;
+    cal.hour = 1;
+    first = calTimeToTime(&cal, 0);
+    CuAssertTrue(tc, first == 1289118600);
+    time = calTimeToTime(&cal, first);
+    CuAssertTrue(tc, time == first + 3600);
+    timeToCalTime(first, &back);
+    CuAssertIntEquals(tc, 1, back.hour);
+    CuAssertIntEquals(tc, 30, back.min);
+    timeToCalTime(time, &back);
+    CuAssertIntEquals(tc, 1, back.hour);
+    CuAssertIntEquals(tc, 30, back.min);
+
+    // From the day before each change through the day after, both fixed days
+    // converted from the cache and the day of the change.
+    for (day = 0; day < 2; day++) {
+        memset(&local, 0, sizeof(struct tm));
+        local.tm_year = 2010 - 1900;
+        local.tm_mon = day == 0 ? 2 : 10;
+        local.tm_mday = day == 0 ? 13 : 6;
+        local.tm_isdst = -1;
+        time = mktime(&local);
+        for (stopTime = time + 3 * 86400; time < stopTime; time += 900) {
+            localtime_r(&time, &local);
+            timeToCalTime(time, &cal);
+            CuAssertIntEquals(tc, local.tm_year + 1900, cal.year);
+            CuAssertIntEquals(tc, local.tm_mon, cal.mon);
+            CuAssertIntEquals(tc, local.tm_mday, cal.mday);
+            CuAssertIntEquals(tc, local.tm_hour, cal.hour);
+            CuAssertIntEquals(tc, local.tm_min, cal.min);
+            CuAssertTrue(tc, calTimeToTime(&cal, time - 1) == time);
+        }
+    }
+    restoreTimeZone(ctx, previousZone);
+    freeScheduleContext(ctx);
+}
+
+/**
+ * Append the tasks of the alarm to names, separated by spaces, and free it.
+ */
+void appendAlarmTasks(scheduledExec *nextExec, char *names, size_t size) {
+    scheduleNode *node;
+
+    for (node = nextExec->taskHead; node != NULL; node = node->next) {
+        strncat(names, node->entry->task, size - strlen(names) - 1);
+        strncat(names, " ", size - strlen(names) - 1);
+    }
+    freeScheduleNodeList(nextExec->taskHead);
+    free(nextExec);
+}
+
+/**
+ * Test that match dispatch returns the same alarms as the queue across the 
+ * start and end of DST, where local times are skipped and repeated.  The 
+ * entry in the repeated hour is returned once.
+ */
+void TestMatchDispatchDst(CuTest *tc) {
+    enum DispatchMode modes[] = {DISPATCH_QUEUE, DISPATCH_MATCH};
+    // 2010-03-14 and 2010-11-07 in America/Los_Angeles
+    int dstDays[][2] = {{2, 14}, {10, 7}};
+    scheduleContext *ctx;
+    valueStruct *wild, *hour, *min;
+    scheduledExec *nextExec;
+    struct tm current;
+    char names[2][64], *previousZone;
+    time_t alarmTimes[2];
+    int day, idx, mode, repeatedCount;
+
+    ctx = createScheduleContext();
+    previousZone = useTimeZone(ctx, "America/Los_Angeles");
+    wild = createWildcardValue();
+    hour = createSingleValue(2);
+    min = createSingleValue(30);
+    addScheduleEntryNormalize(ctx, wild, wild, wild, wild, hour, min, 0,
+            "Skipped", "Skipped", NULL);
+    freeValueStruct(hour);
+    hour = createSingleValue(1);
+    addScheduleEntryNormalize(ctx, wild, wild, wild, wild, hour, min, 0,
+            "Repeated", "Repeated", NULL);
+    freeValueStruct(hour);
+    freeValueStruct(min);
+    min = createSingleValue(45);
+    addScheduleEntryNormalize(ctx, wild, wild, wild, wild, wild, min, 0,
+            "Hourly", "Hourly", NULL);
+    freeValueStruct(min);
+    freeValueStruct(wild);
+
+    for (day = 0; day < 2; day++) {
+        memset(&current, 0, sizeof(struct tm));
+        current.tm_year = 2010 - 1900;
+        current.tm_mon = dstDays[day][0];
+        current.tm_mday = dstDays[day][1];
+        current.tm_isdst = -1;
+        setTestTime(ctx, mktime(&current));
+        repeatedCount = 0;
+        for (idx = 0; idx < 8; idx++) {
+            for (mode = 0; mode < 2; mode++) {
+                setDispatchMode(ctx, modes[mode]);
+                nextExec = calcNextTaskAlarm(ctx);
+                CuAssertPtrNotNull(tc, nextExec);
+                alarmTimes[mode] = nextExec->absTime;
+                names[mode][0] = '\0';
+                appendAlarmTasks(nextExec, names[mode], sizeof(names[mode]));
+            }
+            CuAssertTrue(tc, alarmTimes[0] == alarmTimes[1]);
+            CuAssertStrEquals(tc, names[0], names[1]);
+            if (strstr(names[0], "Repeated") != NULL) {
+                repeatedCount++;
+            }
+            setTestTime(ctx, alarmTimes[0]);
+        }
+        CuAssertIntEquals(tc, 1, repeatedCount);
+    }
+    restoreTimeZone(ctx, previousZone);
+    freeScheduleContext(ctx);
+}
+
+/**
+ * Append the tasks of the next alarm of the schedule to names, separated by
+ * spaces.
+ */
+void appendNextAlarmTasks(CuTest *tc, scheduleContext *ctx, char *names, 
+        size_t size) {
+    scheduledExec *nextExec;
+
+    nextExec = calcNextTaskAlarm(ctx);
+    CuAssertPtrNotNull(tc, nextExec);
+    names[0] = '\0';
+    appendAlarmTasks(nextExec, names, size);
+}
+
+/**
+ * Test that every dispatch mode returns entries due at the same time in 
+ * schedule list order, also once a reload has given added entries the IDs
+ * of removed ones.
+ */
+void TestDispatchTieOrder(CuTest *tc) {
+    enum DispatchMode modes[] = {DISPATCH_QUEUE, DISPATCH_WHEEL, 
+        DISPATCH_MATCH};
+    const int numModes = sizeof(modes) / sizeof(modes[0]);
+    scheduleContext *ctx, *fresh;
+    struct tm current;
+    char names[64];
+    int mode;
+
+    memset(&current, 0, sizeof(struct tm));
+    current.tm_year = TEST_YEAR;
+    current.tm_mon = TEST_MON;
+    current.tm_mday = TEST_DAY_OF_MON;
+    current.tm_hour = TEST_HOUR;
+    current.tm_min = TEST_MIN;
+    current.tm_isdst = -1;
+    ctx = createScheduleContext();
+    setTestTime(ctx, mktime(&current));
+    addActionCommand(ctx, "echo", "echo %s", ON_DEMAND);
+    addReloadEntry(ctx, TEST_MIN + 1, "A", "A");
+    addReloadEntry(ctx, TEST_MIN + 1, "B", "B");
+    addReloadEntry(ctx, TEST_MIN + 1, "C", "C");
+    for (mode = 0; mode < numModes; mode++) {
+        setDispatchMode(ctx, modes[mode]);
+        appendNextAlarmTasks(tc, ctx, names, sizeof(names));
+        CuAssertStrEquals(tc, "A B C ", names);
+    }
+
+    fresh = createScheduleContext();
+    addActionCommand(fresh, "echo", "echo %s", ON_DEMAND);
+    addReloadEntry(fresh, TEST_MIN + 1, "B", "B");
+    addReloadEntry(fresh, TEST_MIN + 1, "C", "C");
+    addReloadEntry(fresh, TEST_MIN + 1, "D", "D");
+    applyScheduleReload(ctx, fresh, NULL);
+    freeScheduleContext(fresh);
+    for (mode = 0; mode < numModes; mode++) {
+        setDispatchMode(ctx, modes[mode]);
+        appendNextAlarmTasks(tc, ctx, names, sizeof(names));
+        CuAssertStrEquals(tc, "B C D ", names);
+    }
+    freeScheduleContext(ctx);
+}
+
+/**
+ * Test that the next alarm includes all entries scheduled for the same time.
+ * Runs after TestFileParse, so entries from testSched.dat are also scheduled.
+ */
+void TestCalcNextTaskAlarm(CuTest *tc) {
+    struct tm current, *alarmTime;
+    valueStruct *wild, *hour, *min;
+    scheduledExec *nextExec;
+    scheduleNode *node;
+    int found = 0;
+
+    memset(&current, 0, sizeof(struct tm));
+    current.tm_year = TEST_YEAR;
+    current.tm_mon = TEST_MON;
+    current.tm_mday = TEST_DAY_OF_MON;
+    current.tm_hour = TEST_HOUR;
+    current.tm_min = TEST_MIN;
+    current.tm_sec = TEST_SEC;
+    current.tm_isdst = -1;
+    setTestTime(testContext, mktime(&current));
+
+    // Two entries for the next minute and one for the minute after.
+    wild = createWildcardValue();
+    hour = createSingleValue(TEST_HOUR);
+    min = createSingleValue(TEST_MIN + 1);
+    addScheduleEntryAdv(testContext, wild, wild, wild, wild, hour, min, 0, 
+            "Alarm 1", "Alarm");
+    addScheduleEntryAdv(testContext, wild, wild, wild, wild, hour, min, 0, 
+            "Alarm 2", "Alarm");
+    min->value = TEST_MIN + 2;
+    addScheduleEntryAdv(testContext, wild, wild, wild, wild, hour, min, 0, 
+            "Alarm 3", "Alarm");
+    freeValueStruct(wild);
+    freeValueStruct(hour);
+    freeValueStruct(min);
+
+    nextExec = calcNextTaskAlarm(testContext);
+    CuAssertPtrNotNull(tc, nextExec);
+    alarmTime = localtime(&nextExec->absTime);
+    CuAssertIntEquals(tc, TEST_HOUR, alarmTime->tm_hour);
+    CuAssertIntEquals(tc, TEST_MIN + 1, alarmTime->tm_min);
+    CuAssertIntEquals(tc, 0, alarmTime->tm_sec);
+
+    for (node = nextExec->taskHead; node != NULL; node = node->next) {
+        if (strncmp(node->entry->task, "Alarm", 5) == 0) {
+            CuAssertTrue(tc, strcmp(node->entry->task, "Alarm 3") != 0);
+            found++;
+        }
+    }
+    CuAssertIntEquals(tc, 2, found);
+    freeScheduleNodeList(nextExec->taskHead);
+    free(nextExec);
+}
+
+/**
+ * Test that entries due at the same time are returned by the alarm queue in
+ * schedule list order, both when the queue is built and once the entries 
+ * have been placed back in it.
+ */
+void TestQueueTieOrder(CuTest *tc) {
+    scheduleContext *ctx;
+    valueStruct *wild, *hour, *min;
+    scheduledExec *nextExec;
+    scheduleNode *node;
+    struct tm current;
+    char task[16];
+    int idx, alarm;
+
+    memset(&current, 0, sizeof(struct tm));
+    current.tm_year = TEST_YEAR;
+    current.tm_mon = TEST_MON;
+    current.tm_mday = TEST_DAY_OF_MON;
+    current.tm_hour = TEST_HOUR;
+    current.tm_min = TEST_MIN;
+    current.tm_isdst = -1;
+    ctx = createScheduleContext();
+    setTestTime(ctx, mktime(&current));
+
+    wild = createWildcardValue();
+    hour = createSingleValue(TEST_HOUR);
+    min = createSingleValue(TEST_MIN + 1);
+    for (idx = 0; idx < 40; idx++) {
+        sprintf(task, "Tie %d", idx);
+        addScheduleEntryAdv(ctx, wild, wild, wild, wild, hour, min, 0, 
+                task, "Tie");
+    }
+    freeValueStruct(wild);
+    freeValueStruct(hour);
+    freeValueStruct(min);
+
+    for (alarm = 0; alarm < 2; alarm++) {
+        nextExec = calcNextTaskAlarm(ctx);
+        CuAssertPtrNotNull(tc, nextExec);
+        for (node = nextExec->taskHead, idx = 0; node != NULL; 
+                node = node->next, idx++) {
+            sprintf(task, "Tie %d", idx);
+            CuAssertStrEquals(tc, task, node->entry->task);
+        }
+        CuAssertIntEquals(tc, 40, idx);
+        setTestTime(ctx, nextExec->absTime);
+        freeScheduleNodeList(nextExec->taskHead);
+        free(nextExec);
+    }
+    freeScheduleContext(ctx);
+}
+
+/**
+ * Agenda callback counting the events created by TestCalcNextTaskAlarm.
+ */
+Bool countAlarmEvents(eventEntry * event, void * userData) {
+    if (strncmp(event->task, "Alarm", 5) == 0) {
+        (*(int *)userData)++;
+    }
+    return True;
+}
+
+/**
+ * Test the agenda stream using the entries added by TestCalcNextTaskAlarm.
+ */
+void TestAgenda(CuTest *tc) {
+    struct tm current;
+    time_t startTime, lastTime = 0;
+    agendaStream *agenda;
+    eventEntry events[2];
+    char *alarmOrder[3] = {"Alarm 1", "Alarm 2", "Alarm 3"};
+    int numEvents, eventIdx, alarmCount = 0;
+
+    memset(&current, 0, sizeof(struct tm));
+    current.tm_year = TEST_YEAR;
+    current.tm_mon = TEST_MON;
+    current.tm_mday = TEST_DAY_OF_MON;
+    current.tm_hour = TEST_HOUR;
+    current.tm_min = TEST_MIN;
+    current.tm_isdst = -1;
+    startTime = mktime(&current);
+
+    // Events in time order with ties in schedule order
+    agenda = openAgenda(testContext, startTime, startTime + 2 * 60);
+    while ((numEvents = readAgenda(agenda, events, 2)) > 0) {
+        for (eventIdx = 0; eventIdx < numEvents; eventIdx++) {
+            CuAssertTrue(tc, events[eventIdx].nextTime >= lastTime);
+            lastTime = events[eventIdx].nextTime;
+            if (strncmp(events[eventIdx].task, "Alarm", 5) == 0) {
+                CuAssertStrEquals(tc, alarmOrder[alarmCount], 
+                        events[eventIdx].task);
+                alarmCount++;
+            }
+        }
+    }
+    closeAgenda(agenda);
+    CuAssertIntEquals(tc, 3, alarmCount);
+
+    // Every occurrence over several days
+    alarmCount = 0;
+    generateAgenda(testContext, startTime, startTime + 3 * 86400, countAlarmEvents, 
+            &alarmCount);
+    CuAssertIntEquals(tc, 9, alarmCount);
+}
+
+/**
+ * Test that the upcoming events match the start of the agenda.
+ */
+void TestUpcomingEvents(CuTest *tc) {
+    struct tm current;
+    time_t currentTime;
+    agendaStream *agenda;
+    eventEntry upcoming[50], expected[50];
+    int sizes[3] = {1, 7, 50};
+    int sizeIdx, numEvents, eventIdx;
+
+    memset(&current, 0, sizeof(struct tm));
+    current.tm_year = TEST_YEAR;
+    current.tm_mon = TEST_MON;
+    current.tm_mday = TEST_DAY_OF_MON;
+    current.tm_hour = TEST_HOUR;
+    current.tm_min = TEST_MIN;
+    current.tm_sec = TEST_SEC;
+    current.tm_isdst = -1;
+    currentTime = mktime(&current);
+
+    for (sizeIdx = 0; sizeIdx < 3; sizeIdx++) {
+        numEvents = getUpcomingEvents(testContext, currentTime, upcoming, sizes[sizeIdx]);
+        CuAssertIntEquals(tc, sizes[sizeIdx], numEvents);
+
+        agenda = openAgenda(testContext, currentTime + 1, currentTime + 365 * 86400);
+        CuAssertIntEquals(tc, numEvents, readAgenda(agenda, expected, numEvents));
+        closeAgenda(agenda);
+
+        for (eventIdx = 0; eventIdx < numEvents; eventIdx++) {
+            CuAssertTrue(tc, 
+                    upcoming[eventIdx].nextTime == expected[eventIdx].nextTime);
+            CuAssertPtrEquals(tc, expected[eventIdx].task, 
+                    upcoming[eventIdx].task);
+        }
+    }
+}
+
+/**
+ * Test the timing wheel directly with timers on each level, including one 
+ * that is cancelled.
+ */
+void TestTimingWheel(CuTest *tc) {
+    time_t startTime = 1500000000;  // Start of a minute
+    time_t expected[5];
+    time_t bucketTime;
+    timingWheel *wheel;
+    wheelTimer *bucket, *cancelled;
+    int bucketIdx = 0, timerCount;
+
+    expected[0] = startTime + 2 * 60;           // Minute wheel
+    expected[1] = startTime + 3 * 3600;         // Hour or day wheel
+    expected[2] = startTime + 3 * 86400;        // Day wheel
+    expected[3] = startTime + 100 * 86400;      // Overflow
+    expected[4] = startTime + 200 * 86400;      // First bucket rescheduled
+
+    wheel = createTimingWheel(startTime);
+    insertWheelTimer(wheel, expected[3], NULL);
+    insertWheelTimer(wheel, expected[2], NULL);
+    insertWheelTimer(wheel, expected[1], NULL);
+    insertWheelTimer(wheel, expected[0], NULL);
+    insertWheelTimer(wheel, expected[0], NULL);
+    cancelled = insertWheelTimer(wheel, expected[1] - 60, NULL);
+    CuAssertIntEquals(tc, 6, wheel->count);
+    cancelWheelTimer(wheel, cancelled);
+    CuAssertIntEquals(tc, 5, wheel->count);
+
+    while ((bucket = expireNextWheelBucket(wheel, &bucketTime)) != NULL) {
+        CuAssertTrue(tc, bucketIdx < 5);
+        CuAssertTrue(tc, expected[bucketIdx] == bucketTime);
+        timerCount = bucket->next == NULL ? 1 : 2;
+        CuAssertIntEquals(tc, bucketIdx % 4 == 0 ? 2 : 1, timerCount);
+        // Place the first bucket back into the wheel beyond the overflow.
+        if (bucketIdx == 0) {
+            rescheduleWheelTimer(wheel, bucket->next, expected[4]);
+            rescheduleWheelTimer(wheel, bucket, expected[4]);
+            bucket = NULL;
+        }
+        freeWheelTimers(bucket);
+        bucketIdx++;
+    }
+    CuAssertIntEquals(tc, 5, bucketIdx);
+    CuAssertIntEquals(tc, 0, wheel->count);
+    freeTimingWheel(wheel);
+}
+
+/**
+ * Test that the timing wheel dispatch returns the same alarm as the queue.
+ */
+void TestWheelDispatch(CuTest *tc) {
+    struct tm current;
+    scheduledExec *queueExec, *wheelExec;
+    scheduleNode *queueNode, *wheelNode;
+    int queueCount = 0, wheelCount = 0;
+
+    memset(&current, 0, sizeof(struct tm));
+    current.tm_year = TEST_YEAR;
+    current.tm_mon = TEST_MON;
+    current.tm_mday = TEST_DAY_OF_MON;
+    current.tm_hour = TEST_HOUR;
+    current.tm_min = TEST_MIN;
+    current.tm_sec = TEST_SEC;
+    current.tm_isdst = -1;
+    setTestTime(testContext, mktime(&current));
+
+    setDispatchMode(testContext, DISPATCH_QUEUE);
+    queueExec = calcNextTaskAlarm(testContext);
+    setDispatchMode(testContext, DISPATCH_WHEEL);
+    wheelExec = calcNextTaskAlarm(testContext);
+    setDispatchMode(testContext, DISPATCH_QUEUE);
+
+    CuAssertPtrNotNull(tc, queueExec);
+    CuAssertPtrNotNull(tc, wheelExec);
+    CuAssertTrue(tc, queueExec->absTime == wheelExec->absTime);
+    for (queueNode = queueExec->taskHead; queueNode != NULL; 
+            queueNode = queueNode->next) {
+        queueCount++;
+        for (wheelNode = wheelExec->taskHead; wheelNode != NULL 
+                && wheelNode->entry != queueNode->entry; 
+                wheelNode = wheelNode->next);
+        CuAssertPtrNotNull(tc, wheelNode);
+    }
+    for (wheelNode = wheelExec->taskHead; wheelNode != NULL; 
+            wheelNode = wheelNode->next) {
+        wheelCount++;
+    }
+    CuAssertIntEquals(tc, queueCount, wheelCount);
+
+    freeScheduleNodeList(queueExec->taskHead);
+    free(queueExec);
+    freeScheduleNodeList(wheelExec->taskHead);
+    free(wheelExec);
+}
+
+/**
+ * Test that a launched command is collected once it exits.
+ */
+void TestSpawnCommand(CuTest *tc) {
+    struct timespec delay = {0, 10000000};
+    int reaped = 0, tries;
+
+    CuAssertTrue(tc, spawnCommand("exit 3") > 0);
+    for (tries = 0; tries < 200 && reaped == 0; tries++) {
+        nanosleep(&delay, NULL);
+        reaped = reapChildren();
+    }
+    CuAssertIntEquals(tc, 1, reaped);
+    CuAssertIntEquals(tc, 0, reapChildren());
+}
+
+/**
+ * Test launching commands through the launcher and collecting their exit.
+ */
+void TestLauncher(CuTest *tc) {
+    struct timespec delay = {0, 10000000};
+    char *missing[] = {"/nonexistent/command", NULL};
+    int reaped = 0, tries;
+
+    CuAssertIntEquals(tc, 0, startLauncher());
+    CuAssertTrue(tc, getLauncherFd() >= 0);
+    CuAssertTrue(tc, spawnCommand("exit 3") > 0);
+    CuAssertIntEquals(tc, -1, spawnArgs(missing));
+    for (tries = 0; tries < 200 && reaped == 0; tries++) {
+        nanosleep(&delay, NULL);
+        reaped = reapChildren();
+    }
+    CuAssertIntEquals(tc, 1, reaped);
+
+    // The launcher is collected when stopped.
+    stopLauncher();
+    CuAssertIntEquals(tc, -1, getLauncherFd());
+    CuAssertIntEquals(tc, 0, reapChildren());
+}
+
+#define FIRE_PRODUCERS 4
+#define FIRE_RECORDS 20000
+
+static fireQueue *producerQueue;
+static atomic_int producersDone;
+
+/**
+ * Producer for TestFireQueue.  Pushes FIRE_RECORDS records in time order
+ * using arg as the entry so the consumer can tell producers apart.
+ */
+void * pushFireRecords(void *arg) {
+    fireRecord record;
+    int idx;
+
+    record.entry = arg;
+    for (idx = 0; idx < FIRE_RECORDS; idx++) {
+        record.absTime = idx;
+        pushFireQueue(producerQueue, &record);
+    }
+    atomic_fetch_add(&producersDone, 1);
+    return NULL;
+}
+
+/**
+ * Test the fire queue ring alone and with several producers.
+ */
+void TestFireQueue(CuTest *tc) {
+    fireQueue *queue;
+    fireQueueStats stats;
+    fireRecord record;
+    pthread_t producers[FIRE_PRODUCERS];
+    scheduleEntry ids[FIRE_PRODUCERS];
+    time_t lastTime[FIRE_PRODUCERS];
+    size_t popped = 0;
+    int idx;
+    Bool ordered = True, finished;
+
+    queue = createFireQueue(3);
+    record.entry = NULL;
+    for (idx = 0; idx < 5; idx++) {
+        record.absTime = idx;
+        CuAssertTrue(tc, pushFireQueue(queue, &record) == (idx < 4));
+    }
+    getFireQueueStats(queue, &stats);
+    CuAssertIntEquals(tc, 4, stats.capacity);
+    CuAssertIntEquals(tc, 4, stats.depth);
+    CuAssertIntEquals(tc, 4, stats.maxDepth);
+    CuAssertIntEquals(tc, 4, stats.pushed);
+    CuAssertIntEquals(tc, 1, stats.dropped);
+    for (idx = 0; idx < 4; idx++) {
+        CuAssertTrue(tc, popFireQueue(queue, &record) == True);
+        CuAssertIntEquals(tc, idx, record.absTime);
+    }
+    CuAssertTrue(tc, popFireQueue(queue, &record) == False);
+    getFireQueueStats(queue, &stats);
+    CuAssertIntEquals(tc, 0, stats.depth);
+    freeFireQueue(queue);
+
+    // Each record pushed is popped once and in order for its producer.
+    producerQueue = createFireQueue(64);
+    atomic_store(&producersDone, 0);
+    for (idx = 0; idx < FIRE_PRODUCERS; idx++) {
+        lastTime[idx] = -1;
+        pthread_create(&producers[idx], NULL, pushFireRecords, &ids[idx]);
+    }
+    // Producers are checked before popping so no record is left behind.
+    do {
+        finished = atomic_load(&producersDone) == FIRE_PRODUCERS;
+        while (popFireQueue(producerQueue, &record) == True) {
+            idx = record.entry - ids;
+            ordered = ordered && record.absTime > lastTime[idx];
+            lastTime[idx] = record.absTime;
+            popped++;
+        }
+    } while (finished == False);
+    for (idx = 0; idx < FIRE_PRODUCERS; idx++) {
+        pthread_join(producers[idx], NULL);
+    }
+    getFireQueueStats(producerQueue, &stats);
+    CuAssertTrue(tc, ordered);
+    CuAssertIntEquals(tc, FIRE_PRODUCERS * FIRE_RECORDS, 
+            stats.pushed + stats.dropped);
+    CuAssertIntEquals(tc, stats.pushed, popped);
+    CuAssertIntEquals(tc, 0, stats.depth);
+    freeFireQueue(producerQueue);
+}
+
+/**
+ * Test that waitForTask arms the timer for a task 1 to 2 seconds out, 
+ * executes that task once the timer expires and returns as no later alarm
+ * remains.  The entry is for a year before the test time.
+ */
+void TestWaitForTask(CuTest *tc) {
+    scheduleContext *ctx;
+    scheduledExec *task;
+    valueStruct *year, *wild;
+    struct tm current;
+    struct timeval now;
+    time_t alarmTime;
+
+    memset(&current, 0, sizeof(struct tm));
+    current.tm_year = TEST_YEAR;
+    current.tm_mon = TEST_MON;
+    current.tm_mday = TEST_DAY_OF_MON;
+    current.tm_hour = TEST_HOUR;
+    current.tm_min = TEST_MIN;
+    current.tm_isdst = -1;
+    ctx = createScheduleContext();
+    setTestTime(ctx, mktime(&current));
+    wild = createWildcardValue();
+    year = createSingleValue(TEST_YEAR + 1899);
+    addScheduleEntryAdv(ctx, year, wild, wild, wild, wild, wild, 0, 
+            "Wait", "Wait");
+    freeValueStruct(wild);
+    freeValueStruct(year);
+
+    task = malloc(sizeof(scheduledExec));
+    assert(task != NULL);
+    gettimeofday(&now, NULL);
+    alarmTime = now.tv_sec + 2;
+    task->absTime = alarmTime;
+    task->taskHead = createScheduleNode();
+    task->taskHead->entry = getScheduleEntries(ctx)->entry;
+    // The task is freed once executed.
+    CuAssertIntEquals(tc, 0, waitForTask(ctx, task));
+    // time() may lag the clock used by the timer.
+    gettimeofday(&now, NULL);
+    CuAssertTrue(tc, now.tv_sec >= alarmTime);
+    CuAssertTrue(tc, ctx->lastExecTime == alarmTime);
+    freeScheduleContext(ctx);
+}
+
+/**
+ * Test that executors run the actions of dispatched entries.
+ */
+void TestExecutors(CuTest *tc) {
+    struct timespec delay = {0, 10000000};
+    valueStruct *wild;
+    scheduleEntry *entry;
+    scheduledExec task;
+    fireQueueStats stats;
+    int reaped = 0, tries;
+
+    wild = createWildcardValue();
+    entry = createScheduleEntryAdv(wild, wild, wild, wild, wild, wild, 30, 
+            "Walk", "Time to walk");
+    freeValueStruct(wild);
+    entry->actionSet = createActionSet(
+            createActionCommand("exit", "! exit 0", PRIVATE));
+
+    CuAssertIntEquals(tc, 0, startExecutors(2, 16));
+    CuAssertIntEquals(tc, 2, getExecutorCount());
+    task.absTime = time(NULL);
+    task.taskHead = createScheduleNode();
+    task.taskHead->entry = entry;
+    task.taskHead->next = createScheduleNode();
+    task.taskHead->next->entry = entry;
+    executeScheduledEntry(testContext, &task);
+    getExecutorStats(&stats);
+    CuAssertIntEquals(tc, 16, stats.capacity);
+    CuAssertIntEquals(tc, 2, stats.pushed);
+    CuAssertIntEquals(tc, 0, stats.dropped);
+
+    // Stopping runs the queued records before the threads exit.
+    stopExecutors();
+    CuAssertIntEquals(tc, 0, getExecutorCount());
+    for (tries = 0; tries < 200 && reaped < 2; tries++) {
+        nanosleep(&delay, NULL);
+        reaped += reapChildren();
+    }
+    CuAssertIntEquals(tc, 2, reaped);
+
+    freeActionSet(entry->actionSet);
+    entry->actionSet = NULL;
+    freeScheduleEntry(entry);
+    // Later tests expect no alarm to have executed.
+    resetTaskAlarmQueue(testContext);
+}
+
+/**
+ * Test rendering of action commands with each placeholder.
+ */
+void TestActionTemplate(CuTest *tc) {
+    struct tm current;
+    valueStruct *wild;
+    scheduleEntry *entry;
+    actionDef *action;
+    char **argv;
+
+    memset(&current, 0, sizeof(struct tm));
+    current.tm_year = TEST_YEAR;
+    current.tm_mon = TEST_MON;
+    current.tm_mday = TEST_DAY_OF_MON;
+    current.tm_hour = TEST_HOUR;
+    current.tm_min = TEST_MIN;
+    current.tm_isdst = -1;
+
+    wild = createWildcardValue();
+    entry = createScheduleEntryAdv(wild, wild, wild, wild, wild, wild, 30, 
+            "Walk", "Time to walk");
+    freeValueStruct(wild);
+
+    action = createActionCommand("template", 
+            "say \"%s: %{task}\" at\\ %{time} '%{duration}%' 100%%", PRIVATE);
+    CuAssertTrue(tc, action->timeDependent == True);
+    CuAssertTrue(tc, action->useShell == False);
+    argv = renderActionArgs(action, entry, mktime(&current));
+    CuAssertStrEquals(tc, "say", argv[0]);
+    CuAssertStrEquals(tc, "Time to walk: Walk", argv[1]);
+    CuAssertStrEquals(tc, "at 10:15", argv[2]);
+    CuAssertStrEquals(tc, "%{duration}%", argv[3]);
+    CuAssertStrEquals(tc, "100%", argv[4]);
+    CuAssertPtrEquals(tc, NULL, argv[5]);
+    free(argv);
+    freeActionDef(action);
+
+    action = createActionCommand("shell", "! echo %{message} | wc", PRIVATE);
+    CuAssertTrue(tc, action->timeDependent == False);
+    CuAssertTrue(tc, action->useShell == True);
+    argv = renderActionArgs(action, entry, mktime(&current));
+    CuAssertStrEquals(tc, "/bin/sh", argv[0]);
+    CuAssertStrEquals(tc, "-c", argv[1]);
+    CuAssertStrEquals(tc, "echo Time to walk | wc", argv[2]);
+    CuAssertPtrEquals(tc, NULL, argv[3]);
+    free(argv);
+    freeActionDef(action);
+
+    freeScheduleEntry(entry);
+}
+
+/**
+ * Test the exact argument list each command compiles to: white space 
+ * between arguments, quoted and empty arguments, backslash escapes, each 
+ * placeholder and commands run by the shell.
+ */
+void TestActionTokenize(CuTest *tc) {
+    static const struct {
+        const char *command;
+        const char *argv[8];
+    } commands[] = {
+        {"notify  -t \"Daily reminder\"\t 'single quoted' plain", 
+            {"notify", "-t", "Daily reminder", "single quoted", "plain"}},
+        {"echo \"\" '' x\"\"y", {"echo", "", "", "xy"}},
+        {"echo a\\ b \\\"q\\\" \"in \\\"double\\\" \\\\\" 'in \\single' end\\",
+            {"echo", "a b", "\"q\"", "in \"double\" \\", "in \\single", 
+                "end\\"}},
+        {"echo \"open ended", {"echo", "open ended"}},
+        {"echo %s|%{message}|%{task}|%{time}|%{duration} "
+                "\"%{task} at %{time}\" '%{task}' 50%% 5% %{other}", 
+            {"echo", "Time to walk|Time to walk|Walk|10:15|30", 
+                "Walk at 10:15", "%{task}", "50%", "5%", "%{other}"}},
+        {"!  echo \"a  b\" 'c' \\d %{task} | wc", 
+            {"/bin/sh", "-c", "echo \"a  b\" 'c' \\d Walk | wc"}}
+    };
+    const int numCommands = sizeof(commands) / sizeof(commands[0]);
+    struct tm current;
+    valueStruct *wild;
+    scheduleEntry *entry;
+    actionDef *action;
+    char **argv;
+    int idx, arg;
+
+    memset(&current, 0, sizeof(struct tm));
+    current.tm_year = TEST_YEAR;
+    current.tm_mon = TEST_MON;
+    current.tm_mday = TEST_DAY_OF_MON;
+    current.tm_hour = TEST_HOUR;
+    current.tm_min = TEST_MIN;
+    current.tm_isdst = -1;
+
+    wild = createWildcardValue();
+    entry = createScheduleEntryAdv(wild, wild, wild, wild, wild, wild, 30, 
+            "Walk", "Time to walk");
+    freeValueStruct(wild);
+
+    for (idx = 0; idx < numCommands; idx++) {
+        action = createActionCommand("tokenize", 
+                (char *)commands[idx].command, PRIVATE);
+        CuAssertTrue(tc, action->useShell 
+                == (commands[idx].command[0] == '!' ? True : False));
+        argv = renderActionArgs(action, entry, mktime(&current));
+        for (arg = 0; commands[idx].argv[arg] != NULL; arg++) {
+            CuAssertPtrNotNull(tc, argv[arg]);
+            CuAssertStrEquals(tc, commands[idx].argv[arg], argv[arg]);
+        }
+        CuAssertPtrEquals(tc, NULL, argv[arg]);
+        free(argv);
+        freeActionDef(action);
+    }
+    freeScheduleEntry(entry);
+}
+
+/**
+ * Test that defined actions are found by name once the index has grown, 
+ * that the first of two actions with the same name is found and that the
+ * DEFAULT and ALWAYS actions are kept in definition order.
+ */
+void TestActionIndex(CuTest *tc) {
+    enum ActionType types[] = {ON_DEMAND, DEFAULT, ALWAYS};
+    scheduleContext *ctx;
+    actionDef *first;
+    char name[16];
+    int idx;
+
+    ctx = createScheduleContext();
+    CuAssertPtrEquals(tc, NULL, findActionCommand(ctx, "a0"));
+    for (idx = 0; idx < 300; idx++) {
+        sprintf(name, "a%d", idx);
+        addActionCommand(ctx, name, "echo %s", types[idx % 3]);
+    }
+    first = findActionCommand(ctx, "a5");
+    addActionCommand(ctx, "a5", "echo again", DEFAULT);
+    CuAssertPtrEquals(tc, first, findActionCommand(ctx, "a5"));
+    CuAssertPtrEquals(tc, NULL, findActionCommand(ctx, "a300"));
+    for (idx = 0; idx < 300; idx++) {
+        sprintf(name, "a%d", idx);
+        CuAssertStrEquals(tc, name, findActionCommand(ctx, name)->name);
+    }
+
+    CuAssertIntEquals(tc, 101, ctx->actions.defaultCount);
+    CuAssertIntEquals(tc, 100, ctx->actions.alwaysCount);
+    CuAssertStrEquals(tc, "a1", ctx->actions.defaults[0]->name);
+    CuAssertStrEquals(tc, "a298", ctx->actions.defaults[99]->name);
+    CuAssertStrEquals(tc, "echo again", ctx->actions.defaults[100]->command);
+    CuAssertStrEquals(tc, "a299", ctx->actions.always[99]->name);
+
+    freeSchedule(ctx);
+    CuAssertPtrEquals(tc, NULL, findActionCommand(ctx, "a1"));
+    CuAssertIntEquals(tc, 0, ctx->actions.defaultCount);
+    freeScheduleContext(ctx);
+}
+
+/**
+ * Test that schedules held by separate contexts do not share entries, 
+ * actions or test time.
+ */
+void TestScheduleContext(CuTest *tc) {
+    scheduleContext *first, *second;
+    valueStruct *wild, *hour, *min;
+    scheduledExec *nextExec;
+    struct tm current;
+
+    memset(&current, 0, sizeof(struct tm));
+    current.tm_year = TEST_YEAR;
+    current.tm_mon = TEST_MON;
+    current.tm_mday = TEST_DAY_OF_MON;
+    current.tm_hour = TEST_HOUR;
+    current.tm_min = TEST_MIN;
+    current.tm_isdst = -1;
+    first = createScheduleContext();
+    second = createScheduleContext();
+    setTestTime(first, mktime(&current));
+    setTestTime(second, mktime(&current));
+
+    addActionCommand(first, "Only", "echo first", ON_DEMAND);
+    CuAssertPtrNotNull(tc, findActionCommand(first, "Only"));
+    CuAssertPtrEquals(tc, NULL, findActionCommand(second, "Only"));
+
+    wild = createWildcardValue();
+    hour = createSingleValue(TEST_HOUR);
+    min = createSingleValue(TEST_MIN + 1);
+    addScheduleEntryAdv(first, wild, wild, wild, wild, hour, min, 0, 
+            "First", "Context");
+    freeValueStruct(wild);
+    freeValueStruct(hour);
+    freeValueStruct(min);
+    CuAssertIntEquals(tc, 1, first->scheduleCount);
+    CuAssertIntEquals(tc, 0, second->scheduleCount);
+    CuAssertPtrEquals(tc, NULL, getScheduleEntries(second));
+    CuAssertPtrEquals(tc, NULL, calcNextTaskAlarm(second));
+
+    nextExec = calcNextTaskAlarm(first);
+    CuAssertPtrNotNull(tc, nextExec);
+    CuAssertStrEquals(tc, "First", nextExec->taskHead->entry->task);
+    CuAssertPtrEquals(tc, NULL, nextExec->taskHead->next);
+    freeScheduleNodeList(nextExec->taskHead);
+    free(nextExec);
+
+    freeScheduleContext(first);
+    freeScheduleContext(second);
 }
 
 void AddTestsToSuite(CuSuite *suite) {
     testArgs *test;
+    testContext = createScheduleContext();
     SUITE_ADD_TEST(suite, TestValueParse);
+    SUITE_ADD_TEST(suite, TestCompileScheduleEntry);
+    SUITE_ADD_TEST(suite, TestCalcNextTimesForTasksFrom);
+    SUITE_ADD_TEST(suite, TestOccurrenceIter);
     SUITE_ADD_TEST(suite, TestFileParse);
+    SUITE_ADD_TEST(suite, TestParallelParse);
+    SUITE_ADD_TEST(suite, TestMappedParse);
+    SUITE_ADD_TEST(suite, TestScheduleCache);
+    SUITE_ADD_TEST(suite, TestScheduleReload);
+    SUITE_ADD_TEST(suite, TestReloadScheduleFile);
+    SUITE_ADD_TEST(suite, TestScheduleArena);
+    SUITE_ADD_TEST(suite, TestStringPool);
+    SUITE_ADD_TEST(suite, TestEntryStore);
+    SUITE_ADD_TEST(suite, TestCivilCalendar);
+    SUITE_ADD_TEST(suite, TestCalTimeDst);
+    SUITE_ADD_TEST(suite, TestMatchEntriesAt);
+    SUITE_ADD_TEST(suite, TestMatchDispatchDst);
+    SUITE_ADD_TEST(suite, TestAgendaDst);
+    SUITE_ADD_TEST(suite, TestStoreTimesReset);
+    SUITE_ADD_TEST(suite, TestCalcNextTaskAlarm);
+    SUITE_ADD_TEST(suite, TestQueueTieOrder);
+    SUITE_ADD_TEST(suite, TestDispatchTieOrder);
+    SUITE_ADD_TEST(suite, TestAgenda);
+    SUITE_ADD_TEST(suite, TestUpcomingEvents);
+    SUITE_ADD_TEST(suite, TestTimingWheel);
+    SUITE_ADD_TEST(suite, TestWheelDispatch);
+    SUITE_ADD_TEST(suite, TestSpawnCommand);
+    SUITE_ADD_TEST(suite, TestLauncher);
+    SUITE_ADD_TEST(suite, TestFireQueue);
+    SUITE_ADD_TEST(suite, TestExecutors);
+    SUITE_ADD_TEST(suite, TestWaitForTask);
+    SUITE_ADD_TEST(suite, TestActionTemplate);
+    SUITE_ADD_TEST(suite, TestActionTokenize);
+    SUITE_ADD_TEST(suite, TestActionIndex);
+    SUITE_ADD_TEST(suite, TestScheduleContext);
     loadTestArrayFromFile();
     for (test = head; test != NULL; test = test->next) {
         SUITE_ADD_TEST(suite, TestCurrentFileEntry);